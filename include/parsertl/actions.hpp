@@ -0,0 +1,161 @@
+// actions.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_ACTIONS_HPP
+#define PARSERTL_ACTIONS_HPP
+
+#include "lookup.hpp"
+#include "match_results.hpp"
+#include <vector>
+
+namespace parsertl
+{
+    // Semantic actions indexed by rule id, replacing a switch on
+    // results_.reduce_id(). Actions are called before the rule is
+    // reduced, so results_.dollar() can be used to access the rhs.
+    template<typename sm_type, typename token_vector, typename context>
+    class basic_rule_actions
+    {
+    public:
+        using results = basic_match_results<sm_type>;
+        using action_func = void (*)(context&, const results&, token_vector&);
+
+        basic_rule_actions() = default;
+
+        explicit basic_rule_actions(const sm_type& sm_) :
+            _funcs(sm_._rules.size(), nullptr)
+        {
+        }
+
+        void assign(const std::size_t rule_id_, const action_func func_)
+        {
+            if (rule_id_ >= _funcs.size())
+                _funcs.resize(rule_id_ + 1, nullptr);
+
+            _funcs[rule_id_] = func_;
+        }
+
+        void clear()
+        {
+            _funcs.clear();
+        }
+
+        void operator ()(const std::size_t rule_id_, context& context_,
+            const results& results_, token_vector& productions_) const
+        {
+            if (rule_id_ < _funcs.size() && _funcs[rule_id_])
+                _funcs[rule_id_](context_, results_, productions_);
+        }
+
+    private:
+        std::vector<action_func> _funcs;
+    };
+
+    // Binds functor (a stateless type with
+    // operator()(context&, const results&, token_vector&))
+    // to rule rule_id for use with static_actions.
+    template<std::size_t rule_id, typename functor>
+    struct rule_action
+    {
+    };
+
+    namespace details
+    {
+        template<typename... rule_actions>
+        struct max_rule_id;
+
+        template<>
+        struct max_rule_id<>
+        {
+            static constexpr std::size_t value = 0;
+        };
+
+        template<std::size_t rule_id, typename functor,
+            typename... rule_actions>
+        struct max_rule_id<rule_action<rule_id, functor>, rule_actions...>
+        {
+            static constexpr std::size_t rest =
+                max_rule_id<rule_actions...>::value;
+            static constexpr std::size_t value =
+                rule_id > rest ? rule_id : rest;
+        };
+    }
+
+    // As basic_rule_actions, but the table is built at compile time from
+    // a list of rule_actions. Each functor is called through its own
+    // thunk, so small actions are inlined into the thunk.
+    template<typename sm_type, typename token_vector, typename context,
+        typename... rule_actions>
+    class static_actions
+    {
+    public:
+        using results = basic_match_results<sm_type>;
+        using action_func = void (*)(context&, const results&, token_vector&);
+
+        static constexpr std::size_t size =
+            details::max_rule_id<rule_actions...>::value + 1;
+
+        void operator ()(const std::size_t rule_id_, context& context_,
+            const results& results_, token_vector& productions_) const
+        {
+            static constexpr table table_ = make_table
+                (static_cast<rule_actions*>(nullptr)...);
+
+            if (rule_id_ < size && table_._funcs[rule_id_])
+                table_._funcs[rule_id_](context_, results_, productions_);
+        }
+
+    private:
+        struct table
+        {
+            action_func _funcs[size];
+        };
+
+        template<typename functor>
+        static void thunk(context& context_, const results& results_,
+            token_vector& productions_)
+        {
+            functor()(context_, results_, productions_);
+        }
+
+        template<std::size_t... rule_ids, typename... functors>
+        static constexpr table make_table(rule_action<rule_ids, functors>*...)
+        {
+            table table_{};
+            // Expand the pack without fold expressions (C++14)
+            const int dummy_[] = { 0,
+                (table_._funcs[rule_ids] = &thunk<functors>, 0)... };
+
+            static_cast<void>(dummy_);
+            return table_;
+        }
+    };
+
+    // Parse entire sequence, calling actions_(rule_id, context_, results_,
+    // productions_) on every reduce. actions_ is normally a
+    // basic_rule_actions or static_actions.
+    template<typename lexer_iterator, typename sm_type, typename token_vector,
+        typename actions, typename context>
+    bool parse(lexer_iterator& iter_, const sm_type& sm_,
+        basic_match_results<sm_type>& results_, token_vector& productions_,
+        const actions& actions_, context& context_)
+    {
+        while (results_.entry.action != action::error &&
+            results_.entry.action != action::accept)
+        {
+            if (results_.entry.action == action::reduce)
+            {
+                actions_(results_.entry.param, context_, results_,
+                    productions_);
+            }
+
+            lookup(iter_, sm_, results_, productions_);
+        }
+
+        return results_.entry.action == action::accept;
+    }
+}
+
+#endif
@@ -0,0 +1,252 @@
+// ast.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_AST_HPP
+#define PARSERTL_AST_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include "lookup.hpp"
+#include "match_results.hpp"
+#include "runtime_error.hpp"
+#include "token.hpp"
+#include <utility>
+#include <vector>
+
+namespace parsertl
+{
+    // Parse tree stored as parallel arrays indexed by node number.
+    // Leaves are shifted tokens, other nodes are reductions. Children are
+    // linked via first_child()/next_sibling(), so no memory is allocated
+    // per node. Calling clear() between parses keeps the capacity.
+    template<typename sm_type, typename lexer_iterator>
+    class basic_flat_ast
+    {
+    public:
+        using id_type = typename sm_type::id_type;
+        using index_type = std::uint32_t;
+        // Qualify token to prevent arg dependant lookup
+        using token = parsertl::token<lexer_iterator>;
+        using iter_type = typename token::iter_type;
+
+        static index_type npos()
+        {
+            return static_cast<index_type>(~0);
+        }
+
+        void clear()
+        {
+            _id.clear();
+            _rule.clear();
+            _first.clear();
+            _second.clear();
+            _first_child.clear();
+            _next_sibling.clear();
+            _stack.clear();
+            _root = npos();
+        }
+
+        void reserve(const std::size_t size_)
+        {
+            _id.reserve(size_);
+            _rule.reserve(size_);
+            _first.reserve(size_);
+            _second.reserve(size_);
+            _first_child.reserve(size_);
+            _next_sibling.reserve(size_);
+        }
+
+        // Parse entire sequence building the tree.
+        // On failure the nodes built so far are left in place.
+        bool parse(lexer_iterator& iter_, const sm_type& sm_,
+            basic_match_results<sm_type>& results_)
+        {
+            clear();
+
+            while (results_.entry.action != action::error &&
+                results_.entry.action != action::accept)
+            {
+                switch (results_.entry.action)
+                {
+                case action::shift:
+                    // End of input does not get a node
+                    if (iter_->id != 0)
+                    {
+                        _stack.push_back(add(static_cast<id_type>(iter_->id),
+                            npos(), iter_->first, iter_->second, npos()));
+                    }
+
+                    break;
+                case action::reduce:
+                    reduce(iter_, sm_, results_.entry.param);
+                    break;
+                default:
+                    // action::go_to
+                    break;
+                }
+
+                lookup(iter_, sm_, results_);
+            }
+
+            if (results_.entry.action == action::accept && !_stack.empty())
+                _root = _stack.back();
+
+            return results_.entry.action == action::accept;
+        }
+
+        std::size_t size() const
+        {
+            return _id.size();
+        }
+
+        index_type root() const
+        {
+            return _root;
+        }
+
+        // Token id for leaves, lhs id for rule nodes
+        id_type id(const index_type node_) const
+        {
+            return _id[node_];
+        }
+
+        // npos() for leaves
+        index_type rule(const index_type node_) const
+        {
+            return _rule[node_];
+        }
+
+        bool is_leaf(const index_type node_) const
+        {
+            return _rule[node_] == npos();
+        }
+
+        const iter_type& first(const index_type node_) const
+        {
+            return _first[node_];
+        }
+
+        const iter_type& second(const index_type node_) const
+        {
+            return _second[node_];
+        }
+
+        index_type first_child(const index_type node_) const
+        {
+            return _first_child[node_];
+        }
+
+        index_type next_sibling(const index_type node_) const
+        {
+            return _next_sibling[node_];
+        }
+
+        std::size_t child_count(const index_type node_) const
+        {
+            std::size_t count_ = 0;
+
+            for (index_type child_ = _first_child[node_]; child_ != npos();
+                child_ = _next_sibling[child_])
+            {
+                ++count_;
+            }
+
+            return count_;
+        }
+
+        // Depth first, pre-order walk calling func_(node_, depth_).
+        // Uses an explicit stack, so deep trees are safe.
+        template<typename func>
+        void visit(const index_type node_, func&& func_) const
+        {
+            std::vector<std::pair<index_type, std::size_t>> stack_;
+
+            if (node_ != npos())
+                stack_.emplace_back(node_, 0);
+
+            while (!stack_.empty())
+            {
+                const auto pair_ = stack_.back();
+
+                stack_.pop_back();
+                func_(pair_.first, pair_.second);
+
+                // Push in reverse so that children are visited in order
+                const std::size_t size_ = stack_.size();
+
+                for (index_type child_ = _first_child[pair_.first];
+                    child_ != npos(); child_ = _next_sibling[child_])
+                {
+                    stack_.emplace_back(child_, pair_.second + 1);
+                }
+
+                std::reverse(stack_.begin() + size_, stack_.end());
+            }
+        }
+
+    private:
+        std::vector<id_type> _id;
+        std::vector<index_type> _rule;
+        std::vector<iter_type> _first;
+        std::vector<iter_type> _second;
+        std::vector<index_type> _first_child;
+        std::vector<index_type> _next_sibling;
+        // Node for each symbol on the parser stack
+        std::vector<index_type> _stack;
+        index_type _root = npos();
+
+        index_type add(const id_type id_, const index_type rule_,
+            const iter_type& first_, const iter_type& second_,
+            const index_type first_child_)
+        {
+            if (_id.size() >= npos())
+                throw runtime_error("Too many nodes for basic_flat_ast.");
+
+            const auto index_ = static_cast<index_type>(_id.size());
+
+            _id.push_back(id_);
+            _rule.push_back(rule_);
+            _first.push_back(first_);
+            _second.push_back(second_);
+            _first_child.push_back(first_child_);
+            _next_sibling.push_back(npos());
+            return index_;
+        }
+
+        void reduce(const lexer_iterator& iter_, const sm_type& sm_,
+            const id_type rule_id_)
+        {
+            const auto& rule_ = sm_._rules[rule_id_];
+            const std::size_t size_ = rule_._rhs.size();
+            index_type node_ = npos();
+
+            if (size_)
+            {
+                const std::size_t start_ = _stack.size() - size_;
+
+                for (std::size_t idx_ = start_ + 1, end_ = _stack.size();
+                    idx_ < end_; ++idx_)
+                {
+                    _next_sibling[_stack[idx_ - 1]] = _stack[idx_];
+                }
+
+                node_ = add(rule_._lhs, rule_id_, _first[_stack[start_]],
+                    _second[_stack.back()], _stack[start_]);
+                _stack.resize(start_);
+            }
+            else
+            {
+                const iter_type pos_ = _stack.empty() ?
+                    iter_->first : _second[_stack.back()];
+
+                node_ = add(rule_._lhs, rule_id_, pos_, pos_, npos());
+            }
+
+            _stack.push_back(node_);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,521 @@
+// checkpoint.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_CHECKPOINT_HPP
+#define PARSERTL_CHECKPOINT_HPP
+
+#include <algorithm>
+#include "match_results.hpp"
+#include "runtime_error.hpp"
+#include "token.hpp"
+#include <vector>
+
+namespace parsertl
+{
+    namespace details
+    {
+        // Parser stacks stored as frames pointing at their parent, so that
+        // stacks added one after another share the part they have in
+        // common. Each frame counts the frames and owners referring to it
+        // and is reused once the count drops to zero, so memory is bounded
+        // by the stacks still held rather than by the number added.
+        template<typename id_type, typename token_type>
+        class stack_frames
+        {
+        public:
+            struct frame
+            {
+                id_type _state = 0;
+                // The production shifted or reduced to reach _state
+                token_type _token;
+                std::size_t _parent = npos();
+                std::size_t _refs = 0;
+            };
+
+            static std::size_t npos()
+            {
+                return static_cast<std::size_t>(~0);
+            }
+
+            void clear()
+            {
+                _frames.clear();
+                _free.clear();
+                _chain.clear();
+            }
+
+            // Frames in use
+            std::size_t size() const
+            {
+                return _frames.size() - _free.size();
+            }
+
+            const frame& operator [](const std::size_t index_) const
+            {
+                return _frames[index_];
+            }
+
+            frame& operator [](const std::size_t index_)
+            {
+                return _frames[index_];
+            }
+
+            // Stores stack_ (with (*productions_)[idx_ - 1] converted by
+            // convert_ for each entry idx_ > 0, if productions_ is not
+            // null), reusing the frames of the previous call that still
+            // match. The first unchanged_ entries are known to be the same
+            // as last time (i.e. not popped since) and are not compared.
+            // Returns the top frame, which is held until passed to
+            // release().
+            template<typename token_vector, typename convert>
+            std::size_t share(const std::vector<id_type>& stack_,
+                const token_vector* productions_, std::size_t unchanged_,
+                convert convert_)
+            {
+                const std::size_t depth_ = stack_.size();
+                std::size_t common_ = std::min(std::min(unchanged_, depth_),
+                    _chain.size());
+
+                while (common_ < depth_ && common_ < _chain.size())
+                {
+                    const frame& f_ = _frames[_chain[common_]];
+
+                    if (f_._state != stack_[common_] ||
+                        (common_ > 0 && !equal(f_._token, productions_ ?
+                            convert_((*productions_)[common_ - 1]) :
+                            token_type())))
+                    {
+                        break;
+                    }
+
+                    ++common_;
+                }
+
+                _chain.resize(common_);
+
+                for (std::size_t idx_ = common_; idx_ < depth_; ++idx_)
+                {
+                    const std::size_t index_ = allocate();
+                    frame& f_ = _frames[index_];
+
+                    f_._state = stack_[idx_];
+                    f_._token = idx_ > 0 && productions_ ?
+                        convert_((*productions_)[idx_ - 1]) : token_type();
+                    f_._parent = _chain.empty() ? npos() : _chain.back();
+
+                    if (f_._parent != npos())
+                        ++_frames[f_._parent]._refs;
+
+                    _chain.push_back(index_);
+                }
+
+                if (_chain.empty())
+                    return npos();
+
+                ++_frames[_chain.back()]._refs;
+                return _chain.back();
+            }
+
+            // Makes the next share() compare against the stack ending at
+            // top_ instead of the one from the most recent share().
+            void rewind(std::size_t top_)
+            {
+                _chain.clear();
+
+                for (; top_ != npos(); top_ = _frames[top_]._parent)
+                {
+                    _chain.push_back(top_);
+                }
+
+                std::reverse(_chain.begin(), _chain.end());
+            }
+
+            // Drops a reference taken by share(), freeing the frames
+            // that nothing else refers to.
+            void release(std::size_t index_)
+            {
+                while (index_ != npos() && --_frames[index_]._refs == 0)
+                {
+                    _free.push_back(index_);
+                    index_ = _frames[index_]._parent;
+                }
+
+                // A freed frame can only be reached through its children,
+                // which are freed too, so the rest of _chain is intact.
+                while (!_chain.empty() && _frames[_chain.back()]._refs == 0)
+                {
+                    _chain.pop_back();
+                }
+            }
+
+        private:
+            std::vector<frame> _frames;
+            std::vector<std::size_t> _free;
+            // Frame index at each depth of the most recent share().
+            std::vector<std::size_t> _chain;
+
+            static bool equal(const token_type& lhs_, const token_type& rhs_)
+            {
+                return lhs_.id == rhs_.id && lhs_.first == rhs_.first &&
+                    lhs_.second == rhs_.second;
+            }
+
+            std::size_t allocate()
+            {
+                std::size_t index_ = 0;
+
+                if (_free.empty())
+                {
+                    index_ = _frames.size();
+                    _frames.emplace_back();
+                }
+                else
+                {
+                    index_ = _free.back();
+                    _free.pop_back();
+                    _frames[index_] = frame();
+                }
+
+                return index_;
+            }
+        };
+    }
+
+    // Snapshots of a parse (stack, productions and lexer position)
+    // that can be restored later, possibly on another thread.
+    // Each stack entry is stored once as a frame pointing at its parent,
+    // so consecutive checkpoints share the part of the stack they have
+    // in common. Taking or restoring a checkpoint is O(stack depth).
+    // Frames are freed as soon as no checkpoint refers to them, so
+    // release() checkpoints that are no longer needed (or clear() them
+    // all). Otherwise memory grows with every checkpoint taken.
+    template<typename sm_type, typename lexer_iterator>
+    class basic_checkpoints
+    {
+    public:
+        using id_type = typename sm_type::id_type;
+        using entry = typename sm_type::entry;
+        // Qualify token to prevent arg dependant lookup
+        using token = parsertl::token<lexer_iterator>;
+        using token_vector = typename token::token_vector;
+        using iter_type = typename token::iter_type;
+
+        void clear()
+        {
+            _frames.clear();
+            _checkpoints.clear();
+            _free.clear();
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        // Checkpoints not yet released
+        std::size_t size() const
+        {
+            return _checkpoints.size() - _free.size();
+        }
+
+        // Stack entries stored for all of the checkpoints
+        std::size_t frames() const
+        {
+            return _frames.size();
+        }
+
+        // Frees the frames of a checkpoint that no other checkpoint
+        // shares. index_ may be returned by a later push() or load().
+        void release(const std::size_t index_)
+        {
+            checkpoint& cp_ = _checkpoints[index_];
+
+            _frames.release(cp_._top);
+            cp_ = checkpoint();
+            _free.push_back(index_);
+        }
+
+        // Returns the index of the new checkpoint.
+        std::size_t push(const basic_match_results<sm_type>& results_,
+            const token_vector& productions_, const lexer_iterator& iter_)
+        {
+            const std::size_t depth_ = results_.stack.size();
+            checkpoint cp_;
+
+            // Between reduce and go_to there is one more production than
+            // there are stack entries above the initial state.
+            if (productions_.size() == depth_)
+            {
+                cp_._pending = true;
+                cp_._pending_token = productions_.back();
+            }
+            else if (productions_.size() + 1 != depth_)
+            {
+                throw runtime_error("Production vector does not match "
+                    "parser stack in basic_checkpoints::push().");
+            }
+
+            cp_._top = _frames.share(results_.stack, &productions_, 0,
+                identity());
+            cp_._depth = depth_;
+            cp_._token_id = results_.token_id;
+            cp_._entry = results_.entry;
+            cp_._position = iter_->first;
+            return add(cp_);
+        }
+
+        // For use with the lookup() overload that does not
+        // maintain productions.
+        std::size_t push(const basic_match_results<sm_type>& results_,
+            const lexer_iterator& iter_)
+        {
+            checkpoint cp_;
+
+            cp_._top = _frames.share(results_.stack,
+                static_cast<const token_vector*>(nullptr), 0, identity());
+            cp_._depth = results_.stack.size();
+            cp_._token_id = results_.token_id;
+            cp_._entry = results_.entry;
+            cp_._position = iter_->first;
+            return add(cp_);
+        }
+
+        void restore(const std::size_t index_,
+            basic_match_results<sm_type>& results_,
+            token_vector& productions_) const
+        {
+            const checkpoint& cp_ = _checkpoints[index_];
+            std::size_t frame_ = cp_._top;
+
+            results_.stack.resize(cp_._depth);
+            productions_.resize(cp_._depth - 1 + (cp_._pending ? 1 : 0));
+
+            if (cp_._pending)
+                productions_.back() = cp_._pending_token;
+
+            for (std::size_t idx_ = cp_._depth; idx_-- > 0;)
+            {
+                const auto& f_ = _frames[frame_];
+
+                results_.stack[idx_] = f_._state;
+
+                if (idx_ > 0)
+                    productions_[idx_ - 1] = f_._token;
+
+                frame_ = f_._parent;
+            }
+
+            results_.token_id = cp_._token_id;
+            results_.entry = cp_._entry;
+        }
+
+        void restore(const std::size_t index_,
+            basic_match_results<sm_type>& results_) const
+        {
+            const checkpoint& cp_ = _checkpoints[index_];
+            std::size_t frame_ = cp_._top;
+
+            results_.stack.resize(cp_._depth);
+
+            for (std::size_t idx_ = cp_._depth; idx_-- > 0;)
+            {
+                results_.stack[idx_] = _frames[frame_]._state;
+                frame_ = _frames[frame_]._parent;
+            }
+
+            results_.token_id = cp_._token_id;
+            results_.entry = cp_._entry;
+        }
+
+        // Position of the lookahead token when the checkpoint was taken.
+        iter_type position(const std::size_t index_) const
+        {
+            return _checkpoints[index_]._position;
+        }
+
+        // Re-create the lexer iterator for a checkpoint.
+        // Note that any lexer start state is not recorded.
+        template<typename lsm_type>
+        lexer_iterator lexer_iter(const std::size_t index_,
+            const iter_type& eoi_, const lsm_type& lsm_) const
+        {
+            return lexer_iterator(_checkpoints[index_]._position, eoi_, lsm_);
+        }
+
+        // Write a self contained copy of a checkpoint.
+        // Iterators are stored as offsets from base_.
+        template<class stream>
+        void save(const std::size_t index_, const iter_type& base_,
+            stream& stream_) const
+        {
+            const checkpoint& cp_ = _checkpoints[index_];
+            basic_match_results<sm_type> results_;
+            token_vector productions_;
+
+            restore(index_, results_, productions_);
+            // Version number
+            stream_ << 1 << '\n';
+            stream_ << sizeof(id_type) << '\n';
+            // ids are written as numbers, even when id_type is a char type
+            stream_ << static_cast<std::size_t>(results_.token_id) << ' ';
+            stream_ << static_cast<std::size_t>(results_.entry.action) << ' ';
+            stream_ << static_cast<std::size_t>(results_.entry.param) << '\n';
+            stream_ << cp_._position - base_ << '\n';
+            stream_ << results_.stack.size() << '\n';
+
+            for (const auto state_ : results_.stack)
+            {
+                stream_ << static_cast<std::size_t>(state_) << ' ';
+            }
+
+            stream_ << '\n' << productions_.size() << '\n';
+
+            for (const auto& token_ : productions_)
+            {
+                stream_ << token_.id << ' ' << token_.first - base_ << ' ' <<
+                    token_.second - base_ << '\n';
+            }
+        }
+
+        // Read a checkpoint written by save() and return its new index.
+        template<class stream>
+        std::size_t load(stream& stream_, const iter_type& base_)
+        {
+            basic_match_results<sm_type> results_;
+            token_vector productions_;
+
+            if (read(stream_) != 1)
+                throw runtime_error("Unknown version in "
+                    "basic_checkpoints::load()");
+
+            if (read(stream_) != sizeof(id_type))
+                throw runtime_error("id_type mismatch in "
+                    "basic_checkpoints::load()");
+
+            results_.token_id = static_cast<id_type>(read(stream_));
+
+            std::size_t num_ = read(stream_);
+
+            if (num_ > static_cast<std::size_t>(action::accept))
+                corrupt();
+
+            results_.entry.action = static_cast<action>(num_);
+            results_.entry.param = static_cast<id_type>(read(stream_));
+
+            const iter_type position_ = base_ + read(stream_);
+
+            // There is always at least the initial state.
+            // The counts are not trusted for allocation, so a bad count
+            // fails when the stream runs out.
+            num_ = read(stream_);
+
+            if (num_ == 0)
+                corrupt();
+
+            results_.stack.clear();
+
+            for (; num_ > 0; --num_)
+            {
+                results_.stack.push_back(static_cast<id_type>(read(stream_)));
+            }
+
+            num_ = read(stream_);
+
+            if (num_ != results_.stack.size() &&
+                num_ + 1 != results_.stack.size())
+            {
+                corrupt();
+            }
+
+            productions_.resize(num_);
+
+            for (auto& token_ : productions_)
+            {
+                token_.id = read(stream_);
+                token_.first = base_ + read(stream_);
+                token_.second = base_ + read(stream_);
+            }
+
+            checkpoint cp_;
+
+            if (productions_.size() == results_.stack.size())
+            {
+                cp_._pending = true;
+                cp_._pending_token = productions_.back();
+            }
+
+            cp_._top = _frames.share(results_.stack, &productions_, 0,
+                identity());
+            cp_._depth = results_.stack.size();
+            cp_._token_id = results_.token_id;
+            cp_._entry = results_.entry;
+            cp_._position = position_;
+            return add(cp_);
+        }
+
+    private:
+        struct checkpoint
+        {
+            std::size_t _top = static_cast<std::size_t>(~0);
+            std::size_t _depth = 0;
+            id_type _token_id = static_cast<id_type>(~0);
+            entry _entry;
+            iter_type _position = iter_type();
+            bool _pending = false;
+            token _pending_token;
+        };
+
+        struct identity
+        {
+            const token& operator ()(const token& token_) const
+            {
+                return token_;
+            }
+        };
+
+        details::stack_frames<id_type, token> _frames;
+        std::vector<checkpoint> _checkpoints;
+        // Released checkpoints
+        std::vector<std::size_t> _free;
+
+        static void corrupt()
+        {
+            throw runtime_error("Corrupt checkpoint in "
+                "basic_checkpoints::load()");
+        }
+
+        // Throws if the stream has run out or holds something
+        // other than a number.
+        template<class stream>
+        static std::size_t read(stream& stream_)
+        {
+            std::size_t num_ = 0;
+
+            stream_ >> num_;
+
+            if (!stream_)
+                corrupt();
+
+            return num_;
+        }
+
+        std::size_t add(const checkpoint& cp_)
+        {
+            if (_free.empty())
+            {
+                _checkpoints.push_back(cp_);
+                return _checkpoints.size() - 1;
+            }
+
+            const std::size_t index_ = _free.back();
+
+            _free.pop_back();
+            _checkpoints[index_] = cp_;
+            return index_;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,169 @@
+// columns.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_COLUMNS_HPP
+#define PARSERTL_COLUMNS_HPP
+
+#include "lookup.hpp"
+#include "match_results.hpp"
+#include "runtime_error.hpp"
+#include "token.hpp"
+#include <utility>
+#include <vector>
+
+namespace parsertl
+{
+    // Binds captures and/or rules to output columns. As each bound rule
+    // is reduced, the span of the capture (or of the whole rule) is
+    // appended to the end of its column, so a parse of N records fills
+    // each column with N contiguous entries.
+    // Converter (optional) is called as converter_(first_, second_) and
+    // its result is what gets stored. It defaults to storing the span.
+    template<typename sm_type, typename lexer_iterator,
+        typename value_type = std::pair<typename
+        token<lexer_iterator>::iter_type, typename
+        token<lexer_iterator>::iter_type>>
+    class basic_columns
+    {
+    public:
+        using id_type = typename sm_type::id_type;
+        // Qualify token to prevent arg dependant lookup
+        using token = parsertl::token<lexer_iterator>;
+        using token_vector = typename token::token_vector;
+        using iter_type = typename token::iter_type;
+        using column = std::vector<value_type>;
+
+        // capture_ uses the same numbering as the captures passed
+        // to match(), i.e. 1 is the first capture in the grammar.
+        // Returns the new column index.
+        std::size_t bind_capture(const sm_type& sm_, const std::size_t capture_)
+        {
+            for (std::size_t rule_ = 0, size_ = sm_._captures.size();
+                rule_ < size_; ++rule_)
+            {
+                const auto& row_ = sm_._captures[rule_];
+
+                if (capture_ > row_.first &&
+                    capture_ <= row_.first + row_.second.size())
+                {
+                    const auto& pair_ = row_.second[capture_ - row_.first - 1];
+
+                    return bind(rule_, pair_.first, pair_.second);
+                }
+            }
+
+            throw runtime_error("Unknown capture index passed to "
+                "basic_columns::bind_capture().");
+        }
+
+        // The whole span of rule rule_id_ becomes a column.
+        // Empty rules are not supported.
+        std::size_t bind_rule(const sm_type& sm_, const std::size_t rule_id_)
+        {
+            const std::size_t size_ = rule_id_ < sm_._rules.size() ?
+                sm_._rules[rule_id_]._rhs.size() : 0;
+
+            if (size_ == 0)
+                throw runtime_error("Invalid rule passed to "
+                    "basic_columns::bind_rule().");
+
+            return bind(rule_id_, 0, size_ - 1);
+        }
+
+        std::size_t columns() const
+        {
+            return _columns.size();
+        }
+
+        const column& operator [](const std::size_t index_) const
+        {
+            return _columns[index_];
+        }
+
+        column& operator [](const std::size_t index_)
+        {
+            return _columns[index_];
+        }
+
+        // Empty the columns, keeping the bindings and capacity.
+        void clear()
+        {
+            for (auto& column_ : _columns)
+            {
+                column_.clear();
+            }
+        }
+
+        template<typename converter>
+        bool parse(lexer_iterator iter_, const sm_type& sm_,
+            converter&& converter_)
+        {
+            basic_match_results<sm_type> results_(iter_->id, sm_);
+
+            _productions.clear();
+
+            while (results_.entry.action != action::error &&
+                results_.entry.action != action::accept)
+            {
+                if (results_.entry.action == action::reduce &&
+                    results_.entry.param < _bindings.size())
+                {
+                    for (const auto& binding_ :
+                        _bindings[results_.entry.param])
+                    {
+                        const auto& token1_ = results_.
+                            dollar(binding_._first, sm_, _productions);
+                        const auto& token2_ = results_.
+                            dollar(binding_._second, sm_, _productions);
+
+                        _columns[binding_._column].push_back
+                            (converter_(token1_.first, token2_.second));
+                    }
+                }
+
+                lookup(iter_, sm_, results_, _productions);
+            }
+
+            return results_.entry.action == action::accept;
+        }
+
+        // Append the records in the input to the columns.
+        bool parse(lexer_iterator iter_, const sm_type& sm_)
+        {
+            return parse(iter_, sm_,
+                [](const iter_type& first_, const iter_type& second_)
+                {
+                    return value_type(first_, second_);
+                });
+        }
+
+    private:
+        struct binding
+        {
+            std::size_t _first;
+            std::size_t _second;
+            std::size_t _column;
+        };
+
+        // Indexed by rule id
+        std::vector<std::vector<binding>> _bindings;
+        std::vector<column> _columns;
+        token_vector _productions;
+
+        std::size_t bind(const std::size_t rule_id_, const std::size_t first_,
+            const std::size_t second_)
+        {
+            if (_bindings.size() <= rule_id_)
+                _bindings.resize(rule_id_ + 1);
+
+            _bindings[rule_id_].push_back(binding{ first_, second_,
+                _columns.size() });
+            _columns.emplace_back();
+            return _columns.size() - 1;
+        }
+    };
+}
+
+#endif
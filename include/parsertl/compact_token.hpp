@@ -0,0 +1,288 @@
+// compact_token.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_COMPACT_TOKEN_HPP
+#define PARSERTL_COMPACT_TOKEN_HPP
+
+#include <cstdint>
+#include <iterator>
+#include "runtime_error.hpp"
+#include "token.hpp"
+#include <vector>
+
+namespace parsertl
+{
+    // 12 byte alternative to token, storing offsets from a base iterator
+    // instead of a pair of iterators.
+    template<typename lexer_iterator>
+    struct compact_token
+    {
+        using iter_type = typename lexer_iterator::value_type::iter_type;
+        // Qualify token to prevent arg dependant lookup
+        using token = parsertl::token<lexer_iterator>;
+
+        uint32_t id = static_cast<uint32_t>(~0);
+        uint32_t first = 0;
+        uint32_t length = 0;
+
+        compact_token() = default;
+
+        compact_token(const std::size_t id_, const iter_type& base_,
+            const iter_type& first_, const iter_type& second_) :
+            id(narrow_id(id_)),
+            first(offset(first_ - base_)),
+            length(offset(second_ - first_))
+        {
+        }
+
+        token to_token(const iter_type& base_) const
+        {
+            const iter_type first_ = base_ + first;
+
+            return token(id == static_cast<uint32_t>(~0) ?
+                static_cast<std::size_t>(~0) : id,
+                first_, first_ + length);
+        }
+
+    private:
+        // npos (token::id's default) is stored as ~uint32_t, so that
+        // value is not available to other ids.
+        static uint32_t narrow_id(const std::size_t id_)
+        {
+            if (id_ == static_cast<std::size_t>(~0))
+                return static_cast<uint32_t>(~0);
+
+            if (id_ >= static_cast<uint32_t>(~0))
+            {
+                throw runtime_error("Id out of range for "
+                    "compact_token.");
+            }
+
+            return static_cast<uint32_t>(id_);
+        }
+
+        template<typename diff_type>
+        static uint32_t offset(const diff_type diff_)
+        {
+            if (diff_ < 0 || static_cast<uint64_t>(diff_) >
+                static_cast<uint32_t>(~0))
+            {
+                throw runtime_error("Offset out of range for "
+                    "compact_token.");
+            }
+
+            return static_cast<uint32_t>(diff_);
+        }
+    };
+
+    // Drop in replacement for token::token_vector, usable with lookup(),
+    // match() and basic_match_results::dollar(). Tokens are stored as
+    // compact_tokens and converted back to tokens on access, so elements
+    // are returned by value rather than by reference.
+    template<typename lexer_iterator>
+    class compact_token_vector
+    {
+    public:
+        // Qualify token to prevent arg dependant lookup
+        using token = parsertl::token<lexer_iterator>;
+        using value_type = token;
+        using size_type = std::size_t;
+        using iter_type = typename token::iter_type;
+        using compact_vector = std::vector<compact_token<lexer_iterator>>;
+
+        class const_iterator
+        {
+        public:
+            using value_type = token;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type*;
+            using reference = value_type;
+            using iterator_category = std::random_access_iterator_tag;
+
+            // Allows iter->first on a token that only exists temporarily
+            struct arrow_proxy
+            {
+                token _token;
+
+                const token* operator ->() const
+                {
+                    return &_token;
+                }
+            };
+
+            const_iterator() = default;
+
+            const_iterator(const compact_token_vector& vec_,
+                const std::size_t index_) :
+                _vec(&vec_),
+                _index(index_)
+            {
+            }
+
+            value_type operator *() const
+            {
+                return (*_vec)[_index];
+            }
+
+            arrow_proxy operator ->() const
+            {
+                return arrow_proxy{ (*_vec)[_index] };
+            }
+
+            const_iterator& operator ++()
+            {
+                ++_index;
+                return *this;
+            }
+
+            const_iterator operator ++(int)
+            {
+                const_iterator iter_ = *this;
+
+                ++_index;
+                return iter_;
+            }
+
+            const_iterator& operator --()
+            {
+                --_index;
+                return *this;
+            }
+
+            const_iterator operator --(int)
+            {
+                const_iterator iter_ = *this;
+
+                --_index;
+                return iter_;
+            }
+
+            const_iterator operator +(const difference_type diff_) const
+            {
+                return const_iterator(*_vec, static_cast<std::size_t>
+                    (static_cast<difference_type>(_index) + diff_));
+            }
+
+            const_iterator operator -(const difference_type diff_) const
+            {
+                return *this + -diff_;
+            }
+
+            difference_type operator -(const const_iterator& rhs_) const
+            {
+                return static_cast<difference_type>(_index) -
+                    static_cast<difference_type>(rhs_._index);
+            }
+
+            bool operator ==(const const_iterator& rhs_) const
+            {
+                return _vec == rhs_._vec && _index == rhs_._index;
+            }
+
+            bool operator !=(const const_iterator& rhs_) const
+            {
+                return !(*this == rhs_);
+            }
+
+        private:
+            const compact_token_vector* _vec = nullptr;
+            std::size_t _index = 0;
+        };
+
+        using iterator = const_iterator;
+
+        // All offsets are relative to base_, which is normally the
+        // start of the input. Set the base before using the vector with
+        // lookup() directly. match() sets it for each input.
+        explicit compact_token_vector(const iter_type& base_ = iter_type()) :
+            _base(base_)
+        {
+        }
+
+        const iter_type& base() const
+        {
+            return _base;
+        }
+
+        // Only valid when empty
+        void base(const iter_type& base_)
+        {
+            _base = base_;
+        }
+
+        const compact_vector& compact() const
+        {
+            return _tokens;
+        }
+
+        bool empty() const
+        {
+            return _tokens.empty();
+        }
+
+        std::size_t size() const
+        {
+            return _tokens.size();
+        }
+
+        void clear()
+        {
+            _tokens.clear();
+        }
+
+        void reserve(const std::size_t size_)
+        {
+            _tokens.reserve(size_);
+        }
+
+        void resize(const std::size_t size_)
+        {
+            _tokens.resize(size_);
+        }
+
+        value_type operator [](const std::size_t index_) const
+        {
+            return _tokens[index_].to_token(_base);
+        }
+
+        value_type front() const
+        {
+            return _tokens.front().to_token(_base);
+        }
+
+        value_type back() const
+        {
+            return _tokens.back().to_token(_base);
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator(*this, 0);
+        }
+
+        const_iterator end() const
+        {
+            return const_iterator(*this, _tokens.size());
+        }
+
+        void push_back(const token& token_)
+        {
+            _tokens.emplace_back(token_.id, _base, token_.first,
+                token_.second);
+        }
+
+        void emplace_back(const std::size_t id_, const iter_type& first_,
+            const iter_type& second_)
+        {
+            _tokens.emplace_back(id_, _base, first_, second_);
+        }
+
+    private:
+        iter_type _base;
+        compact_vector _tokens;
+    };
+}
+
+#endif
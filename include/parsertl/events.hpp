@@ -0,0 +1,100 @@
+// events.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_EVENTS_HPP
+#define PARSERTL_EVENTS_HPP
+
+#include "lookup.hpp"
+#include "match_results.hpp"
+#include "token.hpp"
+#include <utility>
+#include <vector>
+
+namespace parsertl
+{
+    // Span of each parser stack entry, as maintained by parse_events().
+    template<typename lexer_iterator>
+    using event_spans = std::vector<std::pair<typename
+        token<lexer_iterator>::iter_type, typename
+        token<lexer_iterator>::iter_type>>;
+
+    // Parse entire sequence pushing events into sink_, which must provide:
+    //   void shift(const typename lexer_iterator::value_type& token_)
+    //   void reduce(std::size_t rule_id_, const iter_type& first_,
+    //       const iter_type& second_)
+    // The token passed to shift() is the lexer's own, and the reduce span
+    // refers directly into the input. Only the span of each stack entry is
+    // tracked (in spans_, which is cleared first and can be reused across
+    // calls so that its capacity is kept), no production vector is built.
+    // End of input is not passed to shift().
+    template<typename lexer_iterator, typename sm_type, typename sink>
+    bool parse_events(lexer_iterator& iter_, const sm_type& sm_,
+        basic_match_results<sm_type>& results_, sink& sink_,
+        event_spans<lexer_iterator>& spans_)
+    {
+        // Qualify token to prevent arg dependant lookup
+        using iter_type = typename parsertl::token<lexer_iterator>::iter_type;
+
+        spans_.clear();
+
+        while (results_.entry.action != action::error &&
+            results_.entry.action != action::accept)
+        {
+            switch (results_.entry.action)
+            {
+            case action::shift:
+                if (iter_->id != 0)
+                {
+                    sink_.shift(*iter_);
+                    spans_.emplace_back(iter_->first, iter_->second);
+                }
+
+                break;
+            case action::reduce:
+            {
+                const std::size_t size_ =
+                    sm_._rules[results_.entry.param]._rhs.size();
+
+                if (size_)
+                {
+                    const std::size_t start_ = spans_.size() - size_;
+
+                    spans_[start_].second = spans_.back().second;
+                    spans_.resize(start_ + 1);
+                }
+                else
+                {
+                    const iter_type pos_ = spans_.empty() ?
+                        iter_->first : spans_.back().second;
+
+                    spans_.emplace_back(pos_, pos_);
+                }
+
+                sink_.reduce(results_.entry.param, spans_.back().first,
+                    spans_.back().second);
+                break;
+            }
+            default:
+                // action::go_to
+                break;
+            }
+
+            lookup(iter_, sm_, results_);
+        }
+
+        return results_.entry.action == action::accept;
+    }
+
+    template<typename lexer_iterator, typename sm_type, typename sink>
+    bool parse_events(lexer_iterator& iter_, const sm_type& sm_,
+        basic_match_results<sm_type>& results_, sink& sink_)
+    {
+        event_spans<lexer_iterator> spans_;
+
+        return parse_events(iter_, sm_, results_, sink_, spans_);
+    }
+}
+
+#endif
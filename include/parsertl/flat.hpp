@@ -0,0 +1,411 @@
+// flat.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_FLAT_HPP
+#define PARSERTL_FLAT_HPP
+
+#include <algorithm>
+#include "capture.hpp"
+#include <utility>
+#include <vector>
+
+// Vector based alternatives to the std::set, std::multimap and
+// std::vector<std::vector<capture>> results of search(). Each holds its
+// contents in one or two contiguous buffers which are reused when the
+// container is passed to search() again, so there is no allocation per
+// production. search() still has working memory of its own unless it is
+// given a basic_search_scratch to reuse (see search.hpp).
+namespace parsertl
+{
+    // A set of rule ids. insert() appends, sorting (and removal of
+    // duplicates) is deferred until the contents are read.
+    template<typename id_type>
+    class basic_flat_set
+    {
+    public:
+        using const_iterator = typename std::vector<id_type>::const_iterator;
+
+        void insert(const id_type id_)
+        {
+            if (!_ids.empty())
+            {
+                if (_ids.back() == id_)
+                    return;
+
+                if (_ids.back() > id_)
+                    _sorted = false;
+            }
+
+            _ids.push_back(id_);
+        }
+
+        void clear()
+        {
+            _ids.clear();
+            _sorted = true;
+        }
+
+        bool empty() const
+        {
+            return _ids.empty();
+        }
+
+        std::size_t size() const
+        {
+            sort();
+            return _ids.size();
+        }
+
+        std::size_t count(const id_type id_) const
+        {
+            sort();
+            return std::binary_search(_ids.begin(), _ids.end(), id_) ? 1 : 0;
+        }
+
+        const_iterator find(const id_type id_) const
+        {
+            sort();
+
+            auto iter_ = std::lower_bound(_ids.begin(), _ids.end(), id_);
+
+            return iter_ != _ids.end() && *iter_ == id_ ? iter_ : _ids.end();
+        }
+
+        const_iterator begin() const
+        {
+            sort();
+            return _ids.begin();
+        }
+
+        const_iterator end() const
+        {
+            sort();
+            return _ids.end();
+        }
+
+    private:
+        mutable std::vector<id_type> _ids;
+        mutable bool _sorted = true;
+
+        void sort() const
+        {
+            if (!_sorted)
+            {
+                std::sort(_ids.begin(), _ids.end());
+                _ids.erase(std::unique(_ids.begin(), _ids.end()), _ids.end());
+                _sorted = true;
+            }
+        }
+    };
+
+    // Productions (rule id plus rhs tokens) in the order they were
+    // reduced. All tokens are held in a single vector and each
+    // production refers to a range within it.
+    template<typename id_type, typename token_vector>
+    class basic_flat_productions
+    {
+    public:
+        using token_type = typename token_vector::value_type;
+
+        // Valid until the container is next modified.
+        struct production
+        {
+            id_type id = 0;
+            const token_type* first = nullptr;
+            const token_type* second = nullptr;
+
+            const token_type* begin() const
+            {
+                return first;
+            }
+
+            const token_type* end() const
+            {
+                return second;
+            }
+
+            std::size_t size() const
+            {
+                return second - first;
+            }
+
+            const token_type& operator [](const std::size_t index_) const
+            {
+                return first[index_];
+            }
+
+            const token_type& front() const
+            {
+                return *first;
+            }
+
+            const token_type& back() const
+            {
+                return second[-1];
+            }
+        };
+
+        void clear()
+        {
+            _entries.clear();
+            _tokens.clear();
+            _sorted = true;
+        }
+
+        bool empty() const
+        {
+            return _entries.empty();
+        }
+
+        std::size_t size() const
+        {
+            return _entries.size();
+        }
+
+        template<typename iterator>
+        void push(const id_type id_, const iterator& first_,
+            const iterator& second_)
+        {
+            entry entry_;
+
+            entry_._id = id_;
+            entry_._first = _tokens.size();
+            _tokens.insert(_tokens.end(), first_, second_);
+            entry_._second = _tokens.size();
+
+            if (!_entries.empty() && _entries.back()._id > id_)
+                _sorted = false;
+
+            _entries.push_back(entry_);
+        }
+
+        // Roll back to the first size_ productions.
+        // Only meaningful before sort() has been called.
+        void truncate(const std::size_t size_)
+        {
+            if (size_ < _entries.size())
+            {
+                _tokens.resize(_entries[size_]._first);
+                _entries.resize(size_);
+            }
+        }
+
+        production operator [](const std::size_t index_) const
+        {
+            const entry& entry_ = _entries[index_];
+            production prod_;
+
+            prod_.id = entry_._id;
+            prod_.first = _tokens.data() + entry_._first;
+            prod_.second = _tokens.data() + entry_._second;
+            return prod_;
+        }
+
+        // Order by rule id (reduction order is kept for equal ids),
+        // as for the std::multimap overload of search().
+        void sort()
+        {
+            if (!_sorted)
+            {
+                std::stable_sort(_entries.begin(), _entries.end(),
+                    [](const entry& lhs_, const entry& rhs_)
+                    {
+                        return lhs_._id < rhs_._id;
+                    });
+                _sorted = true;
+            }
+        }
+
+        // Index range of the productions for rule id_.
+        // Sorts if necessary.
+        std::pair<std::size_t, std::size_t> equal_range(const id_type id_)
+        {
+            sort();
+
+            auto pair_ = std::equal_range(_entries.begin(), _entries.end(),
+                id_, compare());
+
+            return std::make_pair(pair_.first - _entries.begin(),
+                pair_.second - _entries.begin());
+        }
+
+    private:
+        struct entry
+        {
+            id_type _id = 0;
+            std::size_t _first = 0;
+            std::size_t _second = 0;
+        };
+
+        struct compare
+        {
+            bool operator ()(const entry& lhs_, const id_type rhs_) const
+            {
+                return lhs_._id < rhs_;
+            }
+
+            bool operator ()(const id_type lhs_, const entry& rhs_) const
+            {
+                return lhs_ < rhs_._id;
+            }
+        };
+
+        std::vector<entry> _entries;
+        token_vector _tokens;
+        bool _sorted = true;
+    };
+
+    // Captures held in a single buffer, with the captures for each index
+    // stored contiguously. Index 0 is the whole match, as for match().
+    template<typename iterator>
+    class basic_flat_captures
+    {
+    public:
+        using capture_type = capture<iterator>;
+
+        // Valid until the container is next modified.
+        struct view
+        {
+            const capture_type* first = nullptr;
+            const capture_type* second = nullptr;
+
+            const capture_type* begin() const
+            {
+                return first;
+            }
+
+            const capture_type* end() const
+            {
+                return second;
+            }
+
+            bool empty() const
+            {
+                return first == second;
+            }
+
+            std::size_t size() const
+            {
+                return second - first;
+            }
+
+            const capture_type& operator [](const std::size_t index_) const
+            {
+                return first[index_];
+            }
+
+            const capture_type& front() const
+            {
+                return *first;
+            }
+
+            const capture_type& back() const
+            {
+                return second[-1];
+            }
+        };
+
+        void clear()
+        {
+            _captures.clear();
+            _offsets.clear();
+        }
+
+        bool empty() const
+        {
+            return _offsets.empty();
+        }
+
+        // Number of capture indexes
+        std::size_t size() const
+        {
+            return _offsets.empty() ? 0 : _offsets.size() - 1;
+        }
+
+        view operator [](const std::size_t index_) const
+        {
+            view view_;
+
+            view_.first = _captures.data() + _offsets[index_];
+            view_.second = _captures.data() + _offsets[index_ + 1];
+            return view_;
+        }
+
+        // Fills in the captures from productions_ (as recorded by
+        // search()) for a match starting at first_.
+        template<typename sm_type, typename productions>
+        void assign(const sm_type& sm_, const productions& productions_,
+            const iterator& first_)
+        {
+            const std::size_t size_ = (sm_._captures.empty() ? 0 :
+                sm_._captures.back().first +
+                sm_._captures.back().second.size()) + 1;
+            iterator last_ = first_;
+
+            // Count the captures per index, then convert the counts
+            // to offsets and fill in.
+            _offsets.assign(size_ + 1, 0);
+            _offsets[1] = 1;
+
+            for (std::size_t idx_ = 0, prods_ = productions_.size();
+                idx_ < prods_; ++idx_)
+            {
+                const auto prod_ = productions_[idx_];
+
+                if (sm_._captures.size() > prod_.id)
+                {
+                    const auto& row_ = sm_._captures[prod_.id];
+
+                    for (std::size_t index_ = 0, count_ = row_.second.size();
+                        index_ < count_; ++index_)
+                    {
+                        ++_offsets[row_.first + index_ + 2];
+                    }
+                }
+
+                if (prod_.back().second > last_)
+                    last_ = prod_.back().second;
+            }
+
+            for (std::size_t idx_ = 1; idx_ <= size_; ++idx_)
+            {
+                _offsets[idx_] += _offsets[idx_ - 1];
+            }
+
+            _captures.resize(_offsets[size_]);
+            _cursor.assign(_offsets.begin(), _offsets.end() - 1);
+            _captures[_cursor[0]++] = capture_type(first_, last_);
+
+            for (std::size_t idx_ = 0, prods_ = productions_.size();
+                idx_ < prods_; ++idx_)
+            {
+                const auto prod_ = productions_[idx_];
+
+                if (sm_._captures.size() > prod_.id)
+                {
+                    const auto& row_ = sm_._captures[prod_.id];
+                    std::size_t index_ = row_.first + 1;
+
+                    for (const auto& token_ : row_.second)
+                    {
+                        _captures[_cursor[index_]++] =
+                            capture_type(prod_[token_.first].first,
+                                prod_[token_.second].second);
+                        ++index_;
+                    }
+                }
+            }
+        }
+
+    private:
+        std::vector<capture_type> _captures;
+        // Start of each index in _captures, plus the end
+        std::vector<std::size_t> _offsets;
+        // Next free slot per index during assign()
+        std::vector<std::size_t> _cursor;
+    };
+}
+
+#endif
@@ -94,6 +94,7 @@ namespace parsertl
             assert(static_cast<id_type>(sm_._rows - 1) == sm_._rows - 1);
             copy_rules(rules_, sm_);
             sm_._captures = rules_.captures();
+            build_prefilter(sm_);
         }
 
         static void build_dfa(rules& rules_, dfa& dfa_)
@@ -0,0 +1,480 @@
+// incremental.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_INCREMENTAL_HPP
+#define PARSERTL_INCREMENTAL_HPP
+
+#include <algorithm>
+#include "checkpoint.hpp"
+#include "lookup.hpp"
+#include "match_results.hpp"
+#include "scan_iterator.hpp"
+#include "token.hpp"
+#include <unordered_set>
+#include <vector>
+
+namespace parsertl
+{
+    // Parses a document, recording every reduction along with snapshots of
+    // the parser state every interval_ tokens. After an edit, reparse()
+    // resumes from the last snapshot before the edit and stops as soon as
+    // the parser state lines up with a snapshot from the previous parse.
+    // The reductions of the previous parse from that point on are reused.
+    // All positions are offsets from the start of the document.
+    // Snapshots keep their stacks in shared frames (see
+    // basic_checkpoints), so each one only adds the entries pushed since
+    // the one before.
+    // The lexer must not have start states, as restarts use INITIAL.
+    // lexer_iterator must take the form of lexertl::iterator, as it is
+    // rebound to a details::scan_iterator so that each snapshot knows how
+    // far the lexer had read (which may be beyond the end of the tokens
+    // when the lexer backtracks).
+    template<typename sm_type, typename lexer_iterator>
+    class basic_incremental_parser
+    {
+    public:
+        using id_type = typename sm_type::id_type;
+        using entry = typename sm_type::entry;
+        // Qualify token to prevent arg dependant lookup
+        using token = parsertl::token<lexer_iterator>;
+        using token_vector = typename token::token_vector;
+        using iter_type = typename token::iter_type;
+
+        struct reduction
+        {
+            id_type _rule = 0;
+            std::size_t _first = 0;
+            std::size_t _second = 0;
+
+            reduction() = default;
+
+            reduction(const id_type rule_, const std::size_t first_,
+                const std::size_t second_) :
+                _rule(rule_),
+                _first(first_),
+                _second(second_)
+            {
+            }
+        };
+
+        using reduction_vector = std::vector<reduction>;
+
+        explicit basic_incremental_parser(const std::size_t interval_ = 64) :
+            _interval(interval_ ? interval_ : 1)
+        {
+        }
+
+        template<typename lsm_type>
+        bool parse(const iter_type& first_, const iter_type& last_,
+            const lsm_type& lsm_, const sm_type& sm_)
+        {
+            iter_type furthest_ = first_;
+            const scan_iter sfirst_(first_, &furthest_);
+            scan_lexer iter_(sfirst_, scan_iter(last_, &furthest_), lsm_);
+            basic_match_results<sm_type> results_(iter_->id, sm_);
+            scan_token_vector productions_;
+            std::vector<snapshot> old_;
+
+            _snapshots.clear();
+            _frames.clear();
+            _reductions.clear();
+            _reused = 0;
+            _unchanged = 0;
+            run(sfirst_, iter_, sm_, results_, productions_, 0, old_, 0, 0);
+            return _accepted;
+        }
+
+        // [first_, last_) is the edited document in which the
+        // old_length_ characters starting at offset_ were replaced
+        // by new_length_ characters.
+        template<typename lsm_type>
+        bool reparse(const iter_type& first_, const iter_type& last_,
+            const std::size_t offset_, const std::size_t old_length_,
+            const std::size_t new_length_, const lsm_type& lsm_,
+            const sm_type& sm_)
+        {
+            // Every character the lexer read up to and including the
+            // lookahead token of the snapshot must come before the edit,
+            // otherwise any of those tokens may be lexed differently this
+            // time (e.g. "1..x" becoming "1..5" with a range rule).
+            auto iter_ = std::lower_bound(_snapshots.begin(),
+                _snapshots.end(), offset_,
+                [](const snapshot& lhs_, const std::size_t rhs_)
+                {
+                    return lhs_._scanned < rhs_;
+                });
+
+            if (iter_ == _snapshots.begin())
+                return parse(first_, last_, lsm_, sm_);
+
+            const auto index_ = static_cast<std::size_t>
+                (iter_ - _snapshots.begin()) - 1;
+            std::vector<snapshot> old_(_snapshots.begin() + index_ + 1,
+                _snapshots.end());
+            const snapshot start_ = _snapshots[index_];
+            iter_type furthest_ = first_ + start_._scanned;
+            const scan_iter sfirst_(first_, &furthest_);
+            scan_lexer lex_iter_(sfirst_ + start_._offset,
+                scan_iter(last_, &furthest_), lsm_);
+            basic_match_results<sm_type> results_;
+            scan_token_vector productions_;
+
+            restore(start_, sfirst_, results_, productions_);
+            // The remaining old reductions are held in old_reductions_
+            // until either they can be reused or are discarded.
+            _old_reductions.assign(_reductions.begin() +
+                start_._reductions, _reductions.end());
+            _old_base = start_._reductions;
+            _reductions.resize(start_._reductions);
+            // Later frames may be in old coordinates, so new snapshots
+            // must only share those that come before the edit.
+            _frames.rewind(start_._top);
+            // Taken again by the first shift of run()
+            _frames.release(start_._top);
+            _snapshots.resize(index_);
+            _reused = 0;
+            _unchanged = 0;
+            run(sfirst_, lex_iter_, sm_, results_, productions_, 0, old_,
+                offset_ + new_length_, static_cast<std::ptrdiff_t>
+                (new_length_) - static_cast<std::ptrdiff_t>(old_length_));
+
+            // Those not taken over by resync()
+            for (const auto& s_ : old_)
+            {
+                _frames.release(s_._top);
+            }
+
+            _old_reductions.clear();
+            return _accepted;
+        }
+
+        bool accepted() const
+        {
+            return _accepted;
+        }
+
+        const reduction_vector& reductions() const
+        {
+            return _reductions;
+        }
+
+        // Number of reductions taken from the previous parse
+        // by the last call to reparse().
+        std::size_t reused() const
+        {
+            return _reused;
+        }
+
+        std::size_t snapshots() const
+        {
+            return _snapshots.size();
+        }
+
+        // Stack entries stored for all of the snapshots
+        std::size_t frames() const
+        {
+            return _frames.size();
+        }
+
+    private:
+        // Lexes through a scan_iterator (see reparse())
+        using scan_iter = details::scan_iterator<iter_type>;
+        using scan_lexer =
+            typename details::rebind_lexer<lexer_iterator, scan_iter>::type;
+        using scan_token = parsertl::token<scan_lexer>;
+        using scan_token_vector = typename scan_token::token_vector;
+
+        // As token, but with offsets from the start of the document
+        struct offset_token
+        {
+            std::size_t id = 0;
+            std::size_t first = 0;
+            std::size_t second = 0;
+        };
+
+        using frame_store = details::stack_frames<id_type, offset_token>;
+
+        struct snapshot
+        {
+            // Offset of the lookahead token
+            std::size_t _offset = 0;
+            // End of the input read by the lexer so far
+            std::size_t _scanned = 0;
+            // Top of the parser stack in _frames
+            std::size_t _top = frame_store::npos();
+            std::size_t _depth = 0;
+            id_type _token_id = 0;
+            entry _entry;
+            // Number of reductions before this point
+            std::size_t _reductions = 0;
+        };
+
+        std::size_t _interval;
+        std::vector<snapshot> _snapshots;
+        frame_store _frames;
+        // Stack entries not popped since the last snapshot
+        std::size_t _unchanged = 0;
+        reduction_vector _reductions;
+        reduction_vector _old_reductions;
+        std::size_t _old_base = 0;
+        std::size_t _reused = 0;
+        bool _accepted = false;
+
+        static std::size_t shift(const std::size_t offset_,
+            const std::size_t edit_end_, const std::ptrdiff_t delta_)
+        {
+            // edit_end_ is in new document coordinates, so convert back
+            return offset_ >= static_cast<std::size_t>
+                (static_cast<std::ptrdiff_t>(edit_end_) - delta_) ?
+                static_cast<std::size_t>
+                (static_cast<std::ptrdiff_t>(offset_) + delta_) :
+                offset_;
+        }
+
+        static std::size_t shift_end(const std::size_t offset_,
+            const std::size_t edit_end_, const std::ptrdiff_t delta_)
+        {
+            // A token ending where text is inserted is not moved by it
+            return offset_ > static_cast<std::size_t>
+                (static_cast<std::ptrdiff_t>(edit_end_) - delta_) ?
+                static_cast<std::size_t>
+                (static_cast<std::ptrdiff_t>(offset_) + delta_) :
+                offset_;
+        }
+
+        bool same(const snapshot& old_, const scan_iter& first_,
+            const basic_match_results<sm_type>& results_,
+            const scan_token_vector& productions_,
+            const std::size_t edit_end_,
+            const std::ptrdiff_t delta_) const
+        {
+            if (old_._depth != results_.stack.size() ||
+                old_._token_id != results_.token_id ||
+                !(old_._entry == results_.entry) ||
+                old_._depth != productions_.size() + 1)
+            {
+                return false;
+            }
+
+            std::size_t frame_ = old_._top;
+
+            for (std::size_t idx_ = old_._depth; idx_-- > 0;)
+            {
+                const auto& f_ = _frames[frame_];
+
+                if (f_._state != results_.stack[idx_])
+                    return false;
+
+                if (idx_ > 0)
+                {
+                    const offset_token& o_ = f_._token;
+                    const scan_token& t_ = productions_[idx_ - 1];
+
+                    if (o_.id != t_.id ||
+                        shift(o_.first, edit_end_, delta_) !=
+                        static_cast<std::size_t>(t_.first - first_) ||
+                        shift_end(o_.second, edit_end_, delta_) !=
+                        static_cast<std::size_t>(t_.second - first_))
+                    {
+                        return false;
+                    }
+                }
+
+                frame_ = f_._parent;
+            }
+
+            return true;
+        }
+
+        void run(const scan_iter& first_, scan_lexer& iter_,
+            const sm_type& sm_, basic_match_results<sm_type>& results_,
+            scan_token_vector& productions_, std::size_t tokens_,
+            std::vector<snapshot>& old_, const std::size_t edit_end_,
+            const std::ptrdiff_t delta_)
+        {
+            while (results_.entry.action != action::error &&
+                results_.entry.action != action::accept)
+            {
+                if (results_.entry.action == action::shift)
+                {
+                    const auto offset_ =
+                        static_cast<std::size_t>(iter_->first - first_);
+
+                    if (!old_.empty() && offset_ >= edit_end_ &&
+                        resync(first_, results_, productions_, offset_,
+                            old_, edit_end_, delta_))
+                    {
+                        return;
+                    }
+
+                    if (tokens_++ % _interval == 0)
+                    {
+                        take_snapshot(first_, results_, productions_,
+                            offset_);
+                    }
+                }
+                else if (results_.entry.action == action::reduce)
+                {
+                    const std::size_t size_ =
+                        sm_._rules[results_.entry.param]._rhs.size();
+                    scan_iter start_ = size_ ?
+                        (productions_.end() - size_)->first :
+                        (productions_.empty() ? iter_->first :
+                            productions_.back().second);
+                    scan_iter end_ = size_ ?
+                        productions_.back().second :
+                        start_;
+
+                    _unchanged = std::min(_unchanged,
+                        results_.stack.size() - size_);
+                    _reductions.emplace_back(results_.entry.param,
+                        static_cast<std::size_t>(start_ - first_),
+                        static_cast<std::size_t>(end_ - first_));
+                }
+
+                lookup(iter_, sm_, results_, productions_);
+            }
+
+            _accepted = results_.entry.action == action::accept;
+        }
+
+        bool resync(const scan_iter& first_,
+            const basic_match_results<sm_type>& results_,
+            const scan_token_vector& productions_,
+            const std::size_t offset_, std::vector<snapshot>& old_,
+            const std::size_t edit_end_, const std::ptrdiff_t delta_)
+        {
+            const auto old_offset_ = static_cast<std::size_t>
+                (static_cast<std::ptrdiff_t>(offset_) - delta_);
+            auto iter_ = std::lower_bound(old_.begin(), old_.end(),
+                old_offset_, [](const snapshot& lhs_, const std::size_t rhs_)
+                {
+                    return lhs_._offset < rhs_;
+                });
+
+            if (iter_ == old_.end() || iter_->_offset != old_offset_ ||
+                !same(*iter_, first_, results_, productions_, edit_end_,
+                    delta_))
+            {
+                return false;
+            }
+
+            const std::size_t reuse_ = iter_->_reductions - _old_base;
+
+            for (auto r_ = _old_reductions.cbegin() + reuse_,
+                end_ = _old_reductions.cend(); r_ != end_; ++r_)
+            {
+                _reductions.emplace_back(r_->_rule,
+                    shift(r_->_first, edit_end_, delta_),
+                    shift(r_->_second, edit_end_, delta_));
+                ++_reused;
+            }
+
+            const std::ptrdiff_t adjust_ =
+                static_cast<std::ptrdiff_t>(_reductions.size()) -
+                static_cast<std::ptrdiff_t>(_old_base +
+                    _old_reductions.size());
+            const auto old_end_ = static_cast<std::size_t>
+                (static_cast<std::ptrdiff_t>(edit_end_) - delta_);
+            // Frames are shared, so each must be moved only once
+            std::unordered_set<std::size_t> shifted_;
+
+            for (auto s_ = iter_; s_ != old_.end(); ++s_)
+            {
+                s_->_offset = shift(s_->_offset, edit_end_, delta_);
+                // The new text before the edit may have been read further
+                s_->_scanned = std::max(shift(s_->_scanned, edit_end_,
+                    delta_), first_.scanned());
+
+                // Tokens further down the stack come earlier in the
+                // document, so stop at the first one before the edit.
+                for (std::size_t frame_ = s_->_top; frame_ !=
+                    frame_store::npos(); frame_ = _frames[frame_]._parent)
+                {
+                    auto& f_ = _frames[frame_];
+
+                    if (f_._parent == frame_store::npos() ||
+                        f_._token.second <= old_end_ ||
+                        !shifted_.insert(frame_).second)
+                    {
+                        break;
+                    }
+
+                    f_._token.first = shift(f_._token.first, edit_end_,
+                        delta_);
+                    f_._token.second = shift_end(f_._token.second,
+                        edit_end_, delta_);
+                }
+
+                s_->_reductions = static_cast<std::size_t>
+                    (static_cast<std::ptrdiff_t>(s_->_reductions) +
+                        adjust_);
+                _snapshots.push_back(*s_);
+            }
+
+            old_.erase(iter_, old_.end());
+            // The previous parse is reused, including its result
+            return true;
+        }
+
+        void take_snapshot(const scan_iter& first_,
+            const basic_match_results<sm_type>& results_,
+            const scan_token_vector& productions_,
+            const std::size_t offset_)
+        {
+            _snapshots.emplace_back();
+
+            snapshot& s_ = _snapshots.back();
+
+            s_._offset = offset_;
+            s_._scanned = first_.scanned();
+            s_._top = _frames.share(results_.stack, &productions_,
+                _unchanged, [&first_](const scan_token& t_)
+                {
+                    offset_token o_;
+
+                    o_.id = t_.id;
+                    o_.first = static_cast<std::size_t>(t_.first - first_);
+                    o_.second = static_cast<std::size_t>(t_.second - first_);
+                    return o_;
+                });
+            s_._depth = results_.stack.size();
+            s_._token_id = results_.token_id;
+            s_._entry = results_.entry;
+            s_._reductions = _reductions.size();
+            _unchanged = s_._depth;
+        }
+
+        void restore(const snapshot& s_, const scan_iter& first_,
+            basic_match_results<sm_type>& results_,
+            scan_token_vector& productions_) const
+        {
+            std::size_t frame_ = s_._top;
+
+            results_.stack.resize(s_._depth);
+            productions_.resize(s_._depth - 1);
+
+            for (std::size_t idx_ = s_._depth; idx_-- > 0;)
+            {
+                const auto& f_ = _frames[frame_];
+
+                results_.stack[idx_] = f_._state;
+
+                if (idx_ > 0)
+                {
+                    productions_[idx_ - 1] = scan_token(f_._token.id,
+                        first_ + f_._token.first, first_ + f_._token.second);
+                }
+
+                frame_ = f_._parent;
+            }
+
+            results_.token_id = s_._token_id;
+            results_.entry = s_._entry;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,232 @@
+// intern.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_INTERN_HPP
+#define PARSERTL_INTERN_HPP
+
+#include <algorithm>
+#include "capture.hpp"
+#include <cstdint>
+#include <memory>
+#include "runtime_error.hpp"
+#include <vector>
+
+namespace parsertl
+{
+    // Maps strings (typically token text) to small integer ids, so that
+    // identifiers can be compared by id without allocating a string per
+    // token. Text is copied once into fixed size blocks, so views remain
+    // valid until clear() is called. Lookup is via an open addressing
+    // hash table using FNV-1a.
+    // The pool plugs into the existing per-parse hooks rather than into
+    // match() itself, e.g. as the converter passed to
+    // basic_columns::parse() or from a parse_events() sink.
+    template<typename char_type, typename id_type = std::uint32_t>
+    class basic_intern_pool
+    {
+    public:
+        using view = capture<const char_type*>;
+
+        explicit basic_intern_pool(const std::size_t block_size_ = 4096) :
+            _block_size(block_size_ ? block_size_ : 1)
+        {
+        }
+
+        static id_type npos()
+        {
+            return static_cast<id_type>(~0);
+        }
+
+        template<typename iter_type>
+        id_type intern(const iter_type& first_, const iter_type& second_)
+        {
+            std::size_t length_ = 0;
+            const std::uint32_t hash_ = hash(first_, second_, length_);
+            std::size_t slot_ = find_slot(first_, second_, length_, hash_);
+
+            if (!_table.empty() && _table[slot_] != npos())
+                return _table[slot_];
+
+            if (_entries.size() >= npos())
+                throw runtime_error("basic_intern_pool is full.");
+
+            const id_type id_ = static_cast<id_type>(_entries.size());
+            entry entry_;
+
+            entry_._first = store(first_, second_, length_);
+            entry_._length = length_;
+            entry_._hash = hash_;
+            _entries.push_back(entry_);
+
+            // Keep the load factor at or below 0.5
+            if (_entries.size() * 2 > _table.size())
+                rehash();
+            else
+                _table[slot_] = id_;
+
+            return id_;
+        }
+
+        // Convenience for tokens, captures etc.
+        template<typename token_type>
+        id_type intern(const token_type& token_)
+        {
+            return intern(token_.first, token_.second);
+        }
+
+        // Returns npos() if the string has not been interned.
+        template<typename iter_type>
+        id_type find(const iter_type& first_, const iter_type& second_) const
+        {
+            if (_table.empty())
+                return npos();
+
+            std::size_t length_ = 0;
+            const std::uint32_t hash_ = hash(first_, second_, length_);
+
+            return _table[find_slot(first_, second_, length_, hash_)];
+        }
+
+        view operator [](const id_type id_) const
+        {
+            const entry& entry_ = _entries[id_];
+
+            return view(entry_._first, entry_._first + entry_._length);
+        }
+
+        std::size_t size() const
+        {
+            return _entries.size();
+        }
+
+        bool empty() const
+        {
+            return _entries.empty();
+        }
+
+        void clear()
+        {
+            _blocks.clear();
+            _entries.clear();
+            _table.clear();
+            _curr = _end = nullptr;
+        }
+
+    private:
+        struct entry
+        {
+            const char_type* _first = nullptr;
+            std::size_t _length = 0;
+            std::uint32_t _hash = 0;
+        };
+
+        std::size_t _block_size;
+        std::vector<std::unique_ptr<char_type[]>> _blocks;
+        char_type* _curr = nullptr;
+        char_type* _end = nullptr;
+        std::vector<entry> _entries;
+        // Power of 2 size, npos() marks an empty slot
+        std::vector<id_type> _table;
+
+        template<typename iter_type>
+        static std::uint32_t hash(iter_type first_, const iter_type& second_,
+            std::size_t& length_)
+        {
+            std::uint32_t hash_ = 2166136261u;
+
+            for (; first_ != second_; ++first_)
+            {
+                hash_ ^= static_cast<std::uint32_t>(*first_);
+                hash_ *= 16777619u;
+                ++length_;
+            }
+
+            return hash_;
+        }
+
+        // Returns the slot holding the string, or the empty slot
+        // where it would go.
+        template<typename iter_type>
+        std::size_t find_slot(const iter_type& first_,
+            const iter_type& second_, const std::size_t length_,
+            const std::uint32_t hash_) const
+        {
+            if (_table.empty())
+                return 0;
+
+            const std::size_t mask_ = _table.size() - 1;
+            std::size_t slot_ = hash_ & mask_;
+
+            for (;;)
+            {
+                const id_type id_ = _table[slot_];
+
+                if (id_ == npos())
+                    break;
+
+                const entry& entry_ = _entries[id_];
+
+                if (entry_._hash == hash_ && entry_._length == length_ &&
+                    std::equal(first_, second_, entry_._first))
+                {
+                    break;
+                }
+
+                slot_ = (slot_ + 1) & mask_;
+            }
+
+            return slot_;
+        }
+
+        template<typename iter_type>
+        const char_type* store(iter_type first_, const iter_type& second_,
+            const std::size_t length_)
+        {
+            if (static_cast<std::size_t>(_end - _curr) < length_)
+            {
+                const std::size_t size_ = std::max(length_, _block_size);
+
+                _blocks.emplace_back(new char_type[size_]);
+                _curr = _blocks.back().get();
+                _end = _curr + size_;
+            }
+
+            char_type* ptr_ = _curr;
+
+            for (; first_ != second_; ++first_)
+            {
+                *_curr++ = *first_;
+            }
+
+            return ptr_;
+        }
+
+        void rehash()
+        {
+            const std::size_t size_ = _table.empty() ? 64 : _table.size() * 2;
+            const std::size_t mask_ = size_ - 1;
+
+            _table.assign(size_, npos());
+
+            for (std::size_t idx_ = 0, entries_ = _entries.size();
+                idx_ < entries_; ++idx_)
+            {
+                std::size_t slot_ = _entries[idx_]._hash & mask_;
+
+                while (_table[slot_] != npos())
+                {
+                    slot_ = (slot_ + 1) & mask_;
+                }
+
+                _table[slot_] = static_cast<id_type>(idx_);
+            }
+        }
+    };
+
+    using intern_pool = basic_intern_pool<char>;
+    using wintern_pool = basic_intern_pool<wchar_t>;
+}
+
+#endif
@@ -0,0 +1,344 @@
+// lazy_captures.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_LAZY_CAPTURES_HPP
+#define PARSERTL_LAZY_CAPTURES_HPP
+
+#include <algorithm>
+#include "capture.hpp"
+#include "flat.hpp"
+#include "lookup.hpp"
+#include "match_results.hpp"
+#include "search.hpp"
+#include "token.hpp"
+#include <vector>
+
+namespace parsertl
+{
+    namespace details
+    {
+        // The start and end of each selected capture, in the order the
+        // productions were reduced. Also serves as the log passed to
+        // search_productions(), so a search only records the captures
+        // that were selected.
+        template<typename sm_type, typename iter_type>
+        class capture_log
+        {
+        public:
+            using id_type = typename sm_type::id_type;
+
+            struct entry
+            {
+                // Capture index, as for match()
+                std::size_t _index = 0;
+                iter_type _first = iter_type();
+                iter_type _second = iter_type();
+            };
+
+            void select(const sm_type& sm_,
+                const std::vector<std::size_t>& groups_)
+            {
+                _sm = &sm_;
+                _groups = groups_;
+                std::sort(_groups.begin(), _groups.end());
+                _wanted.assign(sm_._captures.size(), _groups.empty());
+
+                for (std::size_t rule_ = 0, size_ = sm_._captures.size();
+                    rule_ < size_; ++rule_)
+                {
+                    const auto& row_ = sm_._captures[rule_];
+                    auto iter_ = std::upper_bound(_groups.begin(),
+                        _groups.end(), row_.first);
+
+                    if (iter_ != _groups.end() &&
+                        *iter_ <= row_.first + row_.second.size())
+                    {
+                        _wanted[rule_] = true;
+                    }
+                }
+            }
+
+            void reset(const sm_type& sm_)
+            {
+                _entries.clear();
+
+                if (_sm != &sm_ || _wanted.size() != sm_._captures.size())
+                    select(sm_, _groups);
+            }
+
+            bool wanted(const std::size_t rule_) const
+            {
+                return rule_ < _wanted.size() && _wanted[rule_] &&
+                    !_sm->_captures[rule_].second.empty();
+            }
+
+            bool selected(const std::size_t index_) const
+            {
+                return _groups.empty() ||
+                    std::binary_search(_groups.begin(), _groups.end(),
+                    index_);
+            }
+
+            // [first_, second_) are the rhs tokens of rule_.
+            template<typename iterator>
+            void push(const id_type rule_, const iterator& first_,
+                const iterator&)
+            {
+                if (!wanted(rule_))
+                    return;
+
+                const auto& row_ = _sm->_captures[rule_];
+                std::size_t index_ = row_.first + 1;
+
+                for (const auto& pair_ : row_.second)
+                {
+                    if (selected(index_))
+                    {
+                        entry entry_;
+
+                        entry_._index = index_;
+                        entry_._first = first_[pair_.first].first;
+                        entry_._second = first_[pair_.second].second;
+                        _entries.push_back(entry_);
+                    }
+
+                    ++index_;
+                }
+            }
+
+            void clear()
+            {
+                _entries.clear();
+            }
+
+            std::size_t size() const
+            {
+                return _entries.size();
+            }
+
+            // Roll back to the first size_ entries.
+            void truncate(const std::size_t size_)
+            {
+                if (size_ < _entries.size())
+                    _entries.resize(size_);
+            }
+
+            const std::vector<entry>& entries() const
+            {
+                return _entries;
+            }
+
+        private:
+            const sm_type* _sm = nullptr;
+            std::vector<std::size_t> _groups;
+            // Indexed by rule id
+            std::vector<char> _wanted;
+            std::vector<entry> _entries;
+        };
+    }
+
+    // Captures for match() and search() that are only worked out when
+    // asked for. The parse just records the start and end of each
+    // capture, and operator[] gathers those for a capture index on
+    // first access.
+    // select() restricts recording to the capture indexes given, so that
+    // grammars with many captures only pay for the ones used.
+    template<typename lexer_iterator, typename sm_type>
+    class basic_lazy_captures
+    {
+    public:
+        using id_type = typename sm_type::id_type;
+        // Qualify token to prevent arg dependant lookup
+        using token = parsertl::token<lexer_iterator>;
+        using token_vector = typename token::token_vector;
+        using iter_type = typename token::iter_type;
+        using capture_type = capture<iter_type>;
+        using capture_vector = std::vector<capture_type>;
+        using log_type = details::capture_log<sm_type, iter_type>;
+
+        // Only record the capture indexes in groups_ (index 0, the whole
+        // match, is always available). Indexes not selected are empty.
+        // An empty groups_ selects everything (the default).
+        void select(const sm_type& sm_, const std::vector<std::size_t>& groups_)
+        {
+            _log.select(sm_, groups_);
+        }
+
+        // Called by match() and search() before parsing.
+        void reset(const sm_type& sm_)
+        {
+            _sm = &sm_;
+            _log.reset(sm_);
+            _built.clear();
+            _match = capture_type();
+        }
+
+        void clear()
+        {
+            _sm = nullptr;
+            _log.clear();
+            _built.clear();
+            _match = capture_type();
+        }
+
+        bool wanted(const std::size_t rule_) const
+        {
+            return _log.wanted(rule_);
+        }
+
+        template<typename iterator>
+        void push(const id_type rule_, const iterator& first_,
+            const iterator& second_)
+        {
+            _log.push(rule_, first_, second_);
+        }
+
+        // Sets index 0.
+        void span(const iter_type& first_, const iter_type& second_)
+        {
+            _match = capture_type(first_, second_);
+        }
+
+        // The raw record, as filled in by search().
+        log_type& log()
+        {
+            return _log;
+        }
+
+        // Number of capture indexes, as for match().
+        std::size_t size() const
+        {
+            return !_sm ? 0 : (_sm->_captures.empty() ? 0 :
+                _sm->_captures.back().first +
+                _sm->_captures.back().second.size()) + 1;
+        }
+
+        const capture_vector& operator [](const std::size_t index_)
+        {
+            if (_built.size() < size())
+            {
+                _built.resize(size(), false);
+                _cache.resize(size());
+            }
+
+            if (!_built[index_])
+            {
+                build(index_);
+                _built[index_] = true;
+            }
+
+            return _cache[index_];
+        }
+
+    private:
+        const sm_type* _sm = nullptr;
+        log_type _log;
+        capture_type _match;
+        // Capture indexes built so far
+        std::vector<char> _built;
+        std::vector<capture_vector> _cache;
+
+        void build(const std::size_t index_)
+        {
+            capture_vector& captures_ = _cache[index_];
+
+            captures_.clear();
+
+            if (index_ == 0)
+            {
+                captures_.push_back(_match);
+                return;
+            }
+
+            // Only selected indexes were recorded
+            for (const auto& entry_ : _log.entries())
+            {
+                if (entry_._index == index_)
+                    captures_.emplace_back(entry_._first, entry_._second);
+            }
+        }
+    };
+
+    template<typename lexer_iterator, typename sm_type, typename token_vector>
+    bool match(lexer_iterator iter_, const sm_type& sm_,
+        basic_lazy_captures<lexer_iterator, sm_type>& captures_,
+        token_vector& productions_)
+    {
+        basic_match_results<sm_type> results_(iter_->id, sm_);
+        const auto first_ = iter_->first;
+
+        productions_.clear();
+        captures_.reset(sm_);
+
+        while (results_.entry.action != action::error &&
+            results_.entry.action != action::accept)
+        {
+            if (results_.entry.action == action::reduce &&
+                captures_.wanted(results_.entry.param))
+            {
+                const std::size_t size_ =
+                    results_.production_size(sm_, results_.entry.param);
+
+                captures_.push(results_.entry.param,
+                    productions_.end() - size_, productions_.end());
+            }
+
+            lookup(iter_, sm_, results_, productions_);
+        }
+
+        captures_.span(first_, iter_->first);
+        return results_.entry.action == action::accept;
+    }
+
+    template<typename lexer_iterator, typename sm_type>
+    bool match(lexer_iterator iter_, const sm_type& sm_,
+        basic_lazy_captures<lexer_iterator, sm_type>& captures_)
+    {
+        typename basic_lazy_captures<lexer_iterator, sm_type>::token_vector
+            productions_;
+
+        return match(iter_, sm_, captures_, productions_);
+    }
+
+    // As for match(), only the selected captures are recorded.
+    template<typename lexer_iterator, typename sm_type>
+    bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
+        basic_lazy_captures<lexer_iterator, sm_type>& captures_)
+    {
+        using buffered_iterator = details::buffered_iterator<lexer_iterator>;
+        details::token_cache<lexer_iterator> cache_(iter_);
+        buffered_iterator start_(cache_, 0);
+        buffered_iterator match_end_;
+        details::search_state<sm_type,
+            typename basic_lazy_captures<lexer_iterator, sm_type>::
+            token_vector> state_;
+
+        captures_.reset(sm_);
+
+        const bool success_ = details::search_productions(cache_, start_,
+            match_end_, sm_, &captures_.log(), state_,
+            details::complete_input());
+
+        if (success_)
+        {
+            // The match ends with the last token before match_end_
+            const std::size_t index_ = match_end_.index();
+
+            captures_.span(start_->first, index_ == start_.index() ?
+                start_->first : cache_.get(index_ - 1)->second);
+            end_ = match_end_.base();
+        }
+        else
+        {
+            captures_.clear();
+            end_ = lexer_iterator();
+        }
+
+        iter_ = start_.base();
+        return success_;
+    }
+}
+
+#endif
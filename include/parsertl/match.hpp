@@ -11,6 +11,27 @@
 
 namespace parsertl
 {
+    namespace details
+    {
+        // Containers storing offsets (e.g. compact_token_vector) are
+        // rebased on the start of each new input.
+        template<typename token_vector, typename iter_type>
+        auto reset_productions(token_vector& productions_,
+            const iter_type& base_, int) ->
+            decltype(productions_.base(base_), void())
+        {
+            productions_.clear();
+            productions_.base(base_);
+        }
+
+        template<typename token_vector, typename iter_type>
+        void reset_productions(token_vector& productions_,
+            const iter_type&, long)
+        {
+            productions_.clear();
+        }
+    }
+
     // Parse entire sequence and return boolean
     template<typename lexer_iterator, typename sm_type>
     bool match(lexer_iterator iter_, const sm_type& sm_)
@@ -20,14 +41,17 @@ namespace parsertl
         return parse(iter_, sm_, results_);
     }
 
-    template<typename lexer_iterator, typename sm_type, typename captures>
-    bool match(lexer_iterator iter_, const sm_type& sm_, captures& captures_)
+    // productions_ can be any container usable with lookup(),
+    // e.g. compact_token_vector to reduce memory use on deep parses.
+    // A compact_token_vector is rebased on the start of the input.
+    template<typename lexer_iterator, typename sm_type, typename captures,
+        typename token_vector>
+    bool match(lexer_iterator iter_, const sm_type& sm_, captures& captures_,
+        token_vector& productions_)
     {
         basic_match_results<sm_type> results_(iter_->id, sm_);
-        // Qualify token to prevent arg dependant lookup
-        using token = parsertl::token<lexer_iterator>;
-        typename token::token_vector productions_;
 
+        details::reset_productions(productions_, iter_->first, 0);
         captures_.clear();
         captures_.resize(sm_._captures.back().first +
             sm_._captures.back().second.size() + 1);
@@ -64,6 +88,16 @@ namespace parsertl
         captures_[0].back().second = iter_->first;
         return results_.entry.action == action::accept;
     }
+
+    template<typename lexer_iterator, typename sm_type, typename captures>
+    bool match(lexer_iterator iter_, const sm_type& sm_, captures& captures_)
+    {
+        // Qualify token to prevent arg dependant lookup
+        using token = parsertl::token<lexer_iterator>;
+        typename token::token_vector productions_;
+
+        return match(iter_, sm_, captures_, productions_);
+    }
 }
 
 #endif
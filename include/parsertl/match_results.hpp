@@ -80,8 +80,10 @@ namespace parsertl
             return entry.param;
         }
 
+        // decltype(auto) so that containers returning tokens by value
+        // (e.g. compact_token_vector) are supported.
         template<typename token_vector>
-        typename token_vector::value_type& dollar(const std::size_t index_,
+        decltype(auto) dollar(const std::size_t index_,
             const sm_type& sm_, token_vector& productions)
         {
             if (entry.action != action::reduce)
@@ -94,9 +96,8 @@ namespace parsertl
         }
 
         template<typename token_vector>
-        const typename token_vector::value_type&
-            dollar(const std::size_t index_, const sm_type& sm_,
-                const token_vector& productions) const
+        decltype(auto) dollar(const std::size_t index_, const sm_type& sm_,
+            const token_vector& productions) const
         {
             if (entry.action != action::reduce)
             {
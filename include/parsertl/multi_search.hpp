@@ -0,0 +1,225 @@
+// multi_search.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_MULTI_SEARCH_HPP
+#define PARSERTL_MULTI_SEARCH_HPP
+
+#include "match_results.hpp"
+#include "rules.hpp"
+#include "runtime_error.hpp"
+#include "search.hpp"
+#include <string>
+#include <vector>
+
+namespace parsertl
+{
+    // Several patterns compiled into one grammar, so that one search
+    // finds whichever matches first and reports which one it was.
+    // Each pattern becomes an alternative of a common start rule:
+    //
+    // parsertl::rules rules_;
+    // parsertl::search_patterns patterns_;
+    //
+    // rules_.push("assign", "NAME '=' INTEGER");
+    // rules_.push("call", "NAME '(' ')'");
+    // patterns_.push(rules_, "patterns", "assign"); // 0
+    // patterns_.push(rules_, "patterns", "call"); // 1
+    // parsertl::generator::build(rules_, sm_);
+    //
+    // As with any grammar, conflicts between patterns must be resolved
+    // (e.g. with precedence) before the state machine can be built.
+    template<typename id_type>
+    class basic_search_patterns
+    {
+    public:
+        static std::size_t npos()
+        {
+            return static_cast<std::size_t>(~0);
+        }
+
+        // Adds start_ : pattern_ and makes start_ the start rule.
+        // Returns the index of the new pattern. If pattern_ contains
+        // alternatives they all map to the same index.
+        template<typename char_type>
+        std::size_t push(basic_rules<char_type, id_type>& rules_,
+            const std::basic_string<char_type>& start_,
+            const std::basic_string<char_type>& pattern_)
+        {
+            const std::size_t first_ = rules_.push(start_, pattern_);
+            const auto& grammar_ = rules_.grammar();
+            const std::size_t lhs_ = grammar_[first_]._lhs;
+
+            rules_.start(start_);
+
+            if (_patterns.size() < grammar_.size())
+            {
+                _patterns.resize(grammar_.size(), npos());
+                _rhs_sizes.resize(grammar_.size(), 0);
+            }
+
+            for (std::size_t rule_ = first_, size_ = grammar_.size();
+                rule_ < size_; ++rule_)
+            {
+                // Skip any rules generated from EBNF
+                if (grammar_[rule_]._lhs == lhs_)
+                {
+                    _patterns[rule_] = _size;
+                    _rhs_sizes[rule_] = grammar_[rule_]._rhs._symbols.size();
+                }
+            }
+
+            return _size++;
+        }
+
+        template<typename char_type>
+        std::size_t push(basic_rules<char_type, id_type>& rules_,
+            const char_type* start_, const char_type* pattern_)
+        {
+            return push(rules_, std::basic_string<char_type>(start_),
+                std::basic_string<char_type>(pattern_));
+        }
+
+        // Pattern index for a rule id, or npos().
+        std::size_t pattern(const std::size_t rule_) const
+        {
+            return rule_ < _patterns.size() ? _patterns[rule_] : npos();
+        }
+
+        std::size_t size() const
+        {
+            return _size;
+        }
+
+        void clear()
+        {
+            _patterns.clear();
+            _rhs_sizes.clear();
+            _size = 0;
+        }
+
+        // pattern() relies on the reduce ids of sm_ being the indexes of
+        // the productions in rules_.grammar(). Throws if sm_ does not
+        // have the pattern productions at those ids (e.g. it was built
+        // from different rules).
+        template<typename sm_type>
+        void validate(const sm_type& sm_) const
+        {
+            std::size_t lhs_ = npos();
+
+            for (std::size_t rule_ = 0, size_ = _patterns.size();
+                rule_ < size_; ++rule_)
+            {
+                if (_patterns[rule_] == npos())
+                    continue;
+
+                // Every pattern is an alternative of the start rule
+                if (rule_ >= sm_._rules.size() ||
+                    sm_._rules[rule_]._rhs.size() != _rhs_sizes[rule_] ||
+                    (lhs_ != npos() && sm_._rules[rule_]._lhs != lhs_))
+                {
+                    throw runtime_error("State machine does not match the "
+                        "rules of basic_search_patterns.");
+                }
+
+                lhs_ = sm_._rules[rule_]._lhs;
+            }
+        }
+
+    private:
+        // Indexed by rule id
+        std::vector<std::size_t> _patterns;
+        std::vector<std::size_t> _rhs_sizes;
+        std::size_t _size = 0;
+    };
+
+    using search_patterns = basic_search_patterns<uint16_t>;
+
+    namespace details
+    {
+        // Stands in for the production set used by search(), keeping
+        // only the pattern of the final reduction.
+        template<typename id_type>
+        struct pattern_recorder
+        {
+            const basic_search_patterns<id_type>* _patterns = nullptr;
+            std::size_t _pattern = basic_search_patterns<id_type>::npos();
+
+            explicit pattern_recorder
+                (const basic_search_patterns<id_type>& patterns_) :
+                _patterns(&patterns_)
+            {
+            }
+
+            void clear()
+            {
+                _pattern = basic_search_patterns<id_type>::npos();
+            }
+
+            void insert(const id_type rule_)
+            {
+                const std::size_t pattern_ = _patterns->pattern(rule_);
+
+                if (pattern_ != basic_search_patterns<id_type>::npos())
+                    _pattern = pattern_;
+            }
+        };
+    }
+
+    // Equivalent of search(), additionally setting pattern_ to the index
+    // of the pattern that matched.
+    template<typename lexer_iterator, typename sm_type>
+    bool multi_search(lexer_iterator& iter_, lexer_iterator& end_,
+        const sm_type& sm_,
+        const basic_search_patterns<typename sm_type::id_type>& patterns_,
+        std::size_t& pattern_)
+    {
+        details::pattern_recorder<typename sm_type::id_type>
+            recorder_(patterns_);
+
+        patterns_.validate(sm_);
+
+        const bool hit_ = details::search_set(iter_, end_, sm_, &recorder_);
+
+        pattern_ = hit_ ? recorder_._pattern : patterns_.npos();
+        return hit_;
+    }
+
+    // Counts the matches of each pattern in one pass, visiting the
+    // same (non-overlapping) matches as a search_iterator would.
+    // counts_ is resized to the number of patterns.
+    template<typename lexer_iterator, typename sm_type>
+    std::size_t multi_search_count(const lexer_iterator& iter_,
+        const sm_type& sm_,
+        const basic_search_patterns<typename sm_type::id_type>& patterns_,
+        std::vector<std::size_t>& counts_)
+    {
+        using buffered_iterator = details::buffered_iterator<lexer_iterator>;
+        details::token_cache<lexer_iterator> cache_(iter_);
+        buffered_iterator start_(cache_, 0);
+        buffered_iterator end_;
+        basic_match_results<sm_type> results_;
+        details::stack_snapshot<sm_type> snapshot_;
+        details::pattern_recorder<typename sm_type::id_type>
+            recorder_(patterns_);
+        std::size_t count_ = 0;
+
+        patterns_.validate(sm_);
+        counts_.assign(patterns_.size(), 0);
+
+        while (details::search_set(cache_, start_, end_, sm_, &recorder_,
+            results_, snapshot_))
+        {
+            if (recorder_._pattern != patterns_.npos())
+                ++counts_[recorder_._pattern];
+
+            ++count_;
+            start_ = end_;
+        }
+
+        return count_;
+    }
+}
+
+#endif
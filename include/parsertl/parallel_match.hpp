@@ -0,0 +1,194 @@
+// parallel_match.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_PARALLEL_MATCH_HPP
+#define PARSERTL_PARALLEL_MATCH_HPP
+
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include "match_results.hpp"
+#include "parse.hpp"
+#include <thread>
+#include "token.hpp"
+#include <vector>
+
+namespace parsertl
+{
+    namespace details
+    {
+        inline std::size_t thread_count(const std::size_t threads_,
+            const std::size_t inputs_)
+        {
+            std::size_t count_ = threads_;
+
+            if (count_ == 0)
+                count_ = std::thread::hardware_concurrency();
+
+            if (count_ == 0)
+                count_ = 1;
+
+            return count_ > inputs_ ? inputs_ : count_;
+        }
+
+        // Calls func_(state_, index_) for every index_ in [0, size_) using
+        // a pool of at most threads_ threads (see thread_count()).
+        // Indexes are claimed through a single shared atomic counter rather
+        // than per-thread work-stealing queues: each index is one
+        // indivisible task, so there is nothing to split or steal once it
+        // has been claimed. Each thread owns one state_type that it passes
+        // to every task it runs, so that buffers can be reused.
+        // The first exception thrown stops the pool and is rethrown to the
+        // caller.
+        template<typename state_type, typename functor>
+        void parallel_for(const std::size_t size_, const std::size_t threads_,
+            functor func_)
+        {
+            const std::size_t count_ = thread_count(threads_, size_);
+            std::atomic<std::size_t> next_(0);
+            std::atomic<bool> stop_(false);
+            std::exception_ptr exception_;
+            std::atomic<bool> failed_(false);
+            std::vector<std::thread> pool_;
+
+            auto worker_ = [&]()
+            {
+                try
+                {
+                    state_type state_;
+
+                    while (!stop_)
+                    {
+                        const std::size_t index_ = next_++;
+
+                        if (index_ >= size_)
+                            break;
+
+                        func_(state_, index_);
+                    }
+                }
+                catch (...)
+                {
+                    // Only the first failure is reported
+                    if (!failed_.exchange(true))
+                        exception_ = std::current_exception();
+
+                    stop_ = true;
+                }
+            };
+
+            if (count_ < 2)
+            {
+                worker_();
+            }
+            else
+            {
+                pool_.reserve(count_);
+
+                try
+                {
+                    for (std::size_t idx_ = 0; idx_ < count_; ++idx_)
+                    {
+                        pool_.emplace_back(worker_);
+                    }
+                }
+                catch (...)
+                {
+                    // Joinable threads must not be destroyed
+                    stop_ = true;
+
+                    for (auto& thread_ : pool_)
+                    {
+                        thread_.join();
+                    }
+
+                    throw;
+                }
+
+                for (auto& thread_ : pool_)
+                {
+                    thread_.join();
+                }
+            }
+
+            if (exception_)
+                std::rethrow_exception(exception_);
+        }
+    }
+
+    // Parse every input in [first_, last_) using a pool of threads.
+    // Both state machines are shared read only. Each thread owns one
+    // basic_match_results and one production vector which are reset
+    // (not reallocated) for every input it picks up.
+    // func_ is called as:
+    // func_(index_, lexer_iter_, results_, productions_)
+    // where index_ is the position of the input in [first_, last_).
+    // input_iterator must be at least a forward iterator.
+    // Threads take the next unclaimed input as soon as they are free
+    // (see details::parallel_for()), so one long document does not hold
+    // up the rest of the batch.
+    // The first exception thrown by func_ stops the pool and is rethrown
+    // to the caller.
+    template<typename lexer_iterator, typename input_iterator,
+        typename lsm_type, typename sm_type, typename functor>
+    void parallel_parse(input_iterator first_, input_iterator last_,
+        const lsm_type& lsm_, const sm_type& sm_, functor func_,
+        const std::size_t threads_ = 0)
+    {
+        // Qualify token to prevent arg dependant lookup
+        using token = parsertl::token<lexer_iterator>;
+        using token_vector = typename token::token_vector;
+
+        struct state
+        {
+            basic_match_results<sm_type> _results;
+            token_vector _productions;
+        };
+
+        // Collected up front so that workers can reach any input in
+        // constant time whatever the iterator category.
+        std::vector<input_iterator> inputs_;
+
+        for (; first_ != last_; ++first_)
+        {
+            inputs_.push_back(first_);
+        }
+
+        details::parallel_for<state>(inputs_.size(), threads_,
+            [&](state& state_, const std::size_t index_)
+            {
+                const auto& input_ = *inputs_[index_];
+                lexer_iterator iter_(std::begin(input_), std::end(input_),
+                    lsm_);
+
+                state_._results.reset(iter_->id, sm_);
+                state_._productions.clear();
+                func_(index_, iter_, state_._results, state_._productions);
+            });
+    }
+
+    // Equivalent of calling match() on every input.
+    // matches_[i] is non-zero if input i was accepted.
+    template<typename lexer_iterator, typename input_iterator,
+        typename lsm_type, typename sm_type>
+    void parallel_match(input_iterator first_, input_iterator last_,
+        const lsm_type& lsm_, const sm_type& sm_, std::vector<char>& matches_,
+        const std::size_t threads_ = 0)
+    {
+        // One char per input so that threads never share an element
+        // (unlike std::vector<bool>).
+        matches_.assign(static_cast<std::size_t>
+            (std::distance(first_, last_)), 0);
+        parallel_parse<lexer_iterator>(first_, last_, lsm_, sm_,
+            [&matches_, &sm_](const std::size_t index_,
+                lexer_iterator& iter_, basic_match_results<sm_type>& results_,
+                typename token<lexer_iterator>::token_vector&)
+            {
+                matches_[index_] = parse(iter_, sm_, results_);
+            }, threads_);
+    }
+}
+
+#endif
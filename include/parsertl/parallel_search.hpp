@@ -0,0 +1,252 @@
+// parallel_search.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_PARALLEL_SEARCH_HPP
+#define PARSERTL_PARALLEL_SEARCH_HPP
+
+#include <algorithm>
+#include "capture.hpp"
+#include <iterator>
+#include "parallel_match.hpp"
+#include "search.hpp"
+#include <vector>
+
+namespace parsertl
+{
+    namespace details
+    {
+        template<typename iter_type>
+        struct search_hit
+        {
+            using results = std::vector<std::vector<capture<iter_type>>>;
+
+            // Start of the match and start of the token following it
+            // (where search_iterator resumes).
+            iter_type _first;
+            iter_type _next;
+            results _captures;
+        };
+
+        template<typename iter_type>
+        struct search_chunk
+        {
+            std::vector<search_hit<iter_type>> _hits;
+            // Every position before this has been searched (up to the
+            // end of the chunk). Beyond it the outcome depended on input
+            // past the overlap.
+            iter_type _searched;
+        };
+
+        // Returns the position following the next delimiter_ at or
+        // after first_, or last_ if there is none.
+        template<typename iter_type, typename char_type>
+        iter_type after_delimiter(iter_type first_, const iter_type& last_,
+            const char_type delimiter_)
+        {
+            first_ = std::find(first_, last_, delimiter_);
+            return first_ == last_ ? last_ : ++first_;
+        }
+    }
+
+    // Produces the same matches as iterating a search_iterator over
+    // [first_, last_), but searches chunks of the input concurrently
+    // (see details::parallel_for()).
+    // Chunks begin immediately after a delimiter_ character (e.g. '\n'),
+    // which must always end a token.
+    // Each chunk is lexed up to overlap_ characters (rounded up to the
+    // next delimiter) beyond its end, so that matches starting in the
+    // chunk can be completed. The chunk's search stops at the first
+    // position where the parser reaches the end of the overlap, and the
+    // rest of the chunk is searched sequentially when stitching, so
+    // overlap_ only affects speed. Zero lexes to the end of the input.
+    // Chunks are then stitched together in document order. Where a match
+    // runs into the next chunk that chunk's matches are only used once
+    // they are in step with the sequential search again. Until then the
+    // search is re-run from the end of the previous match.
+    // matches_ receives the captures for each match, as returned by
+    // search_iterator.
+    template<typename lexer_iterator, typename iter_type, typename lsm_type,
+        typename sm_type, typename char_type>
+    void parallel_search(const iter_type& first_, const iter_type& last_,
+        const lsm_type& lsm_, const sm_type& sm_, const char_type delimiter_,
+        const std::size_t overlap_,
+        std::vector<std::vector<std::vector<capture<iter_type>>>>& matches_,
+        const std::size_t threads_ = 0)
+    {
+        using hit = details::search_hit<iter_type>;
+        using chunk = details::search_chunk<iter_type>;
+        using buffered_iterator = details::buffered_iterator<lexer_iterator>;
+        // Qualify token to prevent arg dependant lookup
+        using token_vector =
+            typename parsertl::token<lexer_iterator>::token_vector;
+        using search_state = details::search_state<sm_type, token_vector>;
+        using productions =
+            basic_flat_productions<typename sm_type::id_type, token_vector>;
+
+        struct state
+        {
+            search_state _search;
+            productions _productions;
+        };
+
+        const auto size_ =
+            static_cast<std::size_t>(std::distance(first_, last_));
+        // Several chunks per thread so that threads finishing early
+        // can pick up more work.
+        const std::size_t threads_count_ = details::thread_count(threads_,
+            size_ ? size_ : 1);
+        const std::size_t chunk_size_ = std::max<std::size_t>(size_ /
+            (threads_count_ * 4), 1);
+        std::vector<iter_type> bounds_;
+        std::vector<chunk> chunks_;
+
+        matches_.clear();
+        bounds_.push_back(first_);
+
+        for (std::size_t offset_ = chunk_size_; offset_ < size_;
+            offset_ += chunk_size_)
+        {
+            const iter_type bound_ = details::after_delimiter
+                (std::next(first_, offset_), last_, delimiter_);
+
+            if (bound_ == last_)
+                break;
+
+            if (bound_ > bounds_.back())
+                bounds_.push_back(bound_);
+        }
+
+        bounds_.push_back(last_);
+        chunks_.resize(bounds_.size() - 1);
+
+        details::parallel_for<state>(chunks_.size(), threads_,
+            [&](state& thread_state_, const std::size_t index_)
+            {
+                const iter_type& end_ = bounds_[index_ + 1];
+                iter_type limit_ = last_;
+
+                if (overlap_ && static_cast<std::size_t>
+                    (std::distance(end_, last_)) > overlap_)
+                {
+                    limit_ = details::after_delimiter(std::next(end_,
+                        overlap_), last_, delimiter_);
+                }
+
+                details::token_cache<lexer_iterator> cache_
+                    (lexer_iterator(bounds_[index_], limit_, lsm_));
+                buffered_iterator start_(cache_, 0);
+                buffered_iterator match_end_;
+                search_state& state_ = thread_state_._search;
+                productions& productions_ = thread_state_._productions;
+                // End of input is only real at last_. A delimiter
+                // ends the token before limit_.
+                auto pending_ = [&limit_, &last_]
+                    (const lexer_iterator& token_)
+                {
+                    return token_->id == 0 && limit_ != last_;
+                };
+                auto& chunk_ = chunks_[index_];
+                hit hit_;
+
+                // Left over from the thread's previous chunk
+                state_._pending = false;
+                chunk_._searched = end_;
+
+                while (details::search_productions(cache_, start_,
+                    match_end_, sm_, &productions_, state_, pending_))
+                {
+                    // Belongs to a later chunk
+                    if (!(start_->first < end_))
+                        break;
+
+                    hit_._first = start_->first;
+                    hit_._next = match_end_->first;
+                    details::assign_captures(sm_, productions_,
+                        hit_._first, hit_._captures);
+                    chunk_._hits.push_back(std::move(hit_));
+                    hit_._captures.clear();
+                    start_ = match_end_;
+                }
+
+                if (state_._pending && start_->first < end_)
+                    chunk_._searched = start_->first;
+            });
+
+        // Stitch in document order.
+        // pos_ is where the sequential search would resume.
+        iter_type pos_ = first_;
+        search_state state_;
+        productions productions_;
+
+        for (std::size_t index_ = 0; index_ < chunks_.size(); ++index_)
+        {
+            auto& chunk_hits_ = chunks_[index_]._hits;
+            const iter_type& end_ = bounds_[index_ + 1];
+
+            while (pos_ < end_)
+            {
+                auto iter_ = std::find_if(chunk_hits_.begin(),
+                    chunk_hits_.end(), [&pos_](const hit& hit_)
+                    {
+                        return !(hit_._first < pos_);
+                    });
+                const iter_type& prev_ = iter_ == chunk_hits_.begin() ?
+                    bounds_[index_] : (iter_ - 1)->_next;
+
+                // The chunk searched every position from prev_ onwards
+                // up to _searched.
+                if (!(pos_ < prev_))
+                {
+                    for (; iter_ != chunk_hits_.end(); ++iter_)
+                    {
+                        matches_.push_back(std::move(iter_->_captures));
+                        pos_ = iter_->_next;
+                    }
+
+                    if (pos_ < chunks_[index_]._searched)
+                        pos_ = chunks_[index_]._searched;
+
+                    if (!(pos_ < end_))
+                        break;
+                }
+
+                // Either a match from the previous chunk ended inside this
+                // one at a position the chunk did not search from, or the
+                // chunk's search ran past the overlap. Only the starts
+                // before the chunk's results resume (or before the next
+                // chunk) are searched here.
+                const iter_type bound_ = pos_ < prev_ ? prev_ : end_;
+                details::token_cache<lexer_iterator> cache_
+                    (lexer_iterator(pos_, last_, lsm_));
+                buffered_iterator start_(cache_, 0);
+                buffered_iterator match_end_;
+                auto past_bound_ = [&bound_](const lexer_iterator& token_)
+                {
+                    return !(token_->first < bound_);
+                };
+
+                if (details::search_productions(cache_, start_, match_end_,
+                    sm_, &productions_, state_, details::complete_input(),
+                    past_bound_))
+                {
+                    matches_.emplace_back();
+                    details::assign_captures(sm_, productions_,
+                        start_->first, matches_.back());
+                    pos_ = match_end_->first;
+                }
+                else if (start_.base() == lexer_iterator())
+                {
+                    return;
+                }
+                else
+                {
+                    pos_ = bound_;
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,277 @@
+// pipeline.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_PIPELINE_HPP
+#define PARSERTL_PIPELINE_HPP
+
+#include <atomic>
+#include "compact_token.hpp"
+#include <exception>
+#include <iterator>
+#include "runtime_error.hpp"
+#include <thread>
+#include <vector>
+
+namespace parsertl
+{
+    // Token as seen through pipeline::iterator, with the same members
+    // as the lexer_iterator results that the parser functions use.
+    template<typename lexer_iterator>
+    struct pipeline_results
+    {
+        using id_type = typename lexer_iterator::value_type::index_type;
+        using iter_type = typename lexer_iterator::value_type::iter_type;
+        using char_type = typename lexer_iterator::value_type::char_type;
+
+        id_type id = 0;
+        iter_type first = iter_type();
+        iter_type second = iter_type();
+
+        static id_type npos()
+        {
+            return lexer_iterator::value_type::npos();
+        }
+    };
+
+    // Lexes on a separate thread, so that lexing and parsing overlap
+    // on a multi core machine. The lexer thread writes compact_tokens
+    // into a fixed size single producer/single consumer ring and the
+    // parser reads them through iterator, which can be passed to
+    // parse(), match() etc. in place of lexer_iterator:
+    //
+    // parsertl::pipeline<lexertl::citerator> pipeline_(first_, last_, lsm_);
+    //
+    // parsertl::match(pipeline_.begin(), sm_);
+    //
+    // Tokens are consumed as they are read, so begin() can only be
+    // called once and only one copy of an iterator may be advanced
+    // (which rules out search()). The input must not exceed 4GB (see
+    // compact_token). Exceptions thrown by the lexer are rethrown
+    // by iterator once the tokens before them have been read.
+    template<typename lexer_iterator>
+    class pipeline
+    {
+    public:
+        using value_type = pipeline_results<lexer_iterator>;
+        using iter_type = typename value_type::iter_type;
+
+        class iterator
+        {
+        public:
+            using value_type = pipeline_results<lexer_iterator>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type*;
+            using reference = const value_type&;
+            using iterator_category = std::input_iterator_tag;
+
+            iterator() = default;
+
+            explicit iterator(pipeline& pipeline_) :
+                _pipeline(&pipeline_)
+            {
+                _pipeline->pop(_results);
+            }
+
+            const value_type& operator *() const
+            {
+                return _results;
+            }
+
+            const value_type* operator ->() const
+            {
+                return &_results;
+            }
+
+            // End of input is sticky, as with lexer_iterator
+            iterator& operator ++()
+            {
+                if (_results.id != 0)
+                {
+                    _pipeline->pop(_results);
+                    ++_index;
+                }
+
+                return *this;
+            }
+
+            iterator operator ++(int)
+            {
+                iterator iter_ = *this;
+
+                ++*this;
+                return iter_;
+            }
+
+            // Any two iterators at end of input compare equal,
+            // including a default constructed one.
+            bool operator ==(const iterator& rhs_) const
+            {
+                return (_results.id == 0 && rhs_._results.id == 0) ||
+                    (_pipeline == rhs_._pipeline && _index == rhs_._index);
+            }
+
+            bool operator !=(const iterator& rhs_) const
+            {
+                return !(*this == rhs_);
+            }
+
+        private:
+            pipeline* _pipeline = nullptr;
+            std::size_t _index = 0;
+            value_type _results;
+        };
+
+        // capacity_ (tokens) is rounded up to a power of 2.
+        // lsm_ is used by the lexer thread, so it must outlive the
+        // pipeline, as must the input.
+        template<typename lsm_type>
+        pipeline(const iter_type& first_, const iter_type& last_,
+            const lsm_type& lsm_, const std::size_t capacity_ = 4096) :
+            _base(first_)
+        {
+            std::size_t size_ = 2;
+
+            while (size_ < capacity_)
+            {
+                size_ <<= 1;
+            }
+
+            _ring.resize(size_);
+            _mask = size_ - 1;
+            _thread = std::thread([this, first_, last_, &lsm_]()
+                {
+                    produce(first_, last_, lsm_);
+                });
+        }
+
+        pipeline(const pipeline&) = delete;
+        pipeline& operator =(const pipeline&) = delete;
+
+        ~pipeline()
+        {
+            _stop.store(true, std::memory_order_relaxed);
+            _thread.join();
+        }
+
+        iterator begin()
+        {
+            return iterator(*this);
+        }
+
+        iterator end() const
+        {
+            return iterator();
+        }
+
+    private:
+        using compact = compact_token<lexer_iterator>;
+
+        const iter_type _base;
+        std::vector<compact> _ring;
+        std::size_t _mask = 0;
+        // Written by the consumer only. Kept on separate cache lines
+        // so that each side only invalidates the other's cached index
+        // when it publishes.
+        alignas(64) std::atomic<std::size_t> _head{ 0 };
+        std::size_t _read = 0;
+        std::size_t _tail_cache = 0;
+        // Written by the producer only
+        alignas(64) std::atomic<std::size_t> _tail{ 0 };
+        std::atomic<bool> _done{ false };
+        std::exception_ptr _exception;
+        alignas(64) std::atomic<bool> _stop{ false };
+        std::thread _thread;
+
+        // Lexing the first token happens inside the try block too, so
+        // that any exception reaches the consumer.
+        template<typename lsm_type>
+        void produce(const iter_type& first_, const iter_type& last_,
+            const lsm_type& lsm_)
+        {
+            std::size_t tail_ = 0;
+            std::size_t head_cache_ = 0;
+
+            try
+            {
+                lexer_iterator iter_(first_, last_, lsm_);
+
+                for (;;)
+                {
+                    while (tail_ - head_cache_ == _ring.size())
+                    {
+                        // Full, unless the consumer has moved on since
+                        // we last looked.
+                        head_cache_ = _head.load(std::memory_order_acquire);
+
+                        if (tail_ - head_cache_ != _ring.size())
+                            break;
+
+                        if (_stop.load(std::memory_order_relaxed))
+                            return;
+
+                        std::this_thread::yield();
+                    }
+
+                    _ring[tail_ & _mask] =
+                        compact(iter_->id, _base, iter_->first, iter_->second);
+                    _tail.store(++tail_, std::memory_order_release);
+
+                    if (iter_->id == 0 ||
+                        _stop.load(std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+
+                    ++iter_;
+                }
+            }
+            catch (...)
+            {
+                _exception = std::current_exception();
+            }
+
+            _done.store(true, std::memory_order_release);
+        }
+
+        void pop(value_type& results_)
+        {
+            while (_read == _tail_cache)
+            {
+                _tail_cache = _tail.load(std::memory_order_acquire);
+
+                if (_read != _tail_cache)
+                    break;
+
+                if (_done.load(std::memory_order_acquire))
+                {
+                    // Check for a token published just before _done
+                    _tail_cache = _tail.load(std::memory_order_acquire);
+
+                    if (_read != _tail_cache)
+                        break;
+
+                    if (_exception)
+                        std::rethrow_exception(_exception);
+
+                    throw runtime_error("parsertl::pipeline read past end "
+                        "of input.");
+                }
+
+                std::this_thread::yield();
+            }
+
+            const compact& token_ = _ring[_read & _mask];
+
+            results_.id = token_.id == static_cast<uint32_t>(~0) ?
+                value_type::npos() :
+                static_cast<typename value_type::id_type>(token_.id);
+            results_.first = _base + token_.first;
+            results_.second = results_.first + token_.length;
+            _head.store(++_read, std::memory_order_release);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,210 @@
+// push_parser.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_PUSH_PARSER_HPP
+#define PARSERTL_PUSH_PARSER_HPP
+
+#include "enums.hpp"
+#include "runtime_error.hpp"
+#include "state_machine.hpp"
+#include <vector>
+
+namespace parsertl
+{
+    // Parser driven by the caller handing over one token at a time,
+    // for when tokens arrive asynchronously (e.g. network packets) and
+    // cannot be pulled through a lexer iterator.
+    // The first max_depth stack entries live inside the object, so no heap
+    // memory is used unless the parse goes deeper than that (e.g. a long
+    // right recursive list), in which case the rest of the stack
+    // continues in a vector. Each entry is a state and two iter_types
+    // (24 bytes for push_parser on a 64 bit platform), so the default
+    // keeps push_parser under 512 bytes for servers holding one per
+    // connection. iter_type can be anything copyable (e.g. an offset) as
+    // it is only stored and handed back.
+    template<typename sm_type, typename iter_type = const char*,
+        std::size_t max_depth = 16>
+    class basic_push_parser
+    {
+    public:
+        using id_type = typename sm_type::id_type;
+        using entry = typename sm_type::entry;
+
+        basic_push_parser()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            _size = 1;
+            _stack[0]._state = 0;
+            _overflow.clear();
+            _entry.action = action::shift;
+            _entry.param = 0;
+        }
+
+        // Feed the next token (id 0 is end of input).
+        // Performs every reduction the token allows, calling
+        // reduce_(rule_id_, first_, second_) for each, then shifts it.
+        // Returns action::shift when the next token is required,
+        // action::accept once the input has been accepted,
+        // otherwise action::error.
+        template<typename reduce_handler>
+        action push(const std::size_t token_id_, const iter_type& first_,
+            const iter_type& second_, const sm_type& sm_,
+            reduce_handler&& reduce_)
+        {
+            if (_entry.action != action::shift)
+                return _entry.action;
+
+            if (token_id_ >= sm_._columns)
+            {
+                _entry.action = action::error;
+                _entry.param = static_cast<id_type>(error_type::unknown_token);
+                return _entry.action;
+            }
+
+            for (;;)
+            {
+                _entry = sm_.at(at(_size - 1)._state, token_id_);
+
+                switch (_entry.action)
+                {
+                case action::shift:
+                    push_frame(_entry.param, first_, second_);
+
+                    // End of input is shifted and then remains the
+                    // lookahead (see lookup())
+                    if (token_id_ != 0)
+                        return _entry.action;
+
+                    break;
+                case action::reduce:
+                {
+                    const auto& rule_ = sm_._rules[_entry.param];
+                    const std::size_t size_ = rule_._rhs.size();
+                    iter_type start_ = size_ ?
+                        at(_size - size_)._first :
+                        (_size > 1 ? at(_size - 1)._second : first_);
+                    iter_type end_ = size_ ?
+                        at(_size - 1)._second :
+                        start_;
+
+                    reduce_(static_cast<std::size_t>(_entry.param),
+                        start_, end_);
+                    pop(size_);
+
+                    const entry goto_ = sm_.at(at(_size - 1)._state,
+                        rule_._lhs);
+
+                    if (goto_.action != action::go_to)
+                    {
+                        _entry.action = action::error;
+                        _entry.param =
+                            static_cast<id_type>(error_type::syntax_error);
+                        return _entry.action;
+                    }
+
+                    push_frame(goto_.param, start_, end_);
+                    break;
+                }
+                case action::accept:
+                    pop(sm_._rules[_entry.param]._rhs.size());
+                    return _entry.action;
+                case action::error:
+                    // param is the error_type
+                    return _entry.action;
+                default:
+                    // action::go_to (not possible on a terminal)
+                    _entry.action = action::error;
+                    _entry.param =
+                        static_cast<id_type>(error_type::syntax_error);
+                    return _entry.action;
+                }
+            }
+        }
+
+        action push(const std::size_t token_id_, const iter_type& first_,
+            const iter_type& second_, const sm_type& sm_)
+        {
+            return push(token_id_, first_, second_, sm_,
+                [](const std::size_t, const iter_type&, const iter_type&)
+                {
+                });
+        }
+
+        // action::shift while more input is expected.
+        action state() const
+        {
+            return _entry.action;
+        }
+
+        // Only meaningful once state() is action::error.
+        error_type error() const
+        {
+            if (_entry.action != action::error)
+                throw runtime_error("basic_push_parser::error() called "
+                    "without an error.");
+
+            return static_cast<error_type>(_entry.param);
+        }
+
+        std::size_t depth() const
+        {
+            return _size;
+        }
+
+    private:
+        struct frame
+        {
+            id_type _state;
+            iter_type _first;
+            iter_type _second;
+        };
+
+        frame _stack[max_depth];
+        // Entries beyond max_depth
+        std::vector<frame> _overflow;
+        std::size_t _size = 1;
+        entry _entry;
+
+        frame& at(const std::size_t index_)
+        {
+            return index_ < max_depth ?
+                _stack[index_] : _overflow[index_ - max_depth];
+        }
+
+        void pop(const std::size_t size_)
+        {
+            _size -= size_;
+
+            if (_size < max_depth)
+                _overflow.clear();
+            else
+                _overflow.resize(_size - max_depth);
+        }
+
+        void push_frame(const id_type state_, const iter_type& first_,
+            const iter_type& second_)
+        {
+            if (_size >= max_depth)
+                _overflow.emplace_back();
+
+            frame& frame_ = at(_size++);
+
+            frame_._state = state_;
+            frame_._first = first_;
+            frame_._second = second_;
+        }
+    };
+
+    using push_parser = basic_push_parser<state_machine>;
+
+    static_assert(sizeof(push_parser) <= 512,
+        "push_parser is meant to be cheap to hold per connection");
+}
+
+#endif
@@ -0,0 +1,179 @@
+// scan_iterator.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_SCAN_ITERATOR_HPP
+#define PARSERTL_SCAN_ITERATOR_HPP
+
+#include <cstddef>
+#include <iterator>
+
+namespace parsertl
+{
+    namespace details
+    {
+        // Random access iterator that records in *furthest_ the end of
+        // the furthest character read through it, so that a lexer using
+        // it reveals how much of the input each token depended on.
+        template<typename iter_type>
+        class scan_iterator
+        {
+        public:
+            using traits = std::iterator_traits<iter_type>;
+            using value_type = typename traits::value_type;
+            using difference_type = typename traits::difference_type;
+            using pointer = typename traits::pointer;
+            using reference = typename traits::reference;
+            using iterator_category = std::random_access_iterator_tag;
+
+            scan_iterator() = default;
+
+            scan_iterator(const iter_type& iter_, iter_type* furthest_) :
+                _iter(iter_),
+                _furthest(furthest_)
+            {
+            }
+
+            reference operator *() const
+            {
+                if (_furthest && !(_iter < *_furthest))
+                    *_furthest = std::next(_iter);
+
+                return *_iter;
+            }
+
+            reference operator [](const difference_type offset_) const
+            {
+                return *(*this + offset_);
+            }
+
+            scan_iterator& operator ++()
+            {
+                ++_iter;
+                return *this;
+            }
+
+            scan_iterator operator ++(int)
+            {
+                scan_iterator iter_ = *this;
+
+                ++_iter;
+                return iter_;
+            }
+
+            scan_iterator& operator --()
+            {
+                --_iter;
+                return *this;
+            }
+
+            scan_iterator operator --(int)
+            {
+                scan_iterator iter_ = *this;
+
+                --_iter;
+                return iter_;
+            }
+
+            scan_iterator& operator +=(const difference_type offset_)
+            {
+                _iter += offset_;
+                return *this;
+            }
+
+            scan_iterator& operator -=(const difference_type offset_)
+            {
+                _iter -= offset_;
+                return *this;
+            }
+
+            scan_iterator operator +(const difference_type offset_) const
+            {
+                return scan_iterator(_iter + offset_, _furthest);
+            }
+
+            friend scan_iterator operator +(const difference_type offset_,
+                const scan_iterator& rhs_)
+            {
+                return rhs_ + offset_;
+            }
+
+            scan_iterator operator -(const difference_type offset_) const
+            {
+                return scan_iterator(_iter - offset_, _furthest);
+            }
+
+            difference_type operator -(const scan_iterator& rhs_) const
+            {
+                return _iter - rhs_._iter;
+            }
+
+            bool operator ==(const scan_iterator& rhs_) const
+            {
+                return _iter == rhs_._iter;
+            }
+
+            bool operator !=(const scan_iterator& rhs_) const
+            {
+                return _iter != rhs_._iter;
+            }
+
+            bool operator <(const scan_iterator& rhs_) const
+            {
+                return _iter < rhs_._iter;
+            }
+
+            bool operator >(const scan_iterator& rhs_) const
+            {
+                return _iter > rhs_._iter;
+            }
+
+            bool operator <=(const scan_iterator& rhs_) const
+            {
+                return _iter <= rhs_._iter;
+            }
+
+            bool operator >=(const scan_iterator& rhs_) const
+            {
+                return _iter >= rhs_._iter;
+            }
+
+            const iter_type& base() const
+            {
+                return _iter;
+            }
+
+            // Characters read so far, counted from this iterator
+            std::size_t scanned() const
+            {
+                return static_cast<std::size_t>(*_furthest - _iter);
+            }
+
+        private:
+            iter_type _iter = iter_type();
+            iter_type* _furthest = nullptr;
+        };
+
+        // The lexer_iterator type lexing iter_type instead, e.g.
+        // lexertl::iterator<iter, sm_type, lexertl::match_results<iter>>
+        // becomes
+        // lexertl::iterator<iter_type, sm_type,
+        //     lexertl::match_results<iter_type>>
+        template<typename lexer_iterator, typename iter_type>
+        struct rebind_lexer;
+
+        template<template<typename, typename, typename> class lexer,
+            typename iter, typename lsm_type,
+            template<typename, typename, std::size_t> class results,
+            typename id_type, std::size_t flags, typename iter_type>
+        struct rebind_lexer<lexer<iter, lsm_type,
+            results<iter, id_type, flags>>, iter_type>
+        {
+            using type = lexer<iter_type, lsm_type,
+                results<iter_type, id_type, flags>>;
+        };
+    }
+}
+
+#endif
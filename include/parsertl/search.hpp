@@ -6,102 +6,466 @@
 #ifndef PARSERTL_SEARCH_HPP
 #define PARSERTL_SEARCH_HPP
 
+#include <algorithm>
+#include <cstddef>
+#include "flat.hpp"
 #include <map>
 #include "match_results.hpp"
+#include <memory>
 #include "parse.hpp"
 #include <set>
 #include "token.hpp"
+#include <vector>
 
 namespace parsertl
 {
-    // Forward declarations:
     namespace details
     {
+        // Tokens lexed so far by a search, so that restarting at a later
+        // start position never lexes the same text twice.
+        // Tokens before the current start position are discarded.
+        // Tokens are held in fixed size blocks, so that references
+        // survive get() and trim(). Blocks that are no longer needed are
+        // kept for reuse rather than freed.
+        template<typename lexer_iterator>
+        class token_cache
+        {
+        public:
+            // Call reset() before use.
+            token_cache() = default;
+
+            explicit token_cache(const lexer_iterator& iter_)
+            {
+                reset(iter_);
+            }
+
+            // Starts again with iter_ at index 0, keeping the blocks
+            // allocated so far.
+            void reset(const lexer_iterator& iter_)
+            {
+                _offset = 0;
+                _first = 0;
+                _size = 0;
+                push_back(iter_);
+            }
+
+            const lexer_iterator& get(const std::size_t index_)
+            {
+                while (index_ >= _offset + _size)
+                {
+                    lexer_iterator next_ = at(_size - 1);
+
+                    ++next_;
+                    push_back(next_);
+                }
+
+                return at(index_ - _offset);
+            }
+
+            // Replaces the tokens from index_ on with those lexed by iter_,
+            // e.g. once more input follows a token that was not final.
+            void relex(const std::size_t index_, const lexer_iterator& iter_)
+            {
+                _size = index_ - _offset;
+                push_back(iter_);
+            }
+
+            void trim(const std::size_t index_)
+            {
+                if (index_ <= _offset)
+                    return;
+
+                _first += index_ - _offset;
+                _size -= index_ - _offset;
+                _offset = index_;
+
+                // Move the blocks before _first to the back for reuse
+                const std::size_t blocks_ = _first / _block_size;
+
+                std::rotate(_blocks.begin(), _blocks.begin() + blocks_,
+                    _blocks.end());
+                _first -= blocks_ * _block_size;
+            }
+
+        private:
+            static constexpr std::size_t _block_size = 32;
+            // Blocks in use first, followed by any free ones
+            std::vector<std::unique_ptr<lexer_iterator[]>> _blocks;
+            // Index of the token held at _first
+            std::size_t _offset = 0;
+            // Position of that token within the first block
+            std::size_t _first = 0;
+            std::size_t _size = 0;
+
+            lexer_iterator& at(const std::size_t pos_)
+            {
+                const std::size_t idx_ = _first + pos_;
+
+                return _blocks[idx_ / _block_size][idx_ % _block_size];
+            }
+
+            void push_back(const lexer_iterator& iter_)
+            {
+                if ((_first + _size) / _block_size == _blocks.size())
+                {
+                    _blocks.emplace_back(new lexer_iterator[_block_size]);
+                }
+
+                at(_size++) = iter_;
+            }
+        };
+
+        // Iterates a token_cache.
+        template<typename lexer_iterator>
+        class buffered_iterator
+        {
+        public:
+            using value_type = typename lexer_iterator::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type*;
+            using reference = const value_type&;
+            using iterator_category = std::forward_iterator_tag;
+
+            buffered_iterator() = default;
+
+            buffered_iterator(token_cache<lexer_iterator>& cache_,
+                const std::size_t index_) :
+                _cache(&cache_),
+                _index(index_)
+            {
+                _cache->get(_index);
+            }
+
+            buffered_iterator& operator ++()
+            {
+                ++_index;
+                _cache->get(_index);
+                return *this;
+            }
+
+            buffered_iterator operator ++(int)
+            {
+                buffered_iterator iter_ = *this;
+
+                ++*this;
+                return iter_;
+            }
+
+            const value_type& operator *() const
+            {
+                return _cache ? *_cache->get(_index) : _eoi;
+            }
+
+            const value_type* operator ->() const
+            {
+                return &**this;
+            }
+
+            bool operator ==(const buffered_iterator& rhs_) const
+            {
+                return _cache == rhs_._cache && _index == rhs_._index;
+            }
+
+            bool operator !=(const buffered_iterator& rhs_) const
+            {
+                return !(*this == rhs_);
+            }
+
+            std::size_t index() const
+            {
+                return _index;
+            }
+
+            const lexer_iterator& base() const
+            {
+                return _cache->get(_index);
+            }
+
+        private:
+            token_cache<lexer_iterator>* _cache = nullptr;
+            std::size_t _index = 0;
+            // Returned when default constructed, as for lexer_iterator
+            value_type _eoi;
+        };
+
+        // Advances start_ past tokens that cannot begin a match
+        // according to sm_._prefilter, without running the parser.
         template<typename lexer_iterator, typename sm_type>
+        void skip(buffered_iterator<lexer_iterator>& start_,
+            const sm_type& sm_)
+        {
+            if (sm_._prefilter.empty())
+                return;
+
+            buffered_iterator<lexer_iterator> next_ = start_;
+
+            while (start_->id != 0)
+            {
+                ++next_;
+
+                if (sm_._prefilter.viable(start_->id, next_->id))
+                    break;
+
+                start_ = next_;
+            }
+        }
+
+        // Allows a vector used as a stack to be restored to the contents
+        // it had when mark() was called without copying it. Elements
+        // are only saved as they are popped from below the marked size.
+        template<typename vector>
+        class stack_mark
+        {
+        public:
+            void clear()
+            {
+                _low = 0;
+                _tail.clear();
+            }
+
+            void mark(const vector& vector_)
+            {
+                _low = vector_.size();
+                _tail.clear();
+            }
+
+            // Call before vector_ is truncated to size_.
+            void pop(const vector& vector_, const std::size_t size_)
+            {
+                while (_low > size_)
+                {
+                    _tail.push_back(vector_[--_low]);
+                }
+            }
+
+            void restore(vector& vector_) const
+            {
+                vector_.resize(_low);
+                vector_.insert(vector_.end(), _tail.rbegin(), _tail.rend());
+            }
+
+        private:
+            // Lowest size reached since mark()
+            std::size_t _low = 0;
+            // Elements popped from below the marked size, top first
+            vector _tail;
+        };
+
+        // Parser stack at the last point end of input would have been
+        // valid, from which search() continues with end of input.
+        template<typename sm_type>
+        struct stack_snapshot
+        {
+            using id_type = typename sm_type::id_type;
+
+            typename sm_type::entry _entry;
+            stack_mark<std::vector<id_type>> _stack;
+
+            void clear()
+            {
+                _stack.clear();
+            }
+
+            void mark(const basic_match_results<sm_type>& results_,
+                const typename sm_type::entry& entry_)
+            {
+                _entry = entry_;
+                _stack.mark(results_.stack);
+            }
+
+            // Winds results_ back to the snapshot, ready to continue with
+            // end of input.
+            void restore(basic_match_results<sm_type>& results_) const
+            {
+                _stack.restore(results_.stack);
+                results_.token_id = 0;
+                results_.entry = _entry;
+            }
+        };
+
+        // As above, along with the productions stack and the size of the
+        // production log.
+        template<typename sm_type, typename token_vector>
+        struct eoi_snapshot : stack_snapshot<sm_type>
+        {
+            stack_mark<token_vector> _productions;
+            std::size_t _log_size = 0;
+
+            void clear()
+            {
+                stack_snapshot<sm_type>::clear();
+                _productions.clear();
+                _log_size = 0;
+            }
+
+            void mark(const basic_match_results<sm_type>& results_,
+                const token_vector& productions_,
+                const typename sm_type::entry& entry_)
+            {
+                stack_snapshot<sm_type>::mark(results_, entry_);
+                _productions.mark(productions_);
+            }
+
+            void restore(basic_match_results<sm_type>& results_,
+                token_vector& productions_) const
+            {
+                stack_snapshot<sm_type>::restore(results_);
+                _productions.restore(productions_);
+            }
+        };
+
+        // Working state for search_productions(), held by the caller so
+        // that consecutive searches reuse the memory allocated for it.
+        template<typename sm_type, typename token_vector>
+        struct search_state
+        {
+            basic_match_results<sm_type> _results;
+            token_vector _productions;
+            eoi_snapshot<sm_type, token_vector> _snapshot;
+            // Set if the search stopped at a start position whose outcome
+            // depends on a token that is not final.
+            bool _pending = false;
+            // Cache indexes of the lookahead token and of the last point
+            // end of input was valid (~0 if none) when _pending was set.
+            std::size_t _curr = 0;
+            std::size_t _last_eoi = static_cast<std::size_t>(~0);
+        };
+
+        // Predicate for search_productions() when all of the input
+        // is available.
+        struct complete_input
+        {
+            template<typename lexer_iterator>
+            bool operator ()(const lexer_iterator&) const
+            {
+                return false;
+            }
+        };
+    }
+
+    // Working memory for search(), held by the caller so that repeated
+    // searches along the same input stop allocating once it has grown
+    // large enough.
+    template<typename lexer_iterator, typename sm_type>
+    struct basic_search_scratch
+    {
+        // Qualify token to prevent arg dependant lookup
+        using token_vector =
+            typename parsertl::token<lexer_iterator>::token_vector;
+
+        details::token_cache<lexer_iterator> _cache;
+        details::search_state<sm_type, token_vector> _state;
+        basic_flat_productions<typename sm_type::id_type, token_vector>
+            _productions;
+    };
+
+    // Forward declarations:
+    namespace details
+    {
+        template<typename lexer_iterator, typename sm_type,
+            typename prod_set>
         void next(lexer_iterator& iter_, const sm_type& sm_,
-            basic_match_results<sm_type>& results_,
-            std::set<typename sm_type::id_type>* prod_set_,
-            lexer_iterator& last_eoi_,
-            basic_match_results<sm_type>& last_results_);
+            basic_match_results<sm_type>& results_, prod_set* prod_set_,
+            lexer_iterator& last_eoi_, stack_snapshot<sm_type>& snapshot_);
         template<typename lexer_iterator, typename sm_type,
-            typename token_vector>
+            typename token_vector, typename log_type>
         void next(lexer_iterator& iter_, const sm_type& sm_,
             basic_match_results<sm_type>& results_, lexer_iterator& last_eoi_,
-            token_vector& productions_);
-        template<typename lexer_iterator, typename sm_type>
+            token_vector& productions_, log_type* log_,
+            eoi_snapshot<sm_type, token_vector>& snapshot_);
+        template<typename lexer_iterator, typename sm_type,
+            typename prod_set>
         bool parse(lexer_iterator& iter_, const sm_type& sm_,
-            basic_match_results<sm_type>& results_,
-            std::set<typename sm_type::id_type>* prod_set_);
+            basic_match_results<sm_type>& results_, prod_set* prod_set_);
         template<typename lexer_iterator, typename sm_type,
-            typename token_vector>
+            typename token_vector, typename log_type>
         bool parse(lexer_iterator& iter_, const sm_type& sm_,
             basic_match_results<sm_type>& results_, token_vector& productions_,
-            std::multimap<typename sm_type::id_type, token_vector>* prod_map_);
+            log_type* log_);
+        template<typename lexer_iterator, typename sm_type,
+            typename prod_set>
+        bool search_set(lexer_iterator& iter_, lexer_iterator& end_,
+            const sm_type& sm_, prod_set* prod_set_);
+        template<typename lexer_iterator, typename sm_type,
+            typename prod_set>
+        bool search_set(token_cache<lexer_iterator>& cache_,
+            buffered_iterator<lexer_iterator>& start_,
+            buffered_iterator<lexer_iterator>& end_, const sm_type& sm_,
+            prod_set* prod_set_, basic_match_results<sm_type>& results_,
+            stack_snapshot<sm_type>& snapshot_);
         template<typename lexer_iterator, typename sm_type,
             typename token_vector>
-        bool parse(lexer_iterator& iter_, const sm_type& sm_,
-            basic_match_results<sm_type>& results_, token_vector& productions_,
-            std::vector<std::pair<typename sm_type::id_type, token_vector>>*
-            prod_vec_);
+        bool search_productions(lexer_iterator& iter_, lexer_iterator& end_,
+            const sm_type& sm_,
+            basic_flat_productions<typename sm_type::id_type, token_vector>*
+            log_);
+        template<typename lexer_iterator, typename sm_type,
+            typename token_vector>
+        bool search_productions(lexer_iterator& iter_, lexer_iterator& end_,
+            const sm_type& sm_,
+            basic_flat_productions<typename sm_type::id_type, token_vector>*
+            log_, token_cache<lexer_iterator>& cache_,
+            search_state<sm_type, token_vector>& state_);
+        template<typename lexer_iterator, typename sm_type,
+            typename token_vector, typename log_type, typename predicate,
+            typename limit = complete_input>
+        bool search_productions(token_cache<lexer_iterator>& cache_,
+            buffered_iterator<lexer_iterator>& start_,
+            buffered_iterator<lexer_iterator>& end_, const sm_type& sm_,
+            log_type* log_, search_state<sm_type, token_vector>& state_,
+            predicate pending_, limit stop_ = limit());
+        template<typename sm_type, typename productions, typename iterator,
+            typename captures>
+        void assign_captures(const sm_type& sm_,
+            const productions& productions_, const iterator& first_,
+            captures& captures_);
     }
 
     template<typename lexer_iterator, typename sm_type, typename captures>
     bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
         captures& captures_)
     {
-        basic_match_results<sm_type> results_(iter_->id, sm_);
         // Qualify token to prevent arg dependant lookup
         using token = parsertl::token<lexer_iterator>;
         using token_vector = typename token::token_vector;
-        std::multimap<typename sm_type::id_type, token_vector> prod_map_;
-        bool success_ = search(iter_, end_, sm_, &prod_map_);
+        basic_flat_productions<typename sm_type::id_type, token_vector>
+            productions_;
+        bool success_ = details::search_productions(iter_, end_, sm_,
+            &productions_);
 
         captures_.clear();
 
         if (success_)
-        {
-            auto last_ = iter_->first;
+            details::assign_captures(sm_, productions_, iter_->first,
+                captures_);
 
-            captures_.resize((sm_._captures.empty() ? 0 :
-                sm_._captures.back().first +
-                sm_._captures.back().second.size()) + 1);
-            captures_[0].emplace_back(iter_->first, iter_->first);
-
-            for (const auto& pair_ : prod_map_)
-            {
-                if (sm_._captures.size() > pair_.first)
-                {
-                    const auto& row_ = sm_._captures[pair_.first];
-
-                    if (!row_.second.empty())
-                    {
-                        std::size_t index_ = 0;
-
-                        for (const auto& token_ : row_.second)
-                        {
-                            const auto& token1_ = pair_.second[token_.first];
-                            const auto& token2_ = pair_.second[token_.second];
-                            auto& entry_ = captures_[row_.first + index_ + 1];
+        return success_;
+    }
 
-                            entry_.emplace_back(token1_.first, token2_.second);
-                            ++index_;
-                        }
-                    }
-                }
-            }
+    // As above, but with all captures held in a single buffer.
+    template<typename lexer_iterator, typename sm_type, typename iterator>
+    bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
+        basic_flat_captures<iterator>& captures_)
+    {
+        basic_search_scratch<lexer_iterator, sm_type> scratch_;
 
-            for (const auto& pair_ : prod_map_)
-            {
-                auto sec_ = pair_.second.back().second;
+        return search(iter_, end_, sm_, captures_, scratch_);
+    }
 
-                if (sec_ > last_)
-                {
-                    last_ = sec_;
-                }
-            }
+    // As above, reusing scratch_ from previous calls. Once captures_ and
+    // scratch_ have reached the size needed, a hit makes no allocations.
+    template<typename lexer_iterator, typename sm_type, typename iterator>
+    bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
+        basic_flat_captures<iterator>& captures_,
+        basic_search_scratch<lexer_iterator, sm_type>& scratch_)
+    {
+        const bool success_ = details::search_productions(iter_, end_, sm_,
+            &scratch_._productions, scratch_._cache, scratch_._state);
 
-            captures_.front().back().second = last_;
-        }
+        if (success_)
+            captures_.assign(sm_, scratch_._productions, iter_->first);
+        else
+            captures_.clear();
 
         return success_;
     }
@@ -111,219 +475,474 @@ namespace parsertl
     bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
         std::set<typename sm_type::id_type>* prod_set_ = nullptr)
     {
-        bool hit_ = false;
-        lexer_iterator curr_ = iter_;
-        lexer_iterator last_eoi_;
-        // results_ defined here so that allocated memory can be reused.
-        basic_match_results<sm_type> results_;
-        basic_match_results<sm_type> last_results_;
+        return details::search_set(iter_, end_, sm_, prod_set_);
+    }
 
-        end_ = lexer_iterator();
+    template<typename lexer_iterator, typename sm_type>
+    bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
+        basic_flat_set<typename sm_type::id_type>* prod_set_)
+    {
+        return details::search_set(iter_, end_, sm_, prod_set_);
+    }
 
-        while (curr_ != end_)
+    template<typename lexer_iterator, typename sm_type, typename token_vector>
+    bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
+        std::multimap<typename sm_type::id_type, token_vector>*
+        prod_map_ = nullptr)
+    {
+        basic_flat_productions<typename sm_type::id_type, token_vector>
+            productions_;
+        const bool hit_ = details::search_productions(iter_, end_, sm_,
+            prod_map_ ? &productions_ : nullptr);
+
+        if (prod_map_)
         {
-            if (prod_set_)
+            prod_map_->clear();
+
+            for (std::size_t idx_ = 0, size_ = productions_.size();
+                idx_ < size_; ++idx_)
             {
-                prod_set_->clear();
+                const auto prod_ = productions_[idx_];
+
+                prod_map_->insert(std::make_pair(prod_.id,
+                    token_vector(prod_.begin(), prod_.end())));
             }
+        }
 
-            results_.reset(curr_->id, sm_);
-            last_results_.clear();
+        return hit_;
+    }
 
-            while (results_.entry.action != action::accept &&
-                results_.entry.action != action::error)
-            {
-                details::next(curr_, sm_, results_, prod_set_, last_eoi_,
-                    last_results_);
-            }
+    template<typename lexer_iterator, typename sm_type, typename token_vector>
+    bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
+        std::vector<std::pair<typename sm_type::id_type, token_vector>>*
+        prod_vec_ = nullptr)
+    {
+        basic_flat_productions<typename sm_type::id_type, token_vector>
+            productions_;
+        const bool hit_ = details::search_productions(iter_, end_, sm_,
+            prod_vec_ ? &productions_ : nullptr);
 
-            hit_ = results_.entry.action == action::accept;
+        if (prod_vec_)
+        {
+            prod_vec_->clear();
 
-            if (hit_)
-            {
-                end_ = curr_;
-                break;
-            }
-            else if (last_eoi_->id != 0)
+            for (std::size_t idx_ = 0, size_ = productions_.size();
+                idx_ < size_; ++idx_)
             {
-                lexer_iterator eoi_;
+                const auto prod_ = productions_[idx_];
 
-                hit_ = details::parse(eoi_, sm_, last_results_, prod_set_);
-
-                if (hit_)
-                {
-                    end_ = last_eoi_;
-                    break;
-                }
+                prod_vec_->emplace_back(prod_.id,
+                    token_vector(prod_.begin(), prod_.end()));
             }
+        }
 
-            if (iter_->id != 0)
-                ++iter_;
+        return hit_;
+    }
 
-            curr_ = iter_;
+    // Returns the number of matches a search_iterator would visit
+    // starting at iter_, without recording captures or productions.
+    template<typename lexer_iterator, typename sm_type>
+    std::size_t search_count(const lexer_iterator& iter_, const sm_type& sm_)
+    {
+        using buffered_iterator = details::buffered_iterator<lexer_iterator>;
+        details::token_cache<lexer_iterator> cache_(iter_);
+        buffered_iterator start_(cache_, 0);
+        buffered_iterator end_;
+        // Shared by every search
+        basic_match_results<sm_type> results_;
+        details::stack_snapshot<sm_type> snapshot_;
+        std::size_t count_ = 0;
+
+        while (details::search_set(cache_, start_, end_, sm_,
+            static_cast<std::set<typename sm_type::id_type>*>(nullptr),
+            results_, snapshot_))
+        {
+            ++count_;
+            start_ = end_;
         }
 
-        return hit_;
+        return count_;
     }
 
-    template<typename lexer_iterator, typename sm_type, typename token_vector>
-    bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
-        std::multimap<typename sm_type::id_type, token_vector>*
-        prod_map_ = nullptr)
+    // Returns true if search() would find a match starting at or after
+    // iter_. Stops at the first match found.
+    template<typename lexer_iterator, typename sm_type>
+    bool search_any(const lexer_iterator& iter_, const sm_type& sm_)
     {
-        bool hit_ = false;
-        lexer_iterator curr_ = iter_;
-        lexer_iterator last_eoi_;
-        // results_ and productions_ defined here so that
-        // allocated memory can be reused.
+        using buffered_iterator = details::buffered_iterator<lexer_iterator>;
+        details::token_cache<lexer_iterator> cache_(iter_);
+        buffered_iterator start_(cache_, 0);
+        buffered_iterator end_;
         basic_match_results<sm_type> results_;
-        token_vector productions_;
+        details::stack_snapshot<sm_type> snapshot_;
+
+        return details::search_set(cache_, start_, end_, sm_,
+            static_cast<std::set<typename sm_type::id_type>*>(nullptr),
+            results_, snapshot_);
+    }
 
-        end_ = lexer_iterator();
+    // Productions in reduction order, held in a single buffer.
+    template<typename lexer_iterator, typename sm_type, typename token_vector>
+    bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
+        basic_flat_productions<typename sm_type::id_type, token_vector>*
+        productions_)
+    {
+        return details::search_productions(iter_, end_, sm_, productions_);
+    }
 
-        while (curr_ != end_)
+    namespace details
+    {
+        template<typename lexer_iterator, typename sm_type,
+            typename prod_set>
+        bool search_set(lexer_iterator& iter_, lexer_iterator& end_,
+            const sm_type& sm_, prod_set* prod_set_)
         {
-            if (prod_map_)
-            {
-                prod_map_->clear();
-            }
+            using buffered_iterator = buffered_iterator<lexer_iterator>;
+            token_cache<lexer_iterator> cache_(iter_);
+            buffered_iterator start_(cache_, 0);
+            buffered_iterator match_end_;
+            basic_match_results<sm_type> results_;
+            stack_snapshot<sm_type> snapshot_;
+            const bool hit_ = search_set(cache_, start_, match_end_, sm_,
+                prod_set_, results_, snapshot_);
+
+            end_ = hit_ ? match_end_.base() : lexer_iterator();
+            iter_ = start_.base();
+            return hit_;
+        }
 
-            results_.reset(curr_->id, sm_);
-            productions_.clear();
+        // Searches from start_ within cache_, so that consecutive
+        // searches can share the tokens already lexed along with
+        // the memory allocated for results_ and snapshot_.
+        template<typename lexer_iterator, typename sm_type,
+            typename prod_set>
+        bool search_set(token_cache<lexer_iterator>& cache_,
+            buffered_iterator<lexer_iterator>& start_,
+            buffered_iterator<lexer_iterator>& end_, const sm_type& sm_,
+            prod_set* prod_set_, basic_match_results<sm_type>& results_,
+            stack_snapshot<sm_type>& snapshot_)
+        {
+            using buffered_iterator = buffered_iterator<lexer_iterator>;
+            const lexer_iterator eoi_;
+            bool hit_ = false;
 
-            while (results_.entry.action != action::accept &&
-                results_.entry.action != action::error)
-            {
-                details::next(curr_, sm_, results_, last_eoi_, productions_);
-            }
+            skip(start_, sm_);
+            cache_.trim(start_.index());
 
-            hit_ = results_.entry.action == action::accept;
+            buffered_iterator curr_ = start_;
+            buffered_iterator last_eoi_;
 
-            if (hit_)
+            while (curr_.base() != eoi_)
             {
-                if (prod_map_)
+                if (prod_set_)
                 {
-                    lexer_iterator again_(iter_->first, last_eoi_->first,
-                        iter_.sm());
-
-                    results_.reset(iter_->id, sm_);
-                    productions_.clear();
-                    details::parse(again_, sm_, results_, productions_,
-                        prod_map_);
+                    prod_set_->clear();
                 }
 
-                end_ = curr_;
-                break;
-            }
-            else if (last_eoi_->id != 0)
-            {
-                lexer_iterator again_(iter_->first, last_eoi_->first,
-                    iter_.sm());
+                results_.reset(curr_->id, sm_);
+                snapshot_.clear();
+                last_eoi_ = buffered_iterator();
+
+                while (results_.entry.action != action::accept &&
+                    results_.entry.action != action::error)
+                {
+                    next(curr_, sm_, results_, prod_set_, last_eoi_,
+                        snapshot_);
+                }
 
-                results_.reset(iter_->id, sm_);
-                productions_.clear();
-                hit_ = details::parse(again_, sm_, results_, productions_,
-                    prod_map_);
+                hit_ = results_.entry.action == action::accept;
 
                 if (hit_)
                 {
-                    end_ = last_eoi_;
+                    end_ = curr_;
                     break;
                 }
+                else if (last_eoi_->id != 0)
+                {
+                    // Continue from the last point end of input was valid
+                    lexer_iterator iter_;
+
+                    snapshot_.restore(results_);
+                    hit_ = parse(iter_, sm_, results_, prod_set_);
+
+                    if (hit_)
+                    {
+                        end_ = last_eoi_;
+                        break;
+                    }
+                }
+
+                if (start_->id != 0)
+                    ++start_;
+
+                skip(start_, sm_);
+                cache_.trim(start_.index());
+                curr_ = start_;
             }
 
-            if (iter_->id != 0)
-                ++iter_;
+            return hit_;
+        }
 
-            curr_ = iter_;
+        template<typename lexer_iterator, typename sm_type,
+            typename token_vector>
+        bool search_productions(lexer_iterator& iter_, lexer_iterator& end_,
+            const sm_type& sm_,
+            basic_flat_productions<typename sm_type::id_type, token_vector>*
+            log_)
+        {
+            token_cache<lexer_iterator> cache_;
+            search_state<sm_type, token_vector> state_;
+
+            return search_productions(iter_, end_, sm_, log_, cache_,
+                state_);
         }
 
-        return hit_;
-    }
+        // As above, reusing cache_ and state_.
+        template<typename lexer_iterator, typename sm_type,
+            typename token_vector>
+        bool search_productions(lexer_iterator& iter_, lexer_iterator& end_,
+            const sm_type& sm_,
+            basic_flat_productions<typename sm_type::id_type, token_vector>*
+            log_, token_cache<lexer_iterator>& cache_,
+            search_state<sm_type, token_vector>& state_)
+        {
+            using buffered_iterator = buffered_iterator<lexer_iterator>;
 
-    template<typename lexer_iterator, typename sm_type, typename token_vector>
-    bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
-        std::vector<std::pair<typename sm_type::id_type, token_vector>>*
-        prod_vec_ = nullptr)
-    {
-        bool hit_ = false;
-        lexer_iterator curr_ = iter_;
-        lexer_iterator last_eoi_;
-        // results_ and productions_ defined here so that
-        // allocated memory can be reused.
-        basic_match_results<sm_type> results_;
-        token_vector productions_;
+            cache_.reset(iter_);
 
-        end_ = lexer_iterator();
+            buffered_iterator start_(cache_, 0);
+            buffered_iterator match_end_;
+            const bool hit_ = search_productions(cache_, start_, match_end_,
+                sm_, log_, state_, complete_input());
+
+            end_ = hit_ ? match_end_.base() : lexer_iterator();
+            iter_ = start_.base();
+            return hit_;
+        }
 
-        while (curr_ != end_)
+        // Searches from start_ within cache_ (see search_set()).
+        // Productions are recorded into log_ as the search goes, so a hit
+        // does not have to be parsed a second time. log_type is
+        // basic_flat_productions or any type with the same push(),
+        // size(), truncate() and clear().
+        // pending_(token_) returns true for a token that more input could
+        // still change (e.g. end of input at the end of a chunk). The parse
+        // stops as soon as such a token is the lookahead, leaving start_
+        // where the parse began and setting state_._pending. Calling again
+        // with state_._pending set resumes that parse, once the caller has
+        // relexed cache_ from state_._curr (see token_cache::relex()).
+        // stop_(token_) returns true for a start position that is not to
+        // be tried. The search then fails, leaving start_ there.
+        template<typename lexer_iterator, typename sm_type,
+            typename token_vector, typename log_type, typename predicate,
+            typename limit>
+        bool search_productions(token_cache<lexer_iterator>& cache_,
+            buffered_iterator<lexer_iterator>& start_,
+            buffered_iterator<lexer_iterator>& end_, const sm_type& sm_,
+            log_type* log_, search_state<sm_type, token_vector>& state_,
+            predicate pending_, limit stop_)
         {
-            if (prod_vec_)
+            using buffered_iterator = buffered_iterator<lexer_iterator>;
+            const lexer_iterator eoi_;
+            auto& results_ = state_._results;
+            auto& productions_ = state_._productions;
+            auto& snapshot_ = state_._snapshot;
+            bool hit_ = false;
+
+            for (;;)
             {
-                prod_vec_->clear();
-            }
+                buffered_iterator curr_;
+                buffered_iterator last_eoi_;
 
-            results_.reset(curr_->id, sm_);
-            productions_.clear();
+                if (state_._pending)
+                {
+                    curr_ = buffered_iterator(cache_, state_._curr);
 
-            while (results_.entry.action != action::accept &&
-                results_.entry.action != action::error)
-            {
-                details::next(curr_, sm_, results_, last_eoi_, productions_);
-            }
+                    if (state_._last_eoi != static_cast<std::size_t>(~0))
+                        last_eoi_ = buffered_iterator(cache_, state_._last_eoi);
 
-            hit_ = results_.entry.action == action::accept;
+                    // The lookahead may have been lexed differently
+                    results_.token_id = curr_->id;
 
-            if (hit_)
-            {
-                if (prod_vec_)
+                    if (results_.token_id == lexer_iterator::value_type::npos())
+                    {
+                        results_.entry.action = action::error;
+                        results_.entry.param =
+                            static_cast<typename sm_type::id_type>
+                            (error_type::unknown_token);
+                    }
+                    else
+                    {
+                        results_.entry = sm_.at(results_.stack.back(),
+                            results_.token_id);
+                    }
+
+                    state_._pending = false;
+                }
+                else
                 {
-                    lexer_iterator again_(iter_->first, last_eoi_->first,
-                        iter_.sm());
+                    const std::size_t index_ = start_.index();
+
+                    skip(start_, sm_);
+
+                    // skip() looks at the token following each one it
+                    // passes over.
+                    for (std::size_t idx_ = index_; idx_ < start_.index();
+                        ++idx_)
+                    {
+                        if (pending_(cache_.get(idx_ + 1)))
+                        {
+                            start_ = buffered_iterator(cache_, idx_);
+                            break;
+                        }
+                    }
 
-                    results_.reset(iter_->id, sm_);
+                    cache_.trim(start_.index());
+
+                    if (start_.base() == eoi_ || stop_(start_.base()))
+                        break;
+
+                    curr_ = start_;
+
+                    if (log_)
+                    {
+                        log_->clear();
+                    }
+
+                    results_.reset(curr_->id, sm_);
                     productions_.clear();
-                    details::parse(again_, sm_, results_, productions_,
-                        prod_vec_);
+                    snapshot_.clear();
                 }
 
-                end_ = curr_;
-                break;
-            }
-            else if (last_eoi_->id != 0)
-            {
-                lexer_iterator again_(iter_->first, last_eoi_->first,
-                    iter_.sm());
+                // Nothing may depend on a lookahead that could change
+                bool pending_lookahead_ = pending_(curr_.base());
+
+                while (!pending_lookahead_ &&
+                    results_.entry.action != action::accept &&
+                    results_.entry.action != action::error)
+                {
+                    const bool shift_ = results_.entry.action == action::shift;
 
-                results_.reset(iter_->id, sm_);
-                productions_.clear();
-                hit_ = details::parse(again_, sm_, results_, productions_,
-                    prod_vec_);
+                    next(curr_, sm_, results_, last_eoi_, productions_, log_,
+                        snapshot_);
+
+                    if (shift_)
+                        pending_lookahead_ = pending_(curr_.base());
+                }
+
+                if (pending_lookahead_)
+                {
+                    state_._pending = true;
+                    state_._curr = curr_.index();
+                    state_._last_eoi = last_eoi_ == buffered_iterator() ?
+                        static_cast<std::size_t>(~0) : last_eoi_.index();
+                    break;
+                }
+
+                hit_ = results_.entry.action == action::accept;
 
                 if (hit_)
                 {
-                    end_ = last_eoi_;
+                    end_ = curr_;
                     break;
                 }
+                else if (last_eoi_->id != 0)
+                {
+                    // Continue from the last point end of input was valid
+                    lexer_iterator iter_;
+
+                    snapshot_.restore(results_, productions_);
+
+                    if (log_)
+                    {
+                        log_->truncate(snapshot_._log_size);
+                        hit_ = parse(iter_, sm_, results_, productions_, log_);
+                    }
+                    else
+                    {
+                        hit_ = parse(iter_, sm_, results_,
+                            static_cast<std::set<typename sm_type::id_type>*>
+                            (nullptr));
+                    }
+
+                    if (hit_)
+                    {
+                        end_ = last_eoi_;
+                        break;
+                    }
+                }
+
+                if (start_->id != 0)
+                    ++start_;
             }
 
-            if (iter_->id != 0)
-                ++iter_;
+            // A pending parse keeps its productions to resume with
+            if (!hit_ && !state_._pending && log_)
+                log_->clear();
 
-            curr_ = iter_;
+            return hit_;
         }
 
-        return hit_;
+        // Fills in captures_ (as for match()) from the productions_
+        // recorded for a match starting at first_.
+        template<typename sm_type, typename productions, typename iterator,
+            typename captures>
+        void assign_captures(const sm_type& sm_,
+            const productions& productions_, const iterator& first_,
+            captures& captures_)
+        {
+            auto last_ = first_;
+
+            captures_.clear();
+            captures_.resize((sm_._captures.empty() ? 0 :
+                sm_._captures.back().first +
+                sm_._captures.back().second.size()) + 1);
+            captures_[0].emplace_back(first_, first_);
+
+
+            for (std::size_t idx_ = 0, size_ = productions_.size();
+                idx_ < size_; ++idx_)
+            {
+                const auto prod_ = productions_[idx_];
+
+                if (sm_._captures.size() > prod_.id)
+                {
+                    const auto& row_ = sm_._captures[prod_.id];
+
+                    if (!row_.second.empty())
+                    {
+                        std::size_t index_ = 0;
+
+                        for (const auto& token_ : row_.second)
+                        {
+                            const auto& token1_ = prod_[token_.first];
+                            const auto& token2_ = prod_[token_.second];
+                            auto& entry_ = captures_[row_.first + index_ + 1];
+
+                            entry_.emplace_back(token1_.first, token2_.second);
+                            ++index_;
+                        }
+                    }
+                }
+
+                auto sec_ = prod_.back().second;
+
+                if (sec_ > last_)
+                {
+                    last_ = sec_;
+                }
+            }
+            captures_.front().back().second = last_;
+        }
     }
 
     namespace details
     {
-        template<typename lexer_iterator, typename sm_type>
+        template<typename lexer_iterator, typename sm_type,
+            typename prod_set>
         void next(lexer_iterator& iter_, const sm_type& sm_,
-            basic_match_results<sm_type>& results_,
-            std::set<typename sm_type::id_type>* prod_set_,
-            lexer_iterator& last_eoi_,
-            basic_match_results<sm_type>& last_results_)
+            basic_match_results<sm_type>& results_, prod_set* prod_set_,
+            lexer_iterator& last_eoi_, stack_snapshot<sm_type>& snapshot_)
         {
             switch (results_.entry.action)
             {
@@ -354,9 +973,7 @@ namespace parsertl
                 if (eoi_.action != action::error)
                 {
                     last_eoi_ = iter_;
-                    last_results_.stack = results_.stack;
-                    last_results_.token_id = 0;
-                    last_results_.entry = eoi_;
+                    snapshot_.mark(results_, eoi_);
                 }
 
                 break;
@@ -373,6 +990,8 @@ namespace parsertl
 
                 if (size_)
                 {
+                    snapshot_._stack.pop(results_.stack,
+                        results_.stack.size() - size_);
                     results_.stack.resize(results_.stack.size() - size_);
                 }
 
@@ -406,10 +1025,11 @@ namespace parsertl
         }
 
         template<typename lexer_iterator, typename sm_type,
-            typename token_vector>
+            typename token_vector, typename log_type>
         void next(lexer_iterator& iter_, const sm_type& sm_,
             basic_match_results<sm_type>& results_, lexer_iterator& last_eoi_,
-            token_vector& productions_)
+            token_vector& productions_, log_type* log_,
+            eoi_snapshot<sm_type, token_vector>& snapshot_)
         {
             switch (results_.entry.action)
             {
@@ -442,6 +1062,10 @@ namespace parsertl
                 if (eoi_.action != action::error)
                 {
                     last_eoi_ = iter_;
+                    snapshot_.mark(results_, productions_, eoi_);
+
+                    if (log_)
+                        snapshot_._log_size = log_->size();
                 }
 
                 break;
@@ -450,12 +1074,22 @@ namespace parsertl
             {
                 const std::size_t size_ =
                     sm_._rules[results_.entry.param]._rhs.size();
-                token<lexer_iterator> token_;
+                typename token_vector::value_type token_;
 
                 if (size_)
                 {
+                    if (log_)
+                    {
+                        log_->push(results_.entry.param,
+                            productions_.end() - size_, productions_.end());
+                    }
+
                     token_.first = (productions_.end() - size_)->first;
                     token_.second = productions_.back().second;
+                    snapshot_._stack.pop(results_.stack,
+                        results_.stack.size() - size_);
+                    snapshot_._productions.pop(productions_,
+                        productions_.size() - size_);
                     results_.stack.resize(results_.stack.size() - size_);
                     productions_.resize(productions_.size() - size_);
                 }
@@ -503,10 +1137,10 @@ namespace parsertl
             }
         }
 
-        template<typename lexer_iterator, typename sm_type>
+        template<typename lexer_iterator, typename sm_type,
+            typename prod_set>
         bool parse(lexer_iterator& iter_, const sm_type& sm_,
-            basic_match_results<sm_type>& results_,
-            std::set<typename sm_type::id_type>* prod_set_)
+            basic_match_results<sm_type>& results_, prod_set* prod_set_)
         {
             while (results_.entry.action != action::error)
             {
@@ -583,114 +1217,10 @@ namespace parsertl
         }
 
         template<typename lexer_iterator, typename sm_type,
-            typename token_vector>
-        bool parse(lexer_iterator& iter_, const sm_type& sm_,
-            basic_match_results<sm_type>& results_, token_vector& productions_,
-            std::multimap<typename sm_type::id_type, token_vector>* prod_map_)
-        {
-            while (results_.entry.action != action::error)
-            {
-                switch (results_.entry.action)
-                {
-                case action::shift:
-                    results_.stack.push_back(results_.entry.param);
-                    productions_.emplace_back(iter_->id, iter_->first,
-                        iter_->second);
-
-                    if (iter_->id != 0)
-                        ++iter_;
-
-                    results_.token_id = iter_->id;
-
-                    if (results_.token_id == lexer_iterator::value_type::npos())
-                    {
-                        results_.entry.action = action::error;
-                        results_.entry.param =
-                            static_cast<typename sm_type::id_type>
-                            (error_type::unknown_token);
-                    }
-                    else
-                    {
-                        results_.entry =
-                            sm_.at(results_.stack.back(), results_.token_id);
-                    }
-
-                    break;
-                case action::reduce:
-                {
-                    const std::size_t size_ =
-                        sm_._rules[results_.entry.param]._rhs.size();
-                    token<lexer_iterator> token_;
-
-                    if (size_)
-                    {
-                        if (prod_map_)
-                        {
-                            prod_map_->insert(std::make_pair(results_.entry.
-                                param, token_vector(productions_.end() - size_,
-                                    productions_.end())));
-                        }
-
-                        token_.first = (productions_.end() - size_)->first;
-                        token_.second = productions_.back().second;
-                        results_.stack.resize(results_.stack.size() - size_);
-                        productions_.resize(productions_.size() - size_);
-                    }
-                    else
-                    {
-                        if (productions_.empty())
-                        {
-                            token_.first = token_.second = iter_->first;
-                        }
-                        else
-                        {
-                            token_.first = token_.second =
-                                productions_.back().second;
-                        }
-                    }
-
-                    results_.token_id = sm_._rules[results_.entry.param]._lhs;
-                    results_.entry =
-                        sm_.at(results_.stack.back(), results_.token_id);
-                    token_.id = results_.token_id;
-                    productions_.push_back(token_);
-                    break;
-                }
-                case action::go_to:
-                    results_.stack.push_back(results_.entry.param);
-                    results_.token_id = iter_->id;
-                    results_.entry =
-                        sm_.at(results_.stack.back(), results_.token_id);
-                    break;
-                default:
-                    // accept
-                    // error
-                    break;
-                }
-
-                if (results_.entry.action == action::accept)
-                {
-                    const std::size_t size_ =
-                        sm_._rules[results_.entry.param]._rhs.size();
-
-                    if (size_)
-                    {
-                        results_.stack.resize(results_.stack.size() - size_);
-                    }
-
-                    break;
-                }
-            }
-
-            return results_.entry.action == action::accept;
-        }
-
-        template<typename lexer_iterator, typename sm_type,
-            typename token_vector>
+            typename token_vector, typename log_type>
         bool parse(lexer_iterator& iter_, const sm_type& sm_,
             basic_match_results<sm_type>& results_, token_vector& productions_,
-            std::vector<std::pair<typename sm_type::id_type, token_vector>>*
-            prod_vec_)
+            log_type* log_)
         {
             while (results_.entry.action != action::error)
             {
@@ -724,15 +1254,14 @@ namespace parsertl
                 {
                     const std::size_t size_ =
                         sm_._rules[results_.entry.param]._rhs.size();
-                    token<lexer_iterator> token_;
+                    typename token_vector::value_type token_;
 
                     if (size_)
                     {
-                        if (prod_vec_)
+                        if (log_)
                         {
-                            prod_vec_->emplace_back(results_.entry.
-                                param, token_vector(productions_.end() - size_,
-                                    productions_.end()));
+                            log_->push(results_.entry.param,
+                                productions_.end() - size_, productions_.end());
                         }
 
                         token_.first = (productions_.end() - size_)->first;
@@ -0,0 +1,85 @@
+// search_file.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_SEARCH_FILE_HPP
+#define PARSERTL_SEARCH_FILE_HPP
+
+#include <fstream>
+#include <lexertl/memory_file.hpp>
+#include "match_results.hpp"
+#include "runtime_error.hpp"
+#include "search.hpp"
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace parsertl
+{
+    // Memory maps pathname_ and calls func_(first_, second_) for each
+    // match a search_iterator would visit, where first_ and second_ are
+    // offsets (in characters) of the start and end of the match within
+    // the file. The file is lexed in place, so it is never copied into
+    // memory. Returns the number of matches.
+    template<typename lexer_iterator, typename lsm_type, typename sm_type,
+        typename functor>
+    std::size_t search_file(const char* pathname_, const lsm_type& lsm_,
+        const sm_type& sm_, functor func_)
+    {
+        using char_type = typename lexer_iterator::value_type::char_type;
+        using buffered_iterator = details::buffered_iterator<lexer_iterator>;
+        lexertl::basic_memory_file<char_type> file_(pathname_);
+
+        if (!file_.data())
+        {
+            // An empty file cannot be mapped
+            if (std::ifstream(pathname_))
+                return 0;
+
+            throw runtime_error(std::string("Unable to open ") + pathname_ +
+                " in parsertl::search_file().");
+        }
+
+        const char_type* data_ = file_.data();
+        const lexer_iterator iter_(data_, data_ + file_.size(), lsm_);
+        details::token_cache<lexer_iterator> cache_(iter_);
+        buffered_iterator start_(cache_, 0);
+        buffered_iterator end_;
+        // Shared by every search
+        basic_match_results<sm_type> results_;
+        details::stack_snapshot<sm_type> snapshot_;
+        std::size_t count_ = 0;
+
+        while (details::search_set(cache_, start_, end_, sm_,
+            static_cast<std::set<typename sm_type::id_type>*>(nullptr),
+            results_, snapshot_))
+        {
+            // end_ is the token following the match
+            const auto& last_ = cache_.get(end_.index() - 1);
+
+            func_(static_cast<std::size_t>(start_->first - data_),
+                static_cast<std::size_t>(last_->second - data_));
+            ++count_;
+            start_ = end_;
+        }
+
+        return count_;
+    }
+
+    // As above, appending each match to spans_.
+    template<typename lexer_iterator, typename lsm_type, typename sm_type>
+    std::size_t search_file(const char* pathname_, const lsm_type& lsm_,
+        const sm_type& sm_,
+        std::vector<std::pair<std::size_t, std::size_t>>& spans_)
+    {
+        return search_file<lexer_iterator>(pathname_, lsm_, sm_,
+            [&spans_](const std::size_t first_, const std::size_t second_)
+            {
+                spans_.emplace_back(first_, second_);
+            });
+    }
+}
+
+#endif
@@ -0,0 +1,616 @@
+// search_memo.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_SEARCH_MEMO_HPP
+#define PARSERTL_SEARCH_MEMO_HPP
+
+#include <algorithm>
+#include "match_results.hpp"
+#include "search.hpp"
+#include <set>
+#include "state_machine.hpp"
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace parsertl
+{
+    namespace details
+    {
+        // Parser stack entry. Popping just follows _parent, so the
+        // stack at any earlier point in a parse remains available.
+        template<typename id_type>
+        struct search_frame
+        {
+            id_type _state = 0;
+            std::size_t _parent = static_cast<std::size_t>(~0);
+
+            search_frame() = default;
+
+            search_frame(const id_type state_, const std::size_t parent_) :
+                _state(state_),
+                _parent(parent_)
+            {
+            }
+        };
+
+        // A shift made during the current search() attempt.
+        struct search_point
+        {
+            // Token index of the lookahead following the shift
+            std::size_t _index = 0;
+            std::size_t _top = 0;
+            std::size_t _height = 0;
+            // Lowest stack height reached from here on
+            std::size_t _low = 0;
+        };
+    }
+
+    // Parser configurations that search() has found lead to failure.
+    // A configuration is a token position plus the part of the stack that
+    // is read before the parse fails, so a later start position that
+    // arrives at the same configuration stops immediately rather than
+    // parsing the same tokens again. Where end of input would have been
+    // valid along the way, that point is stored too, so the result is
+    // always identical to search() without a memo.
+    // Positions are token counts from the first token searched after
+    // reset(), so entries remain valid for consecutive search() calls
+    // over the same input (e.g. one per match) and for a search that
+    // starts again from that first token. A search starting anywhere
+    // else discards them. Call reset() before searching a different
+    // input or with a different state machine.
+    // When budget_ (bytes) is exceeded, entries for positions before the
+    // current start position are evicted, as that search cannot reach
+    // them, along with those furthest ahead until at most half the
+    // budget is in use.
+    template<typename iter_type, typename id_type = uint16_t>
+    class basic_search_memo
+    {
+    public:
+        using entry = typename base_state_machine<id_type>::entry;
+        using frame = details::search_frame<id_type>;
+
+        struct config
+        {
+            std::size_t _position = 0;
+            std::size_t _next = static_cast<std::size_t>(~0);
+            // States from the top of the stack down
+            std::size_t _first = 0;
+            std::size_t _length = 0;
+            // Last point end of input was valid, if any, as a number of
+            // tokens after _position.
+            bool _eoi = false;
+            std::size_t _eoi_offset = 0;
+            entry _eoi_entry;
+            // Stack at that point, from the lowest state read upwards
+            std::size_t _eoi_first = 0;
+            std::size_t _eoi_length = 0;
+        };
+
+        explicit basic_search_memo(const std::size_t budget_ = 16777216) :
+            _budget(budget_)
+        {
+        }
+
+        void reset()
+        {
+            discard();
+            _started = false;
+        }
+
+        void clear()
+        {
+            reset();
+            clear_statistics();
+        }
+
+        void clear_statistics()
+        {
+            _hits = _misses = _evictions = 0;
+        }
+
+        std::size_t size() const
+        {
+            return _configs.size();
+        }
+
+        // Approximate bytes in use
+        std::size_t memory() const
+        {
+            return _configs.size() * sizeof(config) +
+                _states.size() * sizeof(id_type) +
+                _heads.size() * (sizeof(std::size_t) * 4);
+        }
+
+        std::size_t budget() const
+        {
+            return _budget;
+        }
+
+        std::size_t hits() const
+        {
+            return _hits;
+        }
+
+        std::size_t misses() const
+        {
+            return _misses;
+        }
+
+        // Number of times the budget was exceeded
+        std::size_t evictions() const
+        {
+            return _evictions;
+        }
+
+        // Called by search() with the first token it will search.
+        // Returns the position of that token.
+        std::size_t begin(const iter_type& first_)
+        {
+            if (_started && first_ == _resume)
+                _floor = _resume_position;
+            else if (_started && first_ == _origin)
+                _floor = 0;
+            else
+            {
+                discard();
+                _origin = _resume = first_;
+                _resume_position = _floor = 0;
+                _started = true;
+            }
+
+            return _floor;
+        }
+
+        // Called by search() as its start position advances.
+        void start(const std::size_t position_)
+        {
+            _floor = position_;
+        }
+
+        // Called by search() with the token the next search would
+        // begin with.
+        void end(const std::size_t position_, const iter_type& first_)
+        {
+            _resume_position = position_;
+            _resume = first_;
+        }
+
+        const config* find(const std::size_t position_,
+            const std::vector<frame>& frames_, const std::size_t top_)
+        {
+            auto iter_ = _heads.find(position_);
+
+            if (iter_ != _heads.end())
+            {
+                for (std::size_t idx_ = iter_->second;
+                    idx_ != static_cast<std::size_t>(~0);
+                    idx_ = _configs[idx_]._next)
+                {
+                    const config& config_ = _configs[idx_];
+
+                    if (matches(config_, frames_, top_))
+                    {
+                        ++_hits;
+                        return &config_;
+                    }
+                }
+            }
+
+            ++_misses;
+            return nullptr;
+        }
+
+        const id_type* eoi_stack(const config& config_) const
+        {
+            return _states.data() + config_._eoi_first;
+        }
+
+        // position_ is that of the token at point_._index.
+        // eoi_stack_ is the full stack at the last point end of input
+        // was valid, or nullptr if there was none from point_ onwards.
+        void insert(const std::size_t position_,
+            const details::search_point& point_,
+            const std::vector<frame>& frames_,
+            const std::vector<id_type>* eoi_stack_,
+            const std::size_t eoi_index_, const entry& eoi_entry_)
+        {
+            if (memory() > _budget)
+            {
+                evict(_floor, cutoff());
+                ++_evictions;
+            }
+
+            config config_;
+            const std::size_t length_ = point_._height - point_._low + 1;
+
+            config_._position = position_;
+            config_._first = _states.size();
+            config_._length = length_;
+
+            for (std::size_t idx_ = 0, top_ = point_._top; idx_ < length_;
+                ++idx_, top_ = frames_[top_]._parent)
+            {
+                _states.push_back(frames_[top_]._state);
+            }
+
+            if (eoi_stack_)
+            {
+                config_._eoi = true;
+                config_._eoi_offset = eoi_index_ - point_._index;
+                config_._eoi_entry = eoi_entry_;
+                config_._eoi_first = _states.size();
+                config_._eoi_length = eoi_stack_->size() - point_._low + 1;
+                _states.insert(_states.end(), eoi_stack_->begin() +
+                    (point_._low - 1), eoi_stack_->end());
+            }
+
+            link(config_);
+        }
+
+    private:
+        std::size_t _budget;
+        std::vector<config> _configs;
+        std::vector<id_type> _states;
+        // Token position to first config (chained through _next)
+        std::unordered_map<std::size_t, std::size_t> _heads;
+        bool _started = false;
+        // First token searched after reset() (position 0)
+        iter_type _origin = iter_type();
+        // Where the last search() ended
+        iter_type _resume = iter_type();
+        std::size_t _resume_position = 0;
+        // Start position of the current search
+        std::size_t _floor = 0;
+        std::size_t _hits = 0;
+        std::size_t _misses = 0;
+        std::size_t _evictions = 0;
+
+        void discard()
+        {
+            _configs.clear();
+            _states.clear();
+            _heads.clear();
+        }
+
+        // Appends config_ to _configs, chaining it to any others at the
+        // same position.
+        void link(config& config_)
+        {
+            auto pair_ = _heads.insert(std::make_pair(config_._position,
+                _configs.size()));
+
+            if (!pair_.second)
+            {
+                config_._next = pair_.first->second;
+                pair_.first->second = _configs.size();
+            }
+
+            _configs.push_back(config_);
+        }
+
+        // The first position after the nearest one from _floor on at
+        // which the configs up to and including it use more than half
+        // the budget.
+        std::size_t cutoff() const
+        {
+            std::vector<std::pair<std::size_t, std::size_t>> bytes_;
+            std::size_t total_ = 0;
+
+            for (const auto& pair_ : _heads)
+            {
+                if (pair_.first < _floor)
+                    continue;
+
+                std::size_t size_ = sizeof(std::size_t) * 4;
+
+                for (std::size_t idx_ = pair_.second;
+                    idx_ != static_cast<std::size_t>(~0);
+                    idx_ = _configs[idx_]._next)
+                {
+                    const config& config_ = _configs[idx_];
+
+                    size_ += sizeof(config) + (config_._length +
+                        config_._eoi_length) * sizeof(id_type);
+                }
+
+                bytes_.emplace_back(pair_.first, size_);
+            }
+
+            std::sort(bytes_.begin(), bytes_.end());
+
+            for (const auto& pair_ : bytes_)
+            {
+                total_ += pair_.second;
+
+                if (total_ > _budget / 2 && pair_.first != bytes_[0].first)
+                    return pair_.first;
+            }
+
+            return static_cast<std::size_t>(~0);
+        }
+
+        // Removes the configs for positions outside [first_, last_),
+        // preserving the order of the rest.
+        void evict(const std::size_t first_, const std::size_t last_)
+        {
+            std::vector<config> configs_;
+            std::vector<id_type> states_;
+
+            configs_.swap(_configs);
+            states_.swap(_states);
+            _heads.clear();
+
+            for (config config_ : configs_)
+            {
+                if (config_._position < first_ || config_._position >= last_)
+                    continue;
+
+                const auto states_first_ = states_.begin() + config_._first;
+
+                config_._next = static_cast<std::size_t>(~0);
+                config_._first = _states.size();
+                _states.insert(_states.end(), states_first_,
+                    states_first_ + config_._length);
+
+                if (config_._eoi)
+                {
+                    const auto eoi_first_ =
+                        states_.begin() + config_._eoi_first;
+
+                    config_._eoi_first = _states.size();
+                    _states.insert(_states.end(), eoi_first_,
+                        eoi_first_ + config_._eoi_length);
+                }
+
+                link(config_);
+            }
+        }
+
+        bool matches(const config& config_, const std::vector<frame>& frames_,
+            std::size_t top_) const
+        {
+            const id_type* state_ = _states.data() + config_._first;
+
+            for (std::size_t idx_ = 0; idx_ < config_._length;
+                ++idx_, top_ = frames_[top_]._parent)
+            {
+                if (top_ == static_cast<std::size_t>(~0) ||
+                    frames_[top_]._state != state_[idx_])
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    };
+
+    using ssearch_memo = basic_search_memo<std::string::const_iterator>;
+    using csearch_memo = basic_search_memo<const char*>;
+    using wssearch_memo = basic_search_memo<std::wstring::const_iterator>;
+    using wcsearch_memo = basic_search_memo<const wchar_t*>;
+
+    // Equivalent of search() without productions, but using memo_ to
+    // abandon start positions that would repeat a failed parse.
+    template<typename lexer_iterator, typename sm_type>
+    bool search(lexer_iterator& iter_, lexer_iterator& end_, const sm_type& sm_,
+        basic_search_memo<typename lexer_iterator::value_type::iter_type,
+        typename sm_type::id_type>& memo_)
+    {
+        using id_type = typename sm_type::id_type;
+        using entry = typename sm_type::entry;
+        using buffered_iterator = details::buffered_iterator<lexer_iterator>;
+        using frame = details::search_frame<id_type>;
+        const auto npos_ = static_cast<std::size_t>(~0);
+        bool hit_ = false;
+        details::token_cache<lexer_iterator> cache_(iter_);
+        buffered_iterator start_(cache_, 0);
+        // Defined here so that allocated memory can be reused.
+        std::vector<frame> frames_;
+        std::vector<details::search_point> points_;
+        std::vector<id_type> eoi_stack_;
+        basic_match_results<sm_type> verify_;
+
+        // Position of the token at index 0 of cache_
+        const std::size_t base_ = memo_.begin(iter_->first);
+
+        details::skip(start_, sm_);
+        cache_.trim(start_.index());
+        memo_.start(base_ + start_.index());
+        end_ = lexer_iterator();
+
+        while (start_.base() != end_)
+        {
+            buffered_iterator curr_ = start_;
+            std::size_t top_ = 0;
+            std::size_t height_ = 1;
+            std::size_t last_eoi_ = npos_;
+            // The stack at last_eoi_ is the eoi_height_ frames from
+            // eoi_top_ down, topped by eoi_length_ states from a
+            // remembered failure. It is only built if needed, once the
+            // attempt is over, as frames_ is never overwritten.
+            std::size_t eoi_top_ = npos_;
+            std::size_t eoi_height_ = 0;
+            const id_type* eoi_states_ = nullptr;
+            std::size_t eoi_length_ = 0;
+            entry eoi_entry_;
+            // Lowest stack height read by a remembered failure
+            std::size_t low_ = npos_;
+            entry entry_;
+
+            frames_.assign(1, frame(0, npos_));
+            points_.clear();
+
+            if (curr_->id == lexer_iterator::value_type::npos())
+            {
+                entry_.action = action::error;
+                entry_.param = static_cast<id_type>(error_type::unknown_token);
+            }
+            else
+                entry_ = sm_.at(0, curr_->id);
+
+            while (entry_.action != action::accept &&
+                entry_.action != action::error)
+            {
+                switch (entry_.action)
+                {
+                case action::shift:
+                {
+                    const auto eoi_ = sm_.at(entry_.param);
+
+                    frames_.emplace_back(entry_.param, top_);
+                    top_ = frames_.size() - 1;
+                    ++height_;
+
+                    if (curr_->id != 0)
+                        ++curr_;
+
+                    if (curr_->id == lexer_iterator::value_type::npos())
+                    {
+                        entry_.action = action::error;
+                        entry_.param =
+                            static_cast<id_type>(error_type::unknown_token);
+                    }
+                    else
+                        entry_ = sm_.at(entry_.param, curr_->id);
+
+                    if (eoi_.action != action::error)
+                    {
+                        last_eoi_ = curr_.index();
+                        eoi_top_ = top_;
+                        eoi_height_ = height_;
+                        eoi_length_ = 0;
+                        eoi_entry_ = eoi_;
+                    }
+
+                    if (const auto* config_ = memo_.find(base_ +
+                        curr_.index(), frames_, top_))
+                    {
+                        // The rest of this parse has been seen before
+                        low_ = height_ - config_->_length + 1;
+
+                        if (config_->_eoi)
+                        {
+                            last_eoi_ = curr_.index() + config_->_eoi_offset;
+                            // Our stack below the remembered part
+                            eoi_top_ = top_;
+
+                            for (std::size_t idx_ = 0;
+                                idx_ < config_->_length; ++idx_)
+                            {
+                                eoi_top_ = frames_[eoi_top_]._parent;
+                            }
+
+                            eoi_height_ = low_ - 1;
+                            eoi_states_ = memo_.eoi_stack(*config_);
+                            eoi_length_ = config_->_eoi_length;
+                            eoi_entry_ = config_->_eoi_entry;
+                        }
+
+                        entry_.action = action::error;
+                        break;
+                    }
+
+                    details::search_point point_;
+
+                    point_._index = curr_.index();
+                    point_._top = top_;
+                    point_._height = point_._low = height_;
+                    points_.push_back(point_);
+                    break;
+                }
+                case action::reduce:
+                {
+                    const auto& rule_ = sm_._rules[entry_.param];
+
+                    for (std::size_t idx_ = 0, size_ = rule_._rhs.size();
+                        idx_ < size_; ++idx_)
+                    {
+                        top_ = frames_[top_]._parent;
+                    }
+
+                    height_ -= rule_._rhs.size();
+
+                    if (!points_.empty() && height_ < points_.back()._low)
+                        points_.back()._low = height_;
+
+                    entry_ = sm_.at(frames_[top_]._state, rule_._lhs);
+                    break;
+                }
+                case action::go_to:
+                    frames_.emplace_back(entry_.param, top_);
+                    top_ = frames_.size() - 1;
+                    ++height_;
+                    entry_ = sm_.at(entry_.param, curr_->id);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            if (entry_.action == action::accept)
+            {
+                hit_ = true;
+                end_ = curr_.base();
+                memo_.end(base_ + curr_.index(), curr_->first);
+                break;
+            }
+
+            if (last_eoi_ != npos_)
+            {
+                lexer_iterator eoi_;
+
+                eoi_stack_.resize(eoi_height_);
+
+                for (std::size_t idx_ = eoi_height_, f_ = eoi_top_;
+                    idx_-- > 0; f_ = frames_[f_]._parent)
+                {
+                    eoi_stack_[idx_] = frames_[f_]._state;
+                }
+
+                eoi_stack_.insert(eoi_stack_.end(), eoi_states_,
+                    eoi_states_ + eoi_length_);
+                verify_.stack = eoi_stack_;
+                verify_.token_id = 0;
+                verify_.entry = eoi_entry_;
+                hit_ = details::parse(eoi_, sm_, verify_,
+                    static_cast<std::set<id_type>*>(nullptr));
+
+                if (hit_)
+                {
+                    end_ = cache_.get(last_eoi_);
+                    memo_.end(base_ + last_eoi_, end_->first);
+                    break;
+                }
+            }
+
+            // Remember why this start position failed
+            for (std::size_t idx_ = points_.size(); idx_-- > 0;)
+            {
+                auto& point_ = points_[idx_];
+
+                low_ = std::min(low_, point_._low);
+                point_._low = low_;
+                memo_.insert(base_ + point_._index, point_, frames_,
+                    last_eoi_ != npos_ && point_._index <= last_eoi_ ?
+                    &eoi_stack_ : nullptr, last_eoi_, eoi_entry_);
+            }
+
+            if (start_->id != 0)
+                ++start_;
+
+            details::skip(start_, sm_);
+            cache_.trim(start_.index());
+            memo_.start(base_ + start_.index());
+        }
+
+        iter_ = start_.base();
+        return hit_;
+    }
+}
+
+#endif
@@ -139,6 +139,9 @@ namespace parsertl
                 pair_._entry.param = static_cast<id_type>(num_);
             }
         }
+
+        // Not saved as it is derived from the table
+        build_prefilter(sm_);
     }
 }
 
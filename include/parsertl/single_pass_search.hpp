@@ -0,0 +1,342 @@
+// single_pass_search.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_SINGLE_PASS_SEARCH_HPP
+#define PARSERTL_SINGLE_PASS_SEARCH_HPP
+
+#include <algorithm>
+#include "match_results.hpp"
+#include "search.hpp"
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace parsertl
+{
+    namespace details
+    {
+        // One parse in progress, started at token _index.
+        template<typename lexer_iterator, typename sm_type>
+        struct search_config
+        {
+            using id_type = typename sm_type::id_type;
+            using entry = typename sm_type::entry;
+
+            std::size_t _index = 0;
+            lexer_iterator _start;
+            std::vector<id_type> _stack;
+            // Most recent point at which end of input would be accepted
+            bool _candidate = false;
+            stack_mark<std::vector<id_type>> _eoi_stack;
+            entry _eoi_entry;
+            lexer_iterator _eoi;
+            // The earliest hit of the later starts merged into this one.
+            // Their futures are the same as this one's, so it stands
+            // only if this start fails before a new candidate is found
+            // and without a candidate of its own that matches.
+            bool _merged = false;
+            std::size_t _merged_index = 0;
+            lexer_iterator _merged_start;
+            lexer_iterator _merged_end;
+        };
+
+        // Only the size and the states nearest the top are hashed, so that
+        // the cost does not grow with the depth of the stack. Stacks with
+        // equal hashes are compared in full.
+        template<typename id_type>
+        std::size_t hash_stack(const std::vector<id_type>& stack_)
+        {
+            const std::size_t depth_ = std::min<std::size_t>(stack_.size(), 4);
+            std::size_t hash_ = stack_.size();
+
+            for (auto iter_ = stack_.end() - depth_, end_ = stack_.end();
+                iter_ != end_; ++iter_)
+            {
+                hash_ *= 571;
+                hash_ += *iter_;
+            }
+
+            return hash_;
+        }
+
+        // Continues from the candidate with end of input, as search()
+        // does after an error. The stack of config_ is used up, so only
+        // call this once config_ is finished with.
+        template<typename lexer_iterator, typename sm_type>
+        bool verify_candidate(search_config<lexer_iterator, sm_type>& config_,
+            const sm_type& sm_, basic_match_results<sm_type>& results_)
+        {
+            lexer_iterator eoi_;
+
+            config_._eoi_stack.restore(config_._stack);
+            results_.stack.swap(config_._stack);
+            results_.token_id = 0;
+            results_.entry = config_._eoi_entry;
+            return parse(eoi_, sm_, results_,
+                static_cast<std::set<typename sm_type::id_type>*>(nullptr));
+        }
+    }
+
+    // Equivalent of search(), but instead of restarting the parse at each
+    // token after a failure, every candidate start is advanced together in
+    // a single left to right pass. Parses that reach an identical stack
+    // have identical futures, so only the earliest of them is kept.
+    // Run time is therefore proportional to the input length multiplied by
+    // the number of distinct stacks alive at once, rather than quadratic.
+    template<typename lexer_iterator, typename sm_type>
+    bool single_pass_search(lexer_iterator& iter_, lexer_iterator& end_,
+        const sm_type& sm_)
+    {
+        using id_type = typename sm_type::id_type;
+        using config = details::search_config<lexer_iterator, sm_type>;
+        std::vector<config> configs_;
+        std::vector<config> next_;
+        // Stack hash to index in next_
+        std::unordered_multimap<std::size_t, std::size_t> stacks_;
+        std::vector<std::vector<id_type>> spare_;
+        basic_match_results<sm_type> verify_;
+        bool hit_ = false;
+        std::size_t hit_index_ = 0;
+        lexer_iterator hit_start_;
+        lexer_iterator hit_end_;
+        lexer_iterator curr_ = iter_;
+        const lexer_iterator eoi_;
+
+        // Keep the earliest start that produces a match
+        auto resolve_ = [&](const std::size_t index_,
+            const lexer_iterator& start_, const lexer_iterator& last_)
+        {
+            if (!hit_ || index_ < hit_index_)
+            {
+                hit_ = true;
+                hit_index_ = index_;
+                hit_start_ = start_;
+                hit_end_ = last_;
+            }
+        };
+        // What search() finds for config_ and for the starts merged into
+        // it, when the parse fails at this point.
+        // Returns false if there is no match.
+        auto fail_ = [&](config& config_, std::size_t& index_,
+            lexer_iterator& start_, lexer_iterator& last_)
+        {
+            if (config_._candidate &&
+                details::verify_candidate(config_, sm_, verify_))
+            {
+                index_ = config_._index;
+                start_ = config_._start;
+                last_ = config_._eoi;
+                return true;
+            }
+            else if (config_._merged)
+            {
+                index_ = config_._merged_index;
+                start_ = config_._merged_start;
+                last_ = config_._merged_end;
+                return true;
+            }
+
+            return false;
+        };
+        auto recycle_ = [&](config& config_)
+        {
+            spare_.push_back(std::move(config_._stack));
+            spare_.back().clear();
+        };
+
+        for (std::size_t index_ = 0;; ++index_)
+        {
+            const auto id_ = curr_->id;
+            lexer_iterator next_iter_ = curr_;
+
+            if (id_ != 0)
+                ++next_iter_;
+
+            // Nothing starting here could beat an existing hit.
+            // As with search(), no match can start at end of input.
+            if (!hit_ && curr_ != eoi_ &&
+                id_ != lexer_iterator::value_type::npos())
+            {
+                configs_.emplace_back();
+
+                config& config_ = configs_.back();
+
+                config_._index = index_;
+                config_._start = curr_;
+
+                if (!spare_.empty())
+                {
+                    config_._stack.swap(spare_.back());
+                    spare_.pop_back();
+                }
+
+                config_._stack.push_back(0);
+            }
+
+            next_.clear();
+            stacks_.clear();
+
+            for (auto& config_ : configs_)
+            {
+                if (hit_ && config_._index > hit_index_)
+                {
+                    recycle_(config_);
+                    continue;
+                }
+
+                auto& stack_ = config_._stack;
+                auto entry_ = id_ == lexer_iterator::value_type::npos() ?
+                    typename sm_type::entry(action::error,
+                        static_cast<id_type>(error_type::unknown_token)) :
+                    sm_.at(stack_.back(), static_cast<id_type>(id_));
+                bool alive_ = false;
+
+                for (;;)
+                {
+                    if (entry_.action == action::shift)
+                    {
+                        stack_.push_back(entry_.param);
+
+                        // End of input is shifted and then remains the
+                        // lookahead (see lookup())
+                        if (id_ == 0)
+                        {
+                            entry_ = sm_.at(entry_.param, 0);
+                            continue;
+                        }
+
+                        const auto eoi_entry_ = sm_.at(entry_.param);
+
+                        // A new candidate replaces those of the starts
+                        // merged into this one too.
+                        if (eoi_entry_.action != action::error)
+                        {
+                            config_._candidate = true;
+                            config_._eoi_stack.mark(stack_);
+                            config_._eoi_entry = eoi_entry_;
+                            config_._eoi = next_iter_;
+                            config_._merged = false;
+                        }
+
+                        alive_ = true;
+                        break;
+                    }
+                    else if (entry_.action == action::reduce)
+                    {
+                        const auto& rule_ = sm_._rules[entry_.param];
+                        const std::size_t size_ =
+                            stack_.size() - rule_._rhs.size();
+
+                        config_._eoi_stack.pop(stack_, size_);
+                        stack_.resize(size_);
+                        entry_ = sm_.at(stack_.back(), rule_._lhs);
+
+                        if (entry_.action != action::go_to)
+                            continue;
+
+                        stack_.push_back(entry_.param);
+                        entry_ = sm_.at(stack_.back(),
+                            static_cast<id_type>(id_));
+                    }
+                    else if (entry_.action == action::accept)
+                    {
+                        // Any merged starts would end here too
+                        resolve_(config_._index, config_._start, curr_);
+                        break;
+                    }
+                    else
+                    {
+                        // action::error
+                        std::size_t match_index_ = 0;
+                        lexer_iterator match_start_;
+                        lexer_iterator match_end_;
+
+                        if (fail_(config_, match_index_, match_start_,
+                            match_end_))
+                            resolve_(match_index_, match_start_, match_end_);
+
+                        break;
+                    }
+                }
+
+                if (!alive_)
+                {
+                    recycle_(config_);
+                    continue;
+                }
+
+                // configs_ is ordered by start, so any identical stack
+                // already in next_ belongs to an earlier start.
+                const std::size_t hash_ = details::hash_stack(stack_);
+                const auto range_ = stacks_.equal_range(hash_);
+                const auto dup_ = std::find_if(range_.first, range_.second,
+                    [&](const std::pair<const std::size_t, std::size_t>& pair_)
+                    {
+                        return next_[pair_.second]._stack == stack_;
+                    });
+
+                if (dup_ == range_.second)
+                {
+                    stacks_.emplace(hash_, next_.size());
+                    next_.push_back(std::move(config_));
+                }
+                else
+                {
+                    // From here on this start does whatever the earlier
+                    // one does. If that is to fail before finding another
+                    // candidate, this start falls back on the hit (if
+                    // any) that it would have had failing now. Whether a
+                    // candidate matches does not depend on later input,
+                    // so it is decided here and the stack is not kept.
+                    config& survivor_ = next_[dup_->second];
+                    std::size_t match_index_ = 0;
+                    lexer_iterator match_start_;
+                    lexer_iterator match_end_;
+
+                    if (fail_(config_, match_index_, match_start_,
+                        match_end_) &&
+                        (!survivor_._merged ||
+                            match_index_ < survivor_._merged_index))
+                    {
+                        survivor_._merged = true;
+                        survivor_._merged_index = match_index_;
+                        survivor_._merged_start = match_start_;
+                        survivor_._merged_end = match_end_;
+                    }
+
+                    recycle_(config_);
+                }
+            }
+
+            configs_.swap(next_);
+
+            if (hit_ && (configs_.empty() ||
+                configs_.front()._index > hit_index_))
+            {
+                break;
+            }
+
+            if (id_ == 0)
+                break;
+
+            curr_ = next_iter_;
+        }
+
+        if (hit_)
+        {
+            iter_ = hit_start_;
+            end_ = hit_end_;
+        }
+        else
+        {
+            iter_ = curr_;
+            end_ = lexer_iterator();
+        }
+
+        return hit_;
+    }
+}
+
+#endif
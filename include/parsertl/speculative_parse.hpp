@@ -0,0 +1,398 @@
+// speculative_parse.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_SPECULATIVE_PARSE_HPP
+#define PARSERTL_SPECULATIVE_PARSE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include "lookup.hpp"
+#include "match_results.hpp"
+#include "parallel_match.hpp"
+#include <vector>
+
+namespace parsertl
+{
+    namespace details
+    {
+        // Presents a vector of lexer results as a lexer_iterator.
+        // The last entry must be the end of input (or an unknown token).
+        template<typename lexer_iterator>
+        class token_vector_iterator
+        {
+        public:
+            using value_type = typename lexer_iterator::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type*;
+            using reference = const value_type&;
+            using iterator_category = std::forward_iterator_tag;
+            using vector = std::vector<value_type>;
+
+            token_vector_iterator() = default;
+
+            token_vector_iterator(const vector& tokens_,
+                const std::size_t index_) :
+                _tokens(&tokens_),
+                _index(index_)
+            {
+            }
+
+            token_vector_iterator& operator ++()
+            {
+                if (_index + 1 < _tokens->size())
+                    ++_index;
+
+                return *this;
+            }
+
+            token_vector_iterator operator ++(int)
+            {
+                token_vector_iterator iter_ = *this;
+
+                ++*this;
+                return iter_;
+            }
+
+            const value_type& operator *() const
+            {
+                return (*_tokens)[_index];
+            }
+
+            const value_type* operator ->() const
+            {
+                return &(*_tokens)[_index];
+            }
+
+            bool operator ==(const token_vector_iterator& rhs_) const
+            {
+                return _tokens == rhs_._tokens && _index == rhs_._index;
+            }
+
+            bool operator !=(const token_vector_iterator& rhs_) const
+            {
+                return !(*this == rhs_);
+            }
+
+            std::size_t index() const
+            {
+                return _index;
+            }
+
+        private:
+            const vector* _tokens = nullptr;
+            std::size_t _index = 0;
+        };
+
+        template<typename id_type>
+        std::vector<char> sync_flags(const std::vector<id_type>& sync_tokens_,
+            const std::size_t columns_)
+        {
+            std::vector<char> flags_(columns_, 0);
+
+            for (const auto id_ : sync_tokens_)
+            {
+                if (id_ < columns_)
+                    flags_[id_] = 1;
+            }
+
+            return flags_;
+        }
+
+        // Run the parser over tokens [index_, end_) starting with the
+        // stack already in results_. Stops once the last token of the
+        // range has been shifted, before any reductions triggered by
+        // the token that follows.
+        template<typename lexer_iterator, typename sm_type>
+        bool parse_range(const std::vector<typename lexer_iterator::
+            value_type>& tokens_, const std::size_t index_,
+            const std::size_t end_, const sm_type& sm_,
+            basic_match_results<sm_type>& results_)
+        {
+            token_vector_iterator<lexer_iterator> iter_(tokens_, index_);
+
+            results_.token_id = static_cast<typename sm_type::id_type>
+                (iter_->id);
+            results_.entry = iter_->id == lexer_iterator::value_type::npos() ?
+                typename sm_type::entry(action::error,
+                    static_cast<typename sm_type::id_type>
+                    (error_type::unknown_token)) :
+                sm_.at(results_.stack.back(), results_.token_id);
+
+            while (iter_.index() < end_ &&
+                results_.entry.action != action::error &&
+                results_.entry.action != action::accept)
+            {
+                lookup(iter_, sm_, results_);
+            }
+
+            return results_.entry.action != action::error;
+        }
+    }
+
+    // Parse a sample input and record the (distinct) parser stacks seen
+    // straight after each sync token is shifted.
+    // The result is suitable for passing to speculative_parse().
+    template<typename lexer_iterator, typename sm_type>
+    bool collect_sync_stacks(lexer_iterator iter_, const sm_type& sm_,
+        const std::vector<typename sm_type::id_type>& sync_tokens_,
+        std::vector<std::vector<typename sm_type::id_type>>& stacks_)
+    {
+        const std::vector<char> flags_ =
+            details::sync_flags(sync_tokens_, sm_._columns);
+        basic_match_results<sm_type> results_(iter_->id, sm_);
+
+        while (results_.entry.action != action::error &&
+            results_.entry.action != action::accept)
+        {
+            const bool sync_ = results_.entry.action == action::shift &&
+                iter_->id < flags_.size() && flags_[iter_->id];
+
+            lookup(iter_, sm_, results_);
+
+            if (sync_ && std::find(stacks_.begin(), stacks_.end(),
+                results_.stack) == stacks_.end())
+            {
+                stacks_.push_back(results_.stack);
+            }
+        }
+
+        return results_.entry.action == action::accept;
+    }
+
+    // Equivalent of parse(), but splits the input into chunks that are
+    // lexed and parsed concurrently on a pool of at most threads_ threads
+    // (see details::parallel_for()).
+    // Each chunk is located from an even split of the characters: its
+    // worker lexes from the split point up to the first sync token (e.g.
+    // a statement terminator) and the chunk starts straight after it.
+    // The chunk then runs up to and including the first sync token that
+    // starts at or after the next split point, which is where the
+    // following chunk should start if both lexed the same tokens.
+    // Every chunk but the first is parsed once for each of start_stacks_
+    // (see collect_sync_stacks()). The chunks are then stitched together
+    // in order: where a chunk starts exactly where the real parse has got
+    // to and the real stack is one of those that was tried, the
+    // speculative result is used. Otherwise the input is lexed and parsed
+    // sequentially until, straight after a sync token, the real position
+    // matches the start of a later chunk.
+    // The lexer must be in its initial state (and not depend on the
+    // preceding text) after every sync token.
+    // input_iterator should be random access, as the split points are
+    // found with std::next().
+    template<typename lexer_iterator, typename input_iterator,
+        typename lsm_type, typename sm_type>
+    bool speculative_parse(const input_iterator first_,
+        const input_iterator last_, const lsm_type& lsm_, const sm_type& sm_,
+        basic_match_results<sm_type>& results_,
+        const std::vector<typename sm_type::id_type>& sync_tokens_,
+        const std::vector<std::vector<typename sm_type::id_type>>&
+        start_stacks_, const std::size_t threads_ = 0,
+        std::size_t* reparsed_ = nullptr)
+    {
+        using id_type = typename sm_type::id_type;
+        using stack = std::vector<id_type>;
+        using value_type = typename lexer_iterator::value_type;
+
+        struct speculation
+        {
+            bool _success = false;
+            stack _stack;
+            typename sm_type::entry _entry;
+        };
+
+        struct chunk
+        {
+            // false if no sync token was found after the split point
+            bool _valid = false;
+            input_iterator _start;
+            input_iterator _end;
+            std::vector<speculation> _speculations;
+        };
+
+        struct state
+        {
+            std::vector<value_type> _tokens;
+            basic_match_results<sm_type> _results;
+        };
+
+        const std::vector<char> flags_ =
+            details::sync_flags(sync_tokens_, sm_._columns);
+        const auto is_sync_ = [&flags_](const value_type& token_)
+        {
+            return token_.id < flags_.size() && flags_[token_.id];
+        };
+        const std::size_t size_ =
+            static_cast<std::size_t>(std::distance(first_, last_));
+        const std::size_t chunks_ = details::thread_count(threads_,
+            size_ ? size_ : 1);
+        std::vector<chunk> chunk_vec_(chunks_);
+        const stack initial_(1, 0);
+
+        details::parallel_for<state>(chunks_, threads_,
+            [&](state& state_, const std::size_t index_)
+            {
+                chunk& chunk_ = chunk_vec_[index_];
+                const input_iterator split_ = index_ + 1 < chunks_ ?
+                    std::next(first_, size_ * (index_ + 1) / chunks_) :
+                    last_;
+
+                chunk_._start = first_;
+
+                if (index_ > 0)
+                {
+                    lexer_iterator iter_(std::next(first_,
+                        size_ * index_ / chunks_), last_, lsm_);
+
+                    while (iter_->id != 0 && !is_sync_(*iter_))
+                    {
+                        ++iter_;
+                    }
+
+                    if (iter_->id == 0)
+                        return;
+
+                    chunk_._start = iter_->second;
+                }
+
+                lexer_iterator iter_(chunk_._start, last_, lsm_);
+
+                chunk_._valid = true;
+                chunk_._end = chunk_._start;
+                state_._tokens.clear();
+
+                // The token following the chunk is kept as the lookahead
+                for (; iter_->id != 0 && iter_->id != value_type::npos();
+                    ++iter_)
+                {
+                    const bool end_ = is_sync_(*iter_) &&
+                        index_ + 1 < chunks_ && iter_->first >= split_;
+
+                    state_._tokens.push_back(*iter_);
+                    chunk_._end = iter_->second;
+
+                    if (end_)
+                    {
+                        ++iter_;
+                        break;
+                    }
+                }
+
+                state_._tokens.push_back(*iter_);
+
+                const std::vector<stack> first_stack_(1, initial_);
+                const std::vector<stack>& candidates_ = index_ == 0 ?
+                    first_stack_ : start_stacks_;
+
+                chunk_._speculations.resize(candidates_.size());
+
+                for (std::size_t idx_ = 0, stacks_ = candidates_.size();
+                    idx_ < stacks_; ++idx_)
+                {
+                    speculation& spec_ = chunk_._speculations[idx_];
+
+                    state_._results.stack = candidates_[idx_];
+                    spec_._success = details::parse_range<lexer_iterator>
+                        (state_._tokens, 0, state_._tokens.size() - 1, sm_,
+                        state_._results);
+                    spec_._stack.swap(state_._results.stack);
+                    spec_._entry = state_._results.entry;
+                }
+            });
+
+        // The speculation for chunk index_ that starts at pos_ with the
+        // current stack, if any
+        const auto speculation_ = [&](const std::size_t index_,
+            const input_iterator& pos_) -> const speculation*
+        {
+            const chunk& chunk_ = chunk_vec_[index_];
+
+            if (!chunk_._valid || chunk_._start != pos_)
+                return nullptr;
+
+            if (index_ == 0)
+                return results_.stack == initial_ ?
+                    &chunk_._speculations[0] : nullptr;
+
+            for (std::size_t idx_ = 0, stacks_ = start_stacks_.size();
+                idx_ < stacks_; ++idx_)
+            {
+                if (start_stacks_[idx_] == results_.stack)
+                    return &chunk_._speculations[idx_];
+            }
+
+            return nullptr;
+        };
+        // Kept up to date as chunks are used so that every return sees it
+        std::size_t ignored_ = 0;
+        std::size_t& unused_ = reparsed_ ? *reparsed_ : ignored_;
+        std::size_t index_ = 0;
+        input_iterator pos_ = first_;
+
+        unused_ = chunks_;
+        results_.clear();
+
+        for (;;)
+        {
+            for (; index_ < chunks_; ++index_)
+            {
+                const speculation* spec_ = speculation_(index_, pos_);
+
+                if (!spec_)
+                    break;
+
+                results_.stack = spec_->_stack;
+                --unused_;
+
+                // Same start and stack, so a failure is a real failure
+                if (!spec_->_success)
+                {
+                    results_.entry = spec_->_entry;
+                    return false;
+                }
+
+                pos_ = chunk_vec_[index_]._end;
+            }
+
+            lexer_iterator iter_(pos_, last_, lsm_);
+            bool resume_ = false;
+
+            results_.token_id = static_cast<id_type>(iter_->id);
+            results_.entry = iter_->id == value_type::npos() ?
+                typename sm_type::entry(action::error,
+                    static_cast<id_type>(error_type::unknown_token)) :
+                sm_.at(results_.stack.back(), results_.token_id);
+
+            while (!resume_ && results_.entry.action != action::error &&
+                results_.entry.action != action::accept)
+            {
+                const bool sync_ = results_.entry.action == action::shift &&
+                    is_sync_(*iter_);
+                const input_iterator end_ = iter_->second;
+
+                lookup(iter_, sm_, results_);
+
+                for (std::size_t idx_ = index_; sync_ && idx_ < chunks_;
+                    ++idx_)
+                {
+                    if (speculation_(idx_, end_))
+                    {
+                        index_ = idx_;
+                        pos_ = end_;
+                        resume_ = true;
+                        break;
+                    }
+                }
+            }
+
+            if (!resume_)
+                break;
+        }
+
+        return results_.entry.action == action::accept;
+    }
+}
+
+#endif
@@ -31,10 +31,52 @@ namespace parsertl
 
         using rules = std::vector<id_type_vector_pair>;
 
+        // Which tokens can begin a match, used by search() to skip
+        // start positions without running the parser.
+        // See build_prefilter().
+        struct prefilter
+        {
+            // Row in _second for each token that can start a match,
+            // otherwise npos.
+            id_type_vector _first;
+            // Per row, non-zero for each token that may follow.
+            // Column 0 is set if a match may end after the first token.
+            std::vector<unsigned char> _second;
+            std::size_t _columns = 0;
+
+            void clear() noexcept
+            {
+                _first.clear();
+                _second.clear();
+                _columns = 0;
+            }
+
+            bool empty() const
+            {
+                return _first.empty();
+            }
+
+            bool viable(const std::size_t first_,
+                const std::size_t second_) const
+            {
+                if (first_ >= _first.size() ||
+                    _first[first_] == static_cast<id_type>(~0))
+                {
+                    return false;
+                }
+
+                const unsigned char* row_ =
+                    &_second[_first[first_] * _columns];
+
+                return row_[0] || (second_ < _columns && row_[second_]);
+            }
+        };
+
         std::size_t _columns = 0;
         std::size_t _rows = 0;
         rules _rules;
         captures_vector _captures;
+        prefilter _prefilter;
 
         // If you get a compile error here you have
         // failed to define an unsigned id type.
@@ -83,6 +125,7 @@ namespace parsertl
             _columns = _rows = 0;
             _rules.clear();
             _captures.clear();
+            _prefilter.clear();
         }
     };
 
@@ -229,6 +272,94 @@ namespace parsertl
         }
     };
 
+    namespace details
+    {
+        // Performs any reductions and then shifts token_id_.
+        // Returns false if token_id_ is a syntax error.
+        template<typename sm_type>
+        bool prefilter_step(const sm_type& sm_,
+            std::vector<typename sm_type::id_type>& stack_,
+            const std::size_t token_id_)
+        {
+            auto entry_ = sm_.at(stack_.back(), token_id_);
+
+            for (;;)
+            {
+                switch (entry_.action)
+                {
+                case action::shift:
+                    stack_.push_back(entry_.param);
+                    return true;
+                case action::accept:
+                    return true;
+                case action::reduce:
+                {
+                    const auto& rule_ = sm_._rules[entry_.param];
+
+                    // Cannot happen for a valid table, but err on the
+                    // side of keeping the token.
+                    if (rule_._rhs.size() >= stack_.size())
+                        return true;
+
+                    stack_.resize(stack_.size() - rule_._rhs.size());
+                    entry_ = sm_.at(stack_.back(), rule_._lhs);
+
+                    if (entry_.action != action::go_to)
+                        return false;
+
+                    stack_.push_back(entry_.param);
+                    entry_ = sm_.at(stack_.back(), token_id_);
+                    break;
+                }
+                default:
+                    return false;
+                }
+            }
+        }
+    }
+
+    // Fills in sm_._prefilter from the table: the tokens with a
+    // non-error action in state 0 and, for each of those, the tokens
+    // that can follow it. Called by generator::build() and load().
+    template<typename sm_type>
+    void build_prefilter(sm_type& sm_)
+    {
+        using id_type = typename sm_type::id_type;
+        auto& prefilter_ = sm_._prefilter;
+        std::vector<id_type> first_;
+        std::vector<id_type> second_;
+
+        prefilter_.clear();
+
+        if (sm_.empty())
+            return;
+
+        prefilter_._columns = sm_._columns;
+        prefilter_._first.assign(sm_._columns, static_cast<id_type>(~0));
+
+        // A match never starts at end of input
+        for (std::size_t id_ = 1; id_ < sm_._columns; ++id_)
+        {
+            first_.assign(1, 0);
+
+            if (!details::prefilter_step(sm_, first_, id_))
+                continue;
+
+            const std::size_t row_ = prefilter_._second.size();
+
+            prefilter_._first[id_] =
+                static_cast<id_type>(row_ / sm_._columns);
+            prefilter_._second.resize(row_ + sm_._columns, 0);
+
+            for (std::size_t next_ = 0; next_ < sm_._columns; ++next_)
+            {
+                second_ = first_;
+                prefilter_._second[row_ + next_] =
+                    details::prefilter_step(sm_, second_, next_);
+            }
+        }
+    }
+
     using state_machine = basic_state_machine<uint16_t>;
     using uncompressed_state_machine =
         basic_uncompressed_state_machine<uint16_t>;
@@ -0,0 +1,215 @@
+// stream_search.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_STREAM_SEARCH_HPP
+#define PARSERTL_STREAM_SEARCH_HPP
+
+#include "capture.hpp"
+#include "flat.hpp"
+#include "scan_iterator.hpp"
+#include "search.hpp"
+#include "token.hpp"
+#include <vector>
+
+namespace parsertl
+{
+    // Searches input that arrives in pieces (e.g. a log file being
+    // tailed), reporting the same matches as a search_iterator over the
+    // whole input. A match is reported as soon as more input could not
+    // change it. The tokens and the parse in progress at the earliest
+    // start position that is still undecided are kept between pushes,
+    // so each push only lexes the new text and the token it extends.
+    // Text before that position is discarded once it is at least half of
+    // the buffer, so memory is bounded by the longest partial match
+    // rather than by the size of the input.
+    // A token is undecided while lexing it (from the end of the token
+    // before, so including any skipped text) reads to the end of the
+    // buffer, and so is everything after it. Rules "ab" and "abcd" lex
+    // "abc" as "ab" then "c", but "abcd" once the 'd' arrives. To find
+    // out how far the lexer reads, the tokens are lexed a second time
+    // through a details::scan_iterator.
+    // lexer_iterator must iterate over const char_type*
+    // (e.g. lexertl::citerator) and take the form of lexertl::iterator.
+    // As lexing restarts at token boundaries, the lexer must not have
+    // start states or use bol.
+    template<typename lexer_iterator, typename lsm_type, typename sm_type>
+    class basic_stream_search
+    {
+    public:
+        using iter_type = typename lexer_iterator::value_type::iter_type;
+        using char_type = typename lexer_iterator::value_type::char_type;
+        using results = std::vector<std::vector<capture<iter_type>>>;
+
+        basic_stream_search(const lsm_type& lsm_, const sm_type& sm_) :
+            _lsm(&lsm_),
+            _sm(&sm_),
+            _cache(lexer_iterator())
+        {
+        }
+
+        // Appends [first_, last_) and calls func_(captures_) for each
+        // match that is now final. The captures only remain valid for
+        // the duration of the call (see position()).
+        template<typename functor>
+        void push(const char_type* first_, const char_type* last_,
+            functor func_)
+        {
+            const char_type* data_ = _buffer.data();
+
+            _buffer.insert(_buffer.end(), first_, last_);
+
+            // Cached tokens point into the old buffer
+            if (_buffer.data() != data_)
+                _restart = true;
+
+            process(false, func_);
+        }
+
+        // Signals end of input, reporting any remaining matches.
+        template<typename functor>
+        void finish(functor func_)
+        {
+            process(true, func_);
+        }
+
+        // Offset of iter_ (which must be within a match just reported)
+        // from the start of the input.
+        std::size_t position(const iter_type& iter_) const
+        {
+            return _offset + static_cast<std::size_t>(iter_ - _buffer.data());
+        }
+
+        // Characters currently held awaiting more input
+        std::size_t buffered() const
+        {
+            return _buffer.size() - _undecided;
+        }
+
+        void clear()
+        {
+            _buffer.clear();
+            _offset = 0;
+            _undecided = 0;
+            _restart = true;
+        }
+
+    private:
+        // Qualify token to prevent arg dependant lookup
+        using token_vector =
+            typename parsertl::token<lexer_iterator>::token_vector;
+        using scan_iter = details::scan_iterator<iter_type>;
+        using scan_lexer =
+            typename details::rebind_lexer<lexer_iterator, scan_iter>::type;
+
+        const lsm_type* _lsm = nullptr;
+        const sm_type* _sm = nullptr;
+        std::vector<char_type> _buffer;
+        // Offset of _buffer[0] from the start of the input
+        std::size_t _offset = 0;
+        // Offset within _buffer of the earliest undecided start position
+        std::size_t _undecided = 0;
+        // Set when the tokens and search state no longer match _buffer
+        bool _restart = true;
+        // Tokens from the earliest undecided start position (_start) on
+        details::token_cache<lexer_iterator> _cache;
+        std::size_t _start = 0;
+        details::search_state<sm_type, token_vector> _state;
+        basic_flat_productions<typename sm_type::id_type, token_vector>
+            _productions;
+        results _captures;
+
+        template<typename functor>
+        void process(const bool final_, functor& func_)
+        {
+            using buffered_iterator =
+                details::buffered_iterator<lexer_iterator>;
+            const iter_type first_ = _buffer.data();
+            const iter_type last_ = first_ + _buffer.size();
+            // Where lexing resumes
+            std::size_t index_ = _start;
+            iter_type relex_ = first_ + _undecided;
+
+            if (_restart)
+            {
+                _cache = details::token_cache<lexer_iterator>
+                    (lexer_iterator(relex_, last_, *_lsm));
+                _start = index_ = 0;
+                _state._pending = false;
+                _restart = false;
+            }
+            else
+            {
+                // Tokens before the first that was not final are unchanged
+                if (_state._pending)
+                    index_ = _state._curr;
+
+                if (index_ > _start)
+                    relex_ = _cache.get(index_ - 1)->second;
+
+                _cache.relex(index_, lexer_iterator(relex_, last_, *_lsm));
+            }
+
+            buffered_iterator start_(_cache, _start);
+            buffered_iterator end_;
+            // Everything the scan lexer has read so far
+            iter_type furthest_ = relex_;
+            // Lexes the same tokens as _cache from relex_ on. Tokens
+            // before the one at scan_ are final. Once open_ is set, that
+            // token and all that follow could still change.
+            scan_lexer scan_ = final_ ? scan_lexer() :
+                scan_lexer(scan_iter(relex_, &furthest_),
+                    scan_iter(last_, &furthest_), *_lsm);
+            bool open_ = false;
+            // True if appending input could change token_.
+            // The search passes each token here before the one following
+            // it, so tokens are decided in order.
+            auto pending_ = [&](const lexer_iterator& token_)
+            {
+                if (final_)
+                    return false;
+
+                while (!open_ && !(token_->first < scan_->first.base()))
+                {
+                    // A token that read to last_ would be the first to do
+                    // so, as none of those before did.
+                    open_ = furthest_ == last_;
+
+                    if (!open_)
+                        ++scan_;
+                }
+
+                return open_ && !(token_->first < scan_->first.base());
+            };
+
+            // The productions of each hit are recorded as the search
+            // goes, so the captures come from a single parse.
+            while (details::search_productions(_cache, start_, end_, *_sm,
+                &_productions, _state, pending_))
+            {
+                details::assign_captures(*_sm, _productions, start_->first,
+                    _captures);
+                func_(static_cast<const results&>(_captures));
+                start_ = end_;
+            }
+
+            _start = start_.index();
+            _undecided = final_ ? _buffer.size() :
+                static_cast<std::size_t>(start_->first - first_);
+
+            // Discarding text moves the rest, so the undecided text is
+            // lexed again. Waiting until the discarded text is at least as
+            // long keeps the total work linear.
+            if (_undecided * 2 >= _buffer.size())
+            {
+                _buffer.erase(_buffer.begin(), _buffer.begin() + _undecided);
+                _offset += _undecided;
+                _undecided = 0;
+                _restart = true;
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,151 @@
+// value_stack.hpp
+// Copyright (c) 2023 Ben Hanson (http://www.benhanson.net/)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file licence_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#ifndef PARSERTL_VALUE_STACK_HPP
+#define PARSERTL_VALUE_STACK_HPP
+
+#include "lookup.hpp"
+#include "match_results.hpp"
+#include <utility>
+#include <vector>
+
+namespace parsertl
+{
+    // Semantic values kept in step with the parser stack by the parse()
+    // overload below. Values are only ever moved and the underlying
+    // vector keeps its capacity, so a parse allocates only while the
+    // stack is growing beyond its previous maximum depth.
+    // value_type only has to be movable: a tagged union of the value
+    // kinds, or a small handle into an arena owned by the handler, keeps
+    // the values adjacent and cheap to move.
+    template<typename value_type>
+    class basic_value_stack
+    {
+    public:
+        using vector = std::vector<value_type>;
+
+        bool empty() const
+        {
+            return _values.empty();
+        }
+
+        std::size_t size() const
+        {
+            return _values.size();
+        }
+
+        void clear()
+        {
+            _values.clear();
+            _rhs = 0;
+        }
+
+        void reserve(const std::size_t size_)
+        {
+            _values.reserve(size_);
+        }
+
+        value_type& back()
+        {
+            return _values.back();
+        }
+
+        const value_type& back() const
+        {
+            return _values.back();
+        }
+
+        // Values of the rhs of the rule being reduced ($1 is index 0).
+        // Only valid within a reduce handler.
+        value_type& dollar(const std::size_t index_)
+        {
+            return _values[_rhs + index_];
+        }
+
+        const value_type& dollar(const std::size_t index_) const
+        {
+            return _values[_rhs + index_];
+        }
+
+        std::size_t rhs_size() const
+        {
+            return _values.size() - _rhs;
+        }
+
+        void push(value_type&& value_)
+        {
+            _values.push_back(std::move(value_));
+        }
+
+        // Marks the top size_ values as the rhs of the next reduce.
+        void rhs(const std::size_t size_)
+        {
+            _rhs = _values.size() - size_;
+        }
+
+        // Replace the rhs values with value_, reusing the slot of $1.
+        void reduce(value_type&& value_)
+        {
+            if (_rhs == _values.size())
+                _values.push_back(std::move(value_));
+            else
+            {
+                _values[_rhs] = std::move(value_);
+                _values.erase(_values.begin() + _rhs + 1, _values.end());
+            }
+        }
+
+        const vector& values() const
+        {
+            return _values;
+        }
+
+    private:
+        vector _values;
+        std::size_t _rhs = 0;
+    };
+
+    // Parse entire sequence maintaining values_ alongside the parser stack.
+    // handler_ must provide:
+    //   value_type shift(const typename lexer_iterator::value_type&)
+    //   value_type reduce(std::size_t rule_id_,
+    //       basic_value_stack<value_type>& values_)
+    // The reduce handler accesses its rhs through values_.dollar() and
+    // may move from it. End of input does not get a value, so on success
+    // values_.back() holds the value of the start rule.
+    template<typename lexer_iterator, typename sm_type, typename value_type,
+        typename handler>
+    bool parse(lexer_iterator& iter_, const sm_type& sm_,
+        basic_match_results<sm_type>& results_,
+        basic_value_stack<value_type>& values_, handler& handler_)
+    {
+        while (results_.entry.action != action::error &&
+            results_.entry.action != action::accept)
+        {
+            switch (results_.entry.action)
+            {
+            case action::shift:
+                if (iter_->id != 0)
+                    values_.push(handler_.shift(*iter_));
+
+                break;
+            case action::reduce:
+                values_.rhs(sm_._rules[results_.entry.param]._rhs.size());
+                values_.reduce(handler_.reduce(results_.entry.param,
+                    values_));
+                break;
+            default:
+                // action::go_to
+                break;
+            }
+
+            lookup(iter_, sm_, results_);
+        }
+
+        return results_.entry.action == action::accept;
+    }
+}
+
+#endif
@@ -0,0 +1,279 @@
+#include "../../include/parsertl/actions.hpp"
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+using token = parsertl::token<lexertl::citerator>;
+using token_vector = token::token_vector;
+using results = parsertl::match_results;
+
+// Rule ids, checked against the ids returned by rules::push()
+enum rule_id { add_rule, sub_rule, mul_rule, paren_rule, int_rule };
+
+struct context
+{
+    const parsertl::state_machine* _sm = nullptr;
+    std::vector<long long> _values;
+    // Rules whose action was called
+    std::vector<std::size_t> _log;
+
+    void binary(const std::size_t rule_)
+    {
+        const long long rhs_ = _values.back();
+
+        _values.pop_back();
+
+        long long& lhs_ = _values.back();
+
+        switch (rule_)
+        {
+        case add_rule:
+            lhs_ += rhs_;
+            break;
+        case sub_rule:
+            lhs_ -= rhs_;
+            break;
+        default:
+            lhs_ *= rhs_;
+            break;
+        }
+
+        _log.push_back(rule_);
+    }
+
+    void integer(const results& results_, const token_vector& productions_)
+    {
+        _values.push_back(std::stoll(results_.dollar(0, *_sm,
+            productions_).str()));
+        _log.push_back(int_rule);
+    }
+};
+
+template<std::size_t rule_>
+struct binary_action
+{
+    void operator ()(context& context_, const results&, token_vector&) const
+    {
+        context_.binary(rule_);
+    }
+};
+
+struct int_action
+{
+    void operator ()(context& context_, const results& results_,
+        token_vector& productions_) const
+    {
+        context_.integer(results_, productions_);
+    }
+};
+
+// No action is registered for paren_rule
+using static_table = parsertl::static_actions<parsertl::state_machine,
+    token_vector, context,
+    parsertl::rule_action<add_rule, binary_action<add_rule>>,
+    parsertl::rule_action<sub_rule, binary_action<sub_rule>>,
+    parsertl::rule_action<mul_rule, binary_action<mul_rule>>,
+    parsertl::rule_action<int_rule, int_action>>;
+
+// The hand written equivalent: a switch on reduce_id()
+bool switch_parse(lexertl::citerator iter_,
+    const parsertl::state_machine& gsm_, context& context_)
+{
+    results results_(iter_->id, gsm_);
+    token_vector productions_;
+
+    while (results_.entry.action != parsertl::action::error &&
+        results_.entry.action != parsertl::action::accept)
+    {
+        if (results_.entry.action == parsertl::action::reduce)
+        {
+            switch (results_.reduce_id())
+            {
+            case add_rule:
+            case sub_rule:
+            case mul_rule:
+                context_.binary(results_.reduce_id());
+                break;
+            case int_rule:
+                context_.integer(results_, productions_);
+                break;
+            default:
+                break;
+            }
+        }
+
+        parsertl::lookup(iter_, gsm_, results_, productions_);
+    }
+
+    return results_.entry.action == parsertl::action::accept;
+}
+
+template<typename actions>
+bool actions_parse(lexertl::citerator iter_,
+    const parsertl::state_machine& gsm_, const actions& actions_,
+    context& context_)
+{
+    results results_(iter_->id, gsm_);
+    token_vector productions_;
+
+    return parsertl::parse(iter_, gsm_, results_, productions_, actions_,
+        context_);
+}
+
+// Checks that the switch, basic_rule_actions and static_actions give
+// the same result, values and sequence of actions.
+bool same_results(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    const parsertl::basic_rule_actions<parsertl::state_machine, token_vector,
+    context>& rule_actions_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    context expected_;
+    context rule_context_;
+    context static_context_;
+
+    expected_._sm = rule_context_._sm = static_context_._sm = &gsm_;
+
+    const bool success_ = switch_parse(lexertl::citerator(first_, last_,
+        lsm_), gsm_, expected_);
+
+    if (actions_parse(lexertl::citerator(first_, last_, lsm_), gsm_,
+        rule_actions_, rule_context_) != success_ ||
+        actions_parse(lexertl::citerator(first_, last_, lsm_), gsm_,
+            static_table(), static_context_) != success_ ||
+        rule_context_._values != expected_._values ||
+        rule_context_._log != expected_._log ||
+        static_context_._values != expected_._values ||
+        static_context_._log != expected_._log)
+    {
+        std::cout << "Different result for \"" << text_ << "\"\n";
+        return false;
+    }
+
+    return true;
+}
+
+// Appends a random expression of roughly size_ tokens.
+void expression(std::string& str_, std::size_t size_, std::mt19937& gen_)
+{
+    if (size_ < 2 || gen_() % 8 == 0)
+    {
+        str_ += std::to_string(gen_() % 100);
+        return;
+    }
+
+    static const char ops_[] = "+-*";
+    const std::size_t lhs_ = gen_() % size_;
+    const bool bracket_ = gen_() % 4 == 0;
+
+    if (bracket_)
+        str_ += '(';
+
+    expression(str_, lhs_, gen_);
+    str_ += ' ';
+    str_ += ops_[gen_() % 3];
+    str_ += ' ';
+    expression(str_, size_ - lhs_ - 1, gen_);
+
+    if (bracket_)
+        str_ += ')';
+}
+
+int main()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    std::mt19937 gen_(0);
+    int failures_ = 0;
+
+    grules_.token("INTEGER");
+    grules_.left("'+' '-'");
+    grules_.left("'*'");
+
+    if (grules_.push("expr", "expr '+' expr") != add_rule ||
+        grules_.push("expr", "expr '-' expr") != sub_rule ||
+        grules_.push("expr", "expr '*' expr") != mul_rule ||
+        grules_.push("expr", "'(' expr ')'") != paren_rule ||
+        grules_.push("expr", "INTEGER") != int_rule)
+    {
+        std::cout << "Unexpected rule ids\n";
+        return 1;
+    }
+
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("[0-9]+", grules_.token_id("INTEGER"));
+    lrules_.push("[+]", grules_.token_id("'+'"));
+    lrules_.push("-", grules_.token_id("'-'"));
+    lrules_.push("[*]", grules_.token_id("'*'"));
+    lrules_.push("[(]", grules_.token_id("'('"));
+    lrules_.push("[)]", grules_.token_id("')'"));
+    lrules_.push("\\s+", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    parsertl::basic_rule_actions<parsertl::state_machine, token_vector,
+        context> rule_actions_(gsm_);
+
+    rule_actions_.assign(add_rule, [](context& context_, const results&,
+        token_vector&)
+        {
+            context_.binary(add_rule);
+        });
+    rule_actions_.assign(sub_rule, [](context& context_, const results&,
+        token_vector&)
+        {
+            context_.binary(sub_rule);
+        });
+    rule_actions_.assign(mul_rule, [](context& context_, const results&,
+        token_vector&)
+        {
+            context_.binary(mul_rule);
+        });
+    rule_actions_.assign(int_rule, [](context& context_,
+        const results& results_, token_vector& productions_)
+        {
+            context_.integer(results_, productions_);
+        });
+
+    for (std::size_t run_ = 0; run_ < 500; ++run_)
+    {
+        std::string text_;
+
+        expression(text_, gen_() % 40, gen_);
+
+        // Break a quarter of the inputs part way through
+        if (run_ % 4 == 0)
+            text_[gen_() % text_.size()] = "()+*"[gen_() % 4];
+
+        if (!same_results(text_, lsm_, gsm_, rule_actions_))
+        {
+            std::cout << "random_inputs failed\n";
+            ++failures_;
+            break;
+        }
+    }
+
+    {
+        context context_;
+
+        context_._sm = &gsm_;
+
+        const std::string text_ = "(1 + 2) * 3 - 4 * 5";
+
+        if (!actions_parse(lexertl::citerator(text_.c_str(),
+            text_.c_str() + text_.size(), lsm_), gsm_, static_table(),
+            context_) || context_._values != std::vector<long long>(1, -11))
+        {
+            std::cout << "known_value failed\n";
+            ++failures_;
+        }
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include "../../include/parsertl/ast.hpp"
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+using ast = parsertl::basic_flat_ast<parsertl::state_machine,
+    lexertl::citerator>;
+using token = parsertl::token<lexertl::citerator>;
+
+// Rule id and span for each reduction made by lookup()
+struct reduction
+{
+    std::size_t _rule = 0;
+    const char* _first = nullptr;
+    const char* _second = nullptr;
+};
+
+bool expected(const char* first_, const char* last_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    std::vector<reduction>& log_, token::token_vector& tokens_)
+{
+    lexertl::citerator iter_(first_, last_, lsm_);
+    parsertl::match_results results_(iter_->id, gsm_);
+    token::token_vector productions_;
+
+    while (results_.entry.action != parsertl::action::error &&
+        results_.entry.action != parsertl::action::accept)
+    {
+        if (results_.entry.action == parsertl::action::shift &&
+            iter_->id != 0)
+        {
+            tokens_.emplace_back(iter_->id, iter_->first, iter_->second);
+        }
+        else if (results_.entry.action == parsertl::action::reduce)
+        {
+            const std::size_t size_ =
+                gsm_._rules[results_.entry.param]._rhs.size();
+            reduction reduction_;
+
+            reduction_._rule = results_.entry.param;
+
+            if (size_)
+            {
+                reduction_._first =
+                    productions_[productions_.size() - size_].first;
+                reduction_._second = productions_.back().second;
+            }
+
+            log_.push_back(reduction_);
+        }
+
+        parsertl::lookup(iter_, gsm_, results_, productions_);
+    }
+
+    return results_.entry.action == parsertl::action::accept;
+}
+
+// Checks the tree against the reductions and tokens seen by lookup():
+// rule nodes are numbered in reduction order with the same spans, every
+// rule node has one child per rhs symbol with matching ids, and on
+// success a walk from the root visits the tokens in input order with
+// each child one deeper than its parent.
+bool same_as_lookup(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    ast& ast_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    std::vector<reduction> log_;
+    token::token_vector tokens_;
+    const bool success_ = expected(first_, last_, lsm_, gsm_, log_, tokens_);
+    lexertl::citerator iter_(first_, last_, lsm_);
+    parsertl::match_results results_(iter_->id, gsm_);
+
+    if (ast_.parse(iter_, gsm_, results_) != success_)
+        return false;
+
+    std::size_t reduction_ = 0;
+
+    for (ast::index_type node_ = 0; node_ < ast_.size(); ++node_)
+    {
+        if (ast_.is_leaf(node_))
+        {
+            if (ast_.first_child(node_) != ast::npos())
+                return false;
+
+            continue;
+        }
+
+        if (reduction_ == log_.size())
+            return false;
+
+        const reduction& expected_ = log_[reduction_++];
+        const auto& rule_ = gsm_._rules[ast_.rule(node_)];
+
+        if (ast_.rule(node_) != expected_._rule || ast_.id(node_) !=
+            rule_._lhs || ast_.child_count(node_) != rule_._rhs.size() ||
+            (expected_._first && (ast_.first(node_) != expected_._first ||
+                ast_.second(node_) != expected_._second)))
+        {
+            return false;
+        }
+
+        std::size_t idx_ = 0;
+
+        for (ast::index_type child_ = ast_.first_child(node_);
+            child_ != ast::npos(); child_ = ast_.next_sibling(child_), ++idx_)
+        {
+            if (child_ >= node_ || ast_.id(child_) != rule_._rhs[idx_])
+                return false;
+        }
+    }
+
+    if (reduction_ != log_.size())
+        return false;
+
+    if (!success_)
+        return true;
+
+    if (ast_.root() != ast_.size() - 1)
+        return false;
+
+    std::vector<std::size_t> depth_(ast_.size(), 0);
+    std::size_t leaf_ = 0;
+    bool ok_ = true;
+
+    ast_.visit(ast_.root(), [&](const ast::index_type node_,
+        const std::size_t level_)
+        {
+            if (level_ != depth_[node_])
+                ok_ = false;
+
+            for (ast::index_type child_ = ast_.first_child(node_);
+                child_ != ast::npos(); child_ = ast_.next_sibling(child_))
+            {
+                depth_[child_] = level_ + 1;
+            }
+
+            if (ast_.is_leaf(node_))
+            {
+                if (leaf_ == tokens_.size() ||
+                    ast_.id(node_) != tokens_[leaf_].id ||
+                    ast_.first(node_) != tokens_[leaf_].first ||
+                    ast_.second(node_) != tokens_[leaf_].second)
+                {
+                    ok_ = false;
+                }
+
+                ++leaf_;
+            }
+        });
+    return ok_ && leaf_ == tokens_.size();
+}
+
+int main()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const char alphabet_[] = "aaabbcc  x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 100);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    ast ast_;
+    int failures_ = 0;
+
+    grules_.token("A B C");
+    grules_.push("list", "%empty | list item");
+    grules_.push("item", "A | B list C");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("A"));
+    lrules_.push("b", grules_.token_id("B"));
+    lrules_.push("c", grules_.token_id("C"));
+    lrules_.push(" +", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (std::size_t run_ = 0; run_ < 1000; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        // Half the inputs without unknown characters
+        if (run_ % 2)
+            text_.erase(std::remove(text_.begin(), text_.end(), 'x'),
+                text_.end());
+
+        // The same tree object is reused for every input
+        if (!same_as_lookup(text_, lsm_, gsm_, ast_))
+        {
+            std::cout << "random_inputs failed for \"" << text_ << "\"\n";
+            ++failures_;
+            break;
+        }
+    }
+
+    // visit() does not recurse, so a very deep tree is fine
+    if (!same_as_lookup(std::string(20000, 'b') + std::string(20000, 'c'),
+        lsm_, gsm_, ast_))
+    {
+        std::cout << "deep failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,337 @@
+#include "../../include/parsertl/checkpoint.hpp"
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/lookup.hpp"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using checkpoints =
+    parsertl::basic_checkpoints<parsertl::state_machine, lexertl::citerator>;
+using token = parsertl::token<lexertl::citerator>;
+// action, param, production count and the last production as offsets
+using step = std::vector<std::size_t>;
+
+// Runs the parser to completion (or for limit_ steps), logging each step
+// with iterators as offsets from base_ so that logs taken over different
+// copies of the input compare equal.
+bool run(lexertl::citerator& iter_, const parsertl::state_machine& gsm_,
+    parsertl::match_results& results_, token::token_vector& productions_,
+    const char* base_, std::vector<step>& log_,
+    std::size_t limit_ = static_cast<std::size_t>(~0))
+{
+    for (; limit_ > 0 && results_.entry.action != parsertl::action::error &&
+        results_.entry.action != parsertl::action::accept; --limit_)
+    {
+        step step_;
+
+        step_.push_back(static_cast<std::size_t>(results_.entry.action));
+        step_.push_back(results_.entry.param);
+        step_.push_back(productions_.size());
+
+        if (!productions_.empty())
+        {
+            step_.push_back(productions_.back().id);
+            step_.push_back(productions_.back().first - base_);
+            step_.push_back(productions_.back().second - base_);
+        }
+
+        log_.push_back(step_);
+        parsertl::lookup(iter_, gsm_, results_, productions_);
+    }
+
+    return results_.entry.action == parsertl::action::accept;
+}
+
+// Saving a checkpoint after every step, loading it over a copy of the
+// input and resuming there gives the same steps and result as parsing
+// without interruption.
+bool round_trip(const std::string& text_, const lexertl::state_machine& lsm_,
+    const parsertl::state_machine& gsm_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    const std::string copy_ = text_;
+    const char* copy_first_ = copy_.c_str();
+    const char* copy_last_ = copy_first_ + copy_.size();
+    std::vector<step> expected_;
+    bool success_ = false;
+
+    {
+        lexertl::citerator iter_(first_, last_, lsm_);
+        parsertl::match_results results_(iter_->id, gsm_);
+        token::token_vector productions_;
+
+        success_ = run(iter_, gsm_, results_, productions_, first_,
+            expected_);
+    }
+
+    for (std::size_t split_ = 0; split_ <= expected_.size(); ++split_)
+    {
+        lexertl::citerator iter_(first_, last_, lsm_);
+        parsertl::match_results results_(iter_->id, gsm_);
+        token::token_vector productions_;
+        std::vector<step> log_;
+        checkpoints saved_;
+        checkpoints loaded_;
+        std::stringstream ss_;
+
+        run(iter_, gsm_, results_, productions_, first_, log_, split_);
+        saved_.save(saved_.push(results_, productions_, iter_), first_,
+            ss_);
+
+        const std::size_t index_ = loaded_.load(ss_, copy_first_);
+        parsertl::match_results resumed_;
+        token::token_vector resumed_productions_;
+        lexertl::citerator resumed_iter_ =
+            loaded_.lexer_iter(index_, copy_last_, lsm_);
+
+        loaded_.restore(index_, resumed_, resumed_productions_);
+
+        if (run(resumed_iter_, gsm_, resumed_, resumed_productions_,
+            copy_first_, log_) != success_ || log_ != expected_)
+        {
+            std::cout << "Resuming \"" << text_ << "\" after " << split_ <<
+                " steps differs\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool throws(const std::string& stream_, const char* base_)
+{
+    checkpoints checkpoints_;
+    std::stringstream ss_(stream_);
+
+    try
+    {
+        checkpoints_.load(ss_, base_);
+    }
+    catch (const parsertl::runtime_error&)
+    {
+        return checkpoints_.empty();
+    }
+
+    return false;
+}
+
+// Streams that are cut short, come from another version or id_type size,
+// or hold impossible values are rejected.
+bool rejects_bad_streams(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    const char* first_ = text_.c_str();
+    lexertl::citerator iter_(first_, first_ + text_.size(), lsm_);
+    parsertl::match_results results_(iter_->id, gsm_);
+    token::token_vector productions_;
+    std::vector<step> log_;
+    checkpoints checkpoints_;
+    std::stringstream ss_;
+
+    run(iter_, gsm_, results_, productions_, first_, log_, 12);
+    checkpoints_.save(checkpoints_.push(results_, productions_, iter_),
+        first_, ss_);
+
+    const std::string good_ = ss_.str();
+
+    if (throws(good_, first_))
+        return false;
+
+    // Every truncation at a number boundary
+    const std::size_t end_ = good_.find_last_not_of(" \n");
+
+    for (std::size_t size_ = 0; size_ <= end_; ++size_)
+    {
+        if ((size_ == 0 || good_[size_ - 1] == ' ' ||
+            good_[size_ - 1] == '\n') && !throws(good_.substr(0, size_),
+                first_))
+        {
+            std::cout << "Truncated to " << size_ << " accepted\n";
+            return false;
+        }
+    }
+
+    // Line by line: version, sizeof(id_type), token/action/param,
+    // position, stack size, stack, production count, productions
+    std::vector<std::string> lines_;
+    std::stringstream lines_ss_(good_);
+
+    for (std::string line_; std::getline(lines_ss_, line_);)
+    {
+        lines_.push_back(line_);
+    }
+
+    const auto replace_ = [&lines_](const std::size_t line_,
+        const std::string& with_)
+    {
+        std::vector<std::string> copy_ = lines_;
+        std::string stream_;
+
+        copy_[line_] = with_;
+
+        for (const std::string& str_ : copy_)
+        {
+            stream_ += str_ + '\n';
+        }
+
+        return stream_;
+    };
+    const std::string bad_[] =
+    {
+        replace_(0, "2"),
+        replace_(1, std::to_string(sizeof(parsertl::state_machine::id_type) +
+            1)),
+        replace_(2, "0 99 0"),
+        replace_(4, "0"),
+        replace_(6, std::to_string(productions_.size() + 5)),
+        replace_(7, "x 0 0"),
+        replace_(5, lines_[5] + "y")
+    };
+
+    for (const std::string& stream_ : bad_)
+    {
+        if (!throws(stream_, first_))
+        {
+            std::cout << "Accepted corrupt stream:\n" << stream_;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Frames are freed once no checkpoint refers to them, so keeping only
+// the latest checkpoint bounds memory by the stack depth, and releasing
+// everything frees every frame.
+bool reclaims_frames(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    const char* first_ = text_.c_str();
+    lexertl::citerator iter_(first_, first_ + text_.size(), lsm_);
+    parsertl::match_results results_(iter_->id, gsm_);
+    token::token_vector productions_;
+    checkpoints checkpoints_;
+    std::vector<std::size_t> kept_;
+    std::size_t last_ = static_cast<std::size_t>(~0);
+    std::size_t max_depth_ = 0;
+    std::size_t steps_ = 0;
+
+    while (results_.entry.action != parsertl::action::error &&
+        results_.entry.action != parsertl::action::accept)
+    {
+        const std::size_t index_ =
+            checkpoints_.push(results_, productions_, iter_);
+
+        // The index of a released checkpoint is reused
+        if (last_ != static_cast<std::size_t>(~0))
+        {
+            checkpoints_.release(last_);
+
+            if (checkpoints_.push(results_, productions_, iter_) != last_)
+                return false;
+
+            checkpoints_.release(index_);
+        }
+        else
+            last_ = index_;
+
+        // Keep every tenth checkpoint
+        if (++steps_ % 10 == 0)
+            kept_.push_back(checkpoints_.push(results_, productions_, iter_));
+
+        max_depth_ = std::max(max_depth_, results_.stack.size());
+
+        if (checkpoints_.size() != kept_.size() + 1 ||
+            checkpoints_.frames() > max_depth_ * (kept_.size() + 1))
+        {
+            std::cout << checkpoints_.frames() << " frames held for " <<
+                checkpoints_.size() << " checkpoints\n";
+            return false;
+        }
+
+        parsertl::lookup(iter_, gsm_, results_, productions_);
+    }
+
+    // A kept checkpoint still restores the stack it was taken with
+    if (!kept_.empty())
+    {
+        parsertl::match_results restored_;
+        token::token_vector restored_productions_;
+
+        checkpoints_.restore(kept_.front(), restored_,
+            restored_productions_);
+
+        if (restored_.stack.empty() || restored_.stack.front() != 0 ||
+            restored_productions_.size() + 1 < restored_.stack.size())
+        {
+            return false;
+        }
+    }
+
+    for (const std::size_t index_ : kept_)
+    {
+        checkpoints_.release(index_);
+    }
+
+    checkpoints_.release(last_);
+    return checkpoints_.empty() && checkpoints_.frames() == 0 && steps_ > 0;
+}
+
+int main()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const std::string inputs_[] =
+    {
+        "1 + 2 * (3 - 4) * ((5)) - 6",
+        "((((1 + 2) * 3) - 4) * 5)",
+        "1 + * 2",
+        "(1 + 2",
+        "1 + 2 ? 3"
+    };
+    int failures_ = 0;
+
+    grules_.token("INTEGER");
+    grules_.left("'+' '-'");
+    grules_.left("'*'");
+    grules_.push("expr", "expr '+' expr | expr '-' expr | expr '*' expr | "
+        "'(' expr ')' | INTEGER");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("[0-9]+", grules_.token_id("INTEGER"));
+    lrules_.push("[+]", grules_.token_id("'+'"));
+    lrules_.push("-", grules_.token_id("'-'"));
+    lrules_.push("[*]", grules_.token_id("'*'"));
+    lrules_.push("[(]", grules_.token_id("'('"));
+    lrules_.push("[)]", grules_.token_id("')'"));
+    lrules_.push("\\s+", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (const std::string& input_ : inputs_)
+    {
+        if (!round_trip(input_, lsm_, gsm_))
+        {
+            std::cout << "round_trip failed\n";
+            ++failures_;
+        }
+
+        if (!reclaims_frames(input_, lsm_, gsm_))
+        {
+            std::cout << "reclaims_frames failed\n";
+            ++failures_;
+        }
+    }
+
+    if (!rejects_bad_streams(inputs_[0], lsm_, gsm_))
+    {
+        std::cout << "rejects_bad_streams failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,219 @@
+#include <algorithm>
+#include "../../include/parsertl/capture.hpp"
+#include "../../include/parsertl/columns.hpp"
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/match.hpp"
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using columns = parsertl::basic_columns<parsertl::state_machine,
+    lexertl::citerator>;
+using length_columns = parsertl::basic_columns<parsertl::state_machine,
+    lexertl::citerator, std::size_t>;
+using captures = std::vector<std::vector<parsertl::capture<const char*>>>;
+
+// Appends lines_ random records of three fields.
+std::string records(const std::size_t lines_, std::mt19937& gen_)
+{
+    static const char alphabet_[] = "abcxyz0123456789";
+    std::string text_;
+
+    for (std::size_t line_ = 0; line_ < lines_; ++line_)
+    {
+        for (std::size_t field_ = 0; field_ < 3; ++field_)
+        {
+            const std::size_t size_ = 1 + gen_() % 8;
+
+            if (field_)
+                text_ += ',';
+
+            for (std::size_t idx_ = 0; idx_ < size_; ++idx_)
+            {
+                text_ += alphabet_[gen_() % (sizeof(alphabet_) - 1)];
+            }
+        }
+
+        text_ += '\n';
+    }
+
+    return text_;
+}
+
+// Bound captures fill their columns with the same spans that match()
+// returns for them, the bound rule gets one whole record per line, and
+// a converter's results are stored in place of the spans.
+bool same_as_captures(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    const std::size_t record_rule_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    captures expected_;
+    columns columns_;
+    length_columns lengths_;
+    const bool success_ = parsertl::match(lexertl::citerator(first_, last_,
+        lsm_), gsm_, expected_);
+
+    // Bound in reverse to show that column numbers follow bind order
+    for (std::size_t capture_ = 3; capture_ > 0; --capture_)
+    {
+        if (columns_.bind_capture(gsm_, capture_) != 3 - capture_ ||
+            lengths_.bind_capture(gsm_, capture_) != 3 - capture_)
+        {
+            return false;
+        }
+    }
+
+    if (columns_.bind_rule(gsm_, record_rule_) != 3)
+        return false;
+
+    // Parsing twice appends, clear() empties but keeps the bindings
+    for (int pass_ = 0; pass_ < 2; ++pass_)
+    {
+        columns_.clear();
+        lengths_.clear();
+
+        if (columns_.parse(lexertl::citerator(first_, last_, lsm_), gsm_) !=
+            success_ || lengths_.parse(lexertl::citerator(first_, last_,
+                lsm_), gsm_, [](const char* lhs_, const char* rhs_)
+                {
+                    return static_cast<std::size_t>(rhs_ - lhs_);
+                }) != success_ || columns_.columns() != 4 ||
+            lengths_.columns() != 3)
+        {
+            return false;
+        }
+    }
+
+    if (!success_)
+        return true;
+
+    for (std::size_t capture_ = 1; capture_ <= 3; ++capture_)
+    {
+        const columns::column& column_ = columns_[3 - capture_];
+        const length_columns::column& lengths_column_ =
+            lengths_[3 - capture_];
+        const auto& spans_ = expected_[capture_];
+
+        if (column_.size() != spans_.size() ||
+            lengths_column_.size() != spans_.size())
+        {
+            return false;
+        }
+
+        for (std::size_t idx_ = 0, size_ = spans_.size(); idx_ < size_;
+            ++idx_)
+        {
+            if (column_[idx_].first != spans_[idx_].first ||
+                column_[idx_].second != spans_[idx_].second ||
+                lengths_column_[idx_] !=
+                static_cast<std::size_t>(spans_[idx_].second -
+                    spans_[idx_].first))
+            {
+                return false;
+            }
+        }
+    }
+
+    const columns::column& records_ = columns_[3];
+    const char* line_ = first_;
+
+    for (const auto& span_ : records_)
+    {
+        const char* end_ = std::find(line_, last_, '\n') + 1;
+
+        if (span_.first != line_ || span_.second != end_)
+            return false;
+
+        line_ = end_;
+    }
+
+    return line_ == last_;
+}
+
+// Unknown captures and invalid rules are rejected.
+bool rejects_bad_bindings(const parsertl::state_machine& gsm_)
+{
+    columns columns_;
+    int thrown_ = 0;
+
+    try
+    {
+        columns_.bind_capture(gsm_, 0);
+    }
+    catch (const parsertl::runtime_error&)
+    {
+        ++thrown_;
+    }
+
+    try
+    {
+        columns_.bind_capture(gsm_, 4);
+    }
+    catch (const parsertl::runtime_error&)
+    {
+        ++thrown_;
+    }
+
+    try
+    {
+        columns_.bind_rule(gsm_, gsm_._rules.size());
+    }
+    catch (const parsertl::runtime_error&)
+    {
+        ++thrown_;
+    }
+
+    return thrown_ == 3 && columns_.columns() == 0;
+}
+
+int main()
+{
+    parsertl::rules grules_(*parsertl::rule_flags::enable_captures);
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    std::mt19937 gen_(0);
+    int failures_ = 0;
+
+    grules_.token("FIELD NL");
+    grules_.push("records", "record | records record");
+
+    const std::size_t record_rule_ =
+        grules_.push("record", "(FIELD) ',' (FIELD) ',' (FIELD) NL");
+
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("[a-z0-9]+", grules_.token_id("FIELD"));
+    lrules_.push(",", grules_.token_id("','"));
+    lrules_.push("\n", grules_.token_id("NL"));
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (std::size_t run_ = 0; run_ < 200; ++run_)
+    {
+        std::string text_ = records(1 + gen_() % 50, gen_);
+
+        // Break a quarter of the inputs
+        if (run_ % 4 == 0)
+            text_[gen_() % text_.size()] = ",\n"[gen_() % 2];
+
+        if (!same_as_captures(text_, lsm_, gsm_, record_rule_))
+        {
+            std::cout << "random_inputs failed for \"" << text_ << "\"\n";
+            ++failures_;
+            break;
+        }
+    }
+
+    if (!rejects_bad_bindings(gsm_))
+    {
+        std::cout << "rejects_bad_bindings failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include "../../include/parsertl/capture.hpp"
+#include "../../include/parsertl/compact_token.hpp"
+#include <cstdint>
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <iterator>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/lookup.hpp"
+#include "../../include/parsertl/match.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+using token = parsertl::token<lexertl::citerator>;
+using compact_vector = parsertl::compact_token_vector<lexertl::citerator>;
+using captures = std::vector<std::vector<parsertl::capture<const char*>>>;
+
+// Offsets beyond any real allocation, using integers as iterators.
+struct offset_results
+{
+    using iter_type = std::int64_t;
+    using char_type = char;
+};
+
+struct offset_iterator
+{
+    using value_type = offset_results;
+};
+
+bool same(const token& lhs_, const token& rhs_)
+{
+    return lhs_.id == rhs_.id && lhs_.first == rhs_.first &&
+        lhs_.second == rhs_.second;
+}
+
+// Offsets up to 0xffffffff survive the round trip, anything larger
+// or negative is rejected, and npos ids map to and from ~uint32_t.
+// Any other id that does not fit below ~uint32_t is rejected.
+bool round_trip()
+{
+    using compact = parsertl::compact_token<offset_iterator>;
+    const std::int64_t base_ = 1000;
+    const std::int64_t max_ = 0xffffffffLL;
+    const std::int64_t pairs_[][2] =
+    {
+        { 0, 0 },
+        { 0, max_ },
+        { max_ - 10, max_ },
+        { max_, max_ },
+        { 12345, 67890 }
+    };
+    const std::int64_t bad_[][2] =
+    {
+        { max_ + 1, max_ + 1 },
+        { 0, max_ + 1 },
+        { -1, 0 },
+        { 10, 5 }
+    };
+
+    for (const auto& pair_ : pairs_)
+    {
+        const compact compact_(7, base_, base_ + pair_[0], base_ + pair_[1]);
+        const auto token_ = compact_.to_token(base_);
+
+        if (token_.id != 7 || token_.first != base_ + pair_[0] ||
+            token_.second != base_ + pair_[1])
+        {
+            std::cout << "Offsets " << pair_[0] << ", " << pair_[1] <<
+                " did not round trip\n";
+            return false;
+        }
+    }
+
+    for (const auto& pair_ : bad_)
+    {
+        try
+        {
+            compact(7, base_, base_ + pair_[0], base_ + pair_[1]);
+            std::cout << "Offsets " << pair_[0] << ", " << pair_[1] <<
+                " accepted\n";
+            return false;
+        }
+        catch (const parsertl::runtime_error&)
+        {
+        }
+    }
+
+    std::vector<std::size_t> bad_ids_(1, 0xffffffff);
+
+    if (sizeof(std::size_t) > 4)
+    {
+        bad_ids_.push_back(static_cast<std::size_t>(0x100000000ULL));
+        bad_ids_.push_back(static_cast<std::size_t>(~0) - 1);
+    }
+
+    for (const std::size_t id_ : bad_ids_)
+    {
+        try
+        {
+            compact(id_, base_, base_, base_);
+            std::cout << "Id " << id_ << " accepted\n";
+            return false;
+        }
+        catch (const parsertl::runtime_error&)
+        {
+        }
+    }
+
+    const compact npos_(static_cast<std::size_t>(~0), base_, base_, base_);
+    const compact max_id_(0xfffffffe, base_, base_, base_);
+
+    return sizeof(compact) == 12 &&
+        npos_.id == static_cast<std::uint32_t>(~0) &&
+        npos_.to_token(base_).id == static_cast<std::size_t>(~0) &&
+        compact().to_token(base_).id == static_cast<std::size_t>(~0) &&
+        max_id_.to_token(base_).id == 0xfffffffe;
+}
+
+// The proxy iterator walks the same tokens as the normal vector.
+bool same_tokens(const token::token_vector& expected_,
+    const compact_vector& compact_)
+{
+    if (compact_.size() != expected_.size() ||
+        std::distance(compact_.begin(), compact_.end()) !=
+        static_cast<std::ptrdiff_t>(expected_.size()))
+    {
+        return false;
+    }
+
+    std::size_t index_ = 0;
+
+    for (auto iter_ = compact_.begin(), end_ = compact_.end();
+        iter_ != end_; ++iter_, ++index_)
+    {
+        const token& expected_token_ = expected_[index_];
+
+        if (iter_->id != expected_token_.id ||
+            iter_->first != expected_token_.first ||
+            iter_->second != expected_token_.second ||
+            !same(*iter_, expected_token_) ||
+            !same(compact_[index_], expected_token_) ||
+            !same(*(compact_.begin() + index_), expected_token_) ||
+            !same(*(compact_.end() - (expected_.size() - index_)),
+                expected_token_))
+        {
+            return false;
+        }
+    }
+
+    if (!expected_.empty())
+    {
+        auto last_ = compact_.end();
+
+        --last_;
+
+        if (!same(compact_.front(), expected_.front()) ||
+            !same(compact_.back(), expected_.back()) || !same(*last_--,
+                expected_.back()) || last_ - compact_.begin() !=
+            static_cast<std::ptrdiff_t>(expected_.size()) - 2)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Driving lookup() and dollar() with either vector gives the same tokens
+// at every reduction, and match() gives the same result and captures.
+bool same_as_token_vector(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    compact_vector& reused_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    lexertl::citerator iter_(first_, last_, lsm_);
+    lexertl::citerator compact_iter_ = iter_;
+    parsertl::match_results results_(iter_->id, gsm_);
+    parsertl::match_results compact_results_ = results_;
+    token::token_vector productions_;
+    compact_vector compact_(first_);
+
+    while (results_.entry.action != parsertl::action::error &&
+        results_.entry.action != parsertl::action::accept)
+    {
+        if (!same_tokens(productions_, compact_))
+            return false;
+
+        if (results_.entry.action == parsertl::action::reduce)
+        {
+            for (std::size_t idx_ = 0, size_ = gsm_._rules
+                [results_.entry.param]._rhs.size(); idx_ < size_; ++idx_)
+            {
+                if (!same(results_.dollar(idx_, gsm_, productions_),
+                    compact_results_.dollar(idx_, gsm_, compact_)))
+                {
+                    return false;
+                }
+            }
+        }
+
+        parsertl::lookup(iter_, gsm_, results_, productions_);
+        parsertl::lookup(compact_iter_, gsm_, compact_results_, compact_);
+
+        if (!(results_ == compact_results_))
+            return false;
+    }
+
+    captures expected_;
+    captures captures_;
+    const bool success_ = parsertl::match(lexertl::citerator(first_, last_,
+        lsm_), gsm_, expected_);
+
+    // reused_ was last rebased on another input and is now rebased on
+    // the first token of this one
+    return parsertl::match(lexertl::citerator(first_, last_, lsm_), gsm_,
+        captures_, reused_) == success_ && captures_ == expected_ &&
+        reused_.base() == lexertl::citerator(first_, last_, lsm_)->first;
+}
+
+int main()
+{
+    parsertl::rules grules_(*parsertl::rule_flags::enable_captures);
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const char alphabet_[] = "aaabbc  x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 100);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    compact_vector reused_;
+    int failures_ = 0;
+
+    grules_.token("A B C");
+    grules_.push("list", "item | list item");
+    grules_.push("item", "(A) | B (list) C");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("A"));
+    lrules_.push("b+", grules_.token_id("B"));
+    lrules_.push("c", grules_.token_id("C"));
+    lrules_.push(" +", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    if (!round_trip())
+    {
+        std::cout << "round_trip failed\n";
+        ++failures_;
+    }
+
+    for (std::size_t run_ = 0; run_ < 500; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        // Half the inputs without unknown characters, so that some match
+        if (run_ % 2)
+            text_.erase(std::remove(text_.begin(), text_.end(), 'x'),
+                text_.end());
+
+        if (!same_as_token_vector(text_, lsm_, gsm_, reused_))
+        {
+            std::cout << "random_inputs failed for \"" << text_ << "\"\n";
+            ++failures_;
+            break;
+        }
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include "../../include/parsertl/events.hpp"
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+using spans = parsertl::event_spans<lexertl::citerator>;
+
+// shift: token id, first, second
+// reduce: rule id, first, second (or null for empty rules)
+struct event
+{
+    bool _shift = false;
+    std::size_t _id = 0;
+    const char* _first = nullptr;
+    const char* _second = nullptr;
+
+    bool operator ==(const event& rhs_) const
+    {
+        return _shift == rhs_._shift && _id == rhs_._id &&
+            _first == rhs_._first && _second == rhs_._second;
+    }
+};
+
+struct sink
+{
+    const parsertl::state_machine* _sm = nullptr;
+    std::vector<event> _events;
+    bool _ok = true;
+
+    void shift(const lexertl::citerator::value_type& token_)
+    {
+        _events.push_back(event{ true, token_.id, token_.first,
+            token_.second });
+    }
+
+    void reduce(const std::size_t rule_id_, const char* first_,
+        const char* second_)
+    {
+        if (_sm->_rules[rule_id_]._rhs.empty())
+        {
+            // An empty rule has an empty span
+            if (first_ != second_)
+                _ok = false;
+
+            first_ = second_ = nullptr;
+        }
+
+        _events.push_back(event{ false, rule_id_, first_, second_ });
+    }
+};
+
+// The same events derived from lookup() and a production vector.
+bool expected(const char* first_, const char* last_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    std::vector<event>& events_)
+{
+    using token = parsertl::token<lexertl::citerator>;
+    lexertl::citerator iter_(first_, last_, lsm_);
+    parsertl::match_results results_(iter_->id, gsm_);
+    token::token_vector productions_;
+
+    while (results_.entry.action != parsertl::action::error &&
+        results_.entry.action != parsertl::action::accept)
+    {
+        if (results_.entry.action == parsertl::action::shift &&
+            iter_->id != 0)
+        {
+            events_.push_back(event{ true, iter_->id, iter_->first,
+                iter_->second });
+        }
+        else if (results_.entry.action == parsertl::action::reduce)
+        {
+            const std::size_t size_ =
+                gsm_._rules[results_.entry.param]._rhs.size();
+            event event_{ false, results_.entry.param, nullptr, nullptr };
+
+            if (size_)
+            {
+                event_._first =
+                    productions_[productions_.size() - size_].first;
+                event_._second = productions_.back().second;
+            }
+
+            events_.push_back(event_);
+        }
+
+        parsertl::lookup(iter_, gsm_, results_, productions_);
+    }
+
+    return results_.entry.action == parsertl::action::accept;
+}
+
+// Both overloads of parse_events() report the same events as lookup(),
+// and the caller's spans_ only allocates when the stack is deeper than
+// in any earlier call.
+bool same_as_lookup(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    spans& spans_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    std::vector<event> expected_;
+    const bool success_ = expected(first_, last_, lsm_, gsm_, expected_);
+    const std::size_t capacity_ = spans_.capacity();
+    std::size_t max_depth_ = 0;
+    sink reused_;
+    sink local_;
+
+    reused_._sm = local_._sm = &gsm_;
+
+    {
+        lexertl::citerator iter_(first_, last_, lsm_);
+        parsertl::match_results results_(iter_->id, gsm_);
+
+        // spans_ is left over from the previous input
+        if (parsertl::parse_events(iter_, gsm_, results_, reused_,
+            spans_) != success_)
+        {
+            return false;
+        }
+
+        // Shifts and empty rules are the only events that grow the stack
+        for (const auto& event_ : expected_)
+        {
+            if (event_._shift || !event_._first)
+                ++max_depth_;
+        }
+    }
+
+    {
+        lexertl::citerator iter_(first_, last_, lsm_);
+        parsertl::match_results results_(iter_->id, gsm_);
+
+        if (parsertl::parse_events(iter_, gsm_, results_, local_) !=
+            success_)
+        {
+            return false;
+        }
+    }
+
+    return reused_._ok && local_._ok && reused_._events == expected_ &&
+        local_._events == expected_ &&
+        (max_depth_ > capacity_ || spans_.capacity() == capacity_);
+}
+
+int main()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const char alphabet_[] = "aaabbcc  x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 100);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    spans spans_;
+    int failures_ = 0;
+
+    grules_.token("A B C");
+    grules_.push("list", "%empty | list item");
+    grules_.push("item", "A | B list C");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("A"));
+    lrules_.push("b", grules_.token_id("B"));
+    lrules_.push("c", grules_.token_id("C"));
+    lrules_.push(" +", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (std::size_t run_ = 0; run_ < 1000; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        // Half the inputs without unknown characters
+        if (run_ % 2)
+            text_.erase(std::remove(text_.begin(), text_.end(), 'x'),
+                text_.end());
+
+        if (!same_as_lookup(text_, lsm_, gsm_, spans_))
+        {
+            std::cout << "random_inputs failed for \"" << text_ << "\"\n";
+            ++failures_;
+            break;
+        }
+    }
+
+    return failures_ ? 1 : 0;
+}
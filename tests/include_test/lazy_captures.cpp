@@ -0,0 +1,2 @@
+#include "../../include/parsertl/lazy_captures.hpp"
+
@@ -0,0 +1,2 @@
+#include "../../include/parsertl/parallel_search.hpp"
+
@@ -0,0 +1,2 @@
+#include "../../include/parsertl/push_parser.hpp"
+
@@ -0,0 +1,2 @@
+#include "../../include/parsertl/single_pass_search.hpp"
+
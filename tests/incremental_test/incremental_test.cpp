@@ -0,0 +1,288 @@
+#include "../../include/parsertl/incremental.hpp"
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <random>
+#include <string>
+
+using parser = parsertl::basic_incremental_parser
+    <parsertl::state_machine, lexertl::siterator>;
+
+// True if both parsers hold the same result and reductions.
+bool same_reductions(const parser& incremental_, const parser& full_)
+{
+    const auto& lhs_ = incremental_.reductions();
+    const auto& rhs_ = full_.reductions();
+
+    if (incremental_.accepted() != full_.accepted() ||
+        lhs_.size() != rhs_.size())
+    {
+        return false;
+    }
+
+    for (std::size_t idx_ = 0, size_ = lhs_.size(); idx_ < size_; ++idx_)
+    {
+        if (lhs_[idx_]._rule != rhs_[idx_]._rule ||
+            lhs_[idx_]._first != rhs_[idx_]._first ||
+            lhs_[idx_]._second != rhs_[idx_]._second)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Replaces old_length_ characters at offset_ with new_text_, then checks
+// that reparse() gives the same reductions as parsing the edited text.
+bool same_as_parse(std::string text_, const std::size_t offset_,
+    const std::size_t old_length_, const std::string& new_text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    parser incremental_(1);
+    parser full_(1);
+
+    incremental_.parse(text_.cbegin(), text_.cend(), lsm_, gsm_);
+    text_.replace(offset_, old_length_, new_text_);
+    incremental_.reparse(text_.cbegin(), text_.cend(), offset_, old_length_,
+        new_text_.size(), lsm_, gsm_);
+    full_.parse(text_.cbegin(), text_.cend(), lsm_, gsm_);
+
+    return incremental_.snapshots() == full_.snapshots() &&
+        same_reductions(incremental_, full_);
+}
+
+// An edit that extends the lookahead token of a snapshot ("if" becomes
+// "ifx") must not resume from that snapshot.
+bool extended_lookahead()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+
+    grules_.token("ID IF");
+    grules_.push("stmts", "stmt | stmts stmt");
+    grules_.push("stmt", "IF ID | ID");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("if", grules_.token_id("IF"));
+    lrules_.push("[a-z]+", grules_.token_id("ID"));
+    lrules_.push(" ", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+    return same_as_parse("b if a b c d", 4, 0, "x", lsm_, gsm_);
+}
+
+// A lookahead token that ends before the edit can still be relexed as
+// a longer token ("1" followed by ".x" becomes "1.5").
+bool relexed_lookahead()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+
+    grules_.token("FLOAT INT NAME");
+    grules_.push("items", "item | items item");
+    grules_.push("item", "INT | FLOAT | '.' | NAME");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("\\d+", grules_.token_id("INT"));
+    lrules_.push("\\d+\\.\\d+", grules_.token_id("FLOAT"));
+    lrules_.push("\\.", grules_.token_id("'.'"));
+    lrules_.push("[a-z]+", grules_.token_id("NAME"));
+    lexertl::generator::build(lrules_, lsm_);
+    return same_as_parse("1.x", 2, 1, "5", lsm_, gsm_);
+}
+
+// A token shifted before the lookahead of a snapshot can change too when
+// the lexer read past its end ("1" in "1..x" becomes part of "1..5").
+bool backtracked_token()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+
+    grules_.token("INT NAME RANGE");
+    grules_.push("items", "item | items item");
+    grules_.push("item", "INT | RANGE | '.' | NAME");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("\\d+", grules_.token_id("INT"));
+    lrules_.push("\\d+\\.\\.\\d+", grules_.token_id("RANGE"));
+    lrules_.push("\\.", grules_.token_id("'.'"));
+    lrules_.push("[a-z]+", grules_.token_id("NAME"));
+    lexertl::generator::build(lrules_, lsm_);
+    return same_as_parse("1..x", 3, 1, "5", lsm_, gsm_);
+}
+
+// Statements of nested expressions, as used by the tests below.
+void build_statements(parsertl::state_machine& gsm_,
+    lexertl::state_machine& lsm_, std::string& text_)
+{
+    parsertl::rules grules_;
+    lexertl::rules lrules_;
+
+    grules_.token("ID INT");
+    grules_.push("stmts", "%empty | stmts stmt");
+    grules_.push("stmt", "exp ';'");
+    grules_.push("exp", "term | exp term");
+    grules_.push("term", "ID | INT | '(' exp ')' | '(' ')'");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("[a-z][a-z0-9]*", grules_.token_id("ID"));
+    lrules_.push("\\d+", grules_.token_id("INT"));
+    lrules_.push("[(]", grules_.token_id("'('"));
+    lrules_.push("[)]", grules_.token_id("')'"));
+    lrules_.push(";", grules_.token_id("';'"));
+    lrules_.push(" ", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (int stmt_ = 0; stmt_ < 50; ++stmt_)
+    {
+        text_ += stmt_ % 5 == 0 ? "((a b) 1);" : "a (b 2);";
+    }
+}
+
+// Inserting straight after a token ("(" or "2") must not stop the rest
+// of a long document from being reused.
+bool insert_after_token()
+{
+    parsertl::state_machine gsm_;
+    lexertl::state_machine lsm_;
+    std::string text_;
+
+    build_statements(gsm_, lsm_, text_);
+
+    for (const char* token_ : { "(", "2" })
+    {
+        std::string edited_ = text_;
+        const std::size_t offset_ = edited_.find(token_, 200) + 1;
+        parser incremental_(3);
+        parser full_(3);
+
+        incremental_.parse(edited_.cbegin(), edited_.cend(), lsm_, gsm_);
+        edited_.insert(offset_, "a");
+        incremental_.reparse(edited_.cbegin(), edited_.cend(), offset_, 0,
+            1, lsm_, gsm_);
+        full_.parse(edited_.cbegin(), edited_.cend(), lsm_, gsm_);
+
+        if (!incremental_.accepted() || incremental_.reused() == 0 ||
+            !same_reductions(incremental_, full_))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Replaces old_length_ characters at offset_ with new_text_ in both text_
+// and incremental_, then checks the result against a full parse.
+bool edit(std::string& text_, const std::size_t offset_,
+    const std::size_t old_length_, const std::string& new_text_,
+    parser& incremental_, const lexertl::state_machine& lsm_,
+    const parsertl::state_machine& gsm_, bool& accepted_)
+{
+    parser full_(3);
+
+    text_.replace(offset_, old_length_, new_text_);
+    incremental_.reparse(text_.cbegin(), text_.cend(), offset_,
+        old_length_, new_text_.size(), lsm_, gsm_);
+    full_.parse(text_.cbegin(), text_.cend(), lsm_, gsm_);
+    accepted_ = full_.accepted();
+    return same_reductions(incremental_, full_);
+}
+
+// Applies a series of random edits to one parser, so that each
+// reparse() starts from snapshots left by the one before. An edit that
+// makes the text invalid is undone again, so that most reparses have a
+// whole document to resynchronise with.
+// Nearly every edit accepted straight away must reuse part of the
+// previous parse. An undo cannot, as the parse it follows stopped at
+// the error.
+// With an interval above 1 the snapshots are taken at different tokens
+// than a full parse would choose, so only the reductions are compared.
+bool random_edits()
+{
+    parsertl::state_machine gsm_;
+    lexertl::state_machine lsm_;
+    std::mt19937 gen_(0);
+    const std::string pieces_[] = { "(", ")", "a", "b1", " ", "1", ";",
+        "(a)", " 2 ", "(b c);" };
+    std::string text_;
+    parser incremental_(3);
+    std::size_t accepted_edits_ = 0;
+    std::size_t reused_edits_ = 0;
+
+    build_statements(gsm_, lsm_, text_);
+    incremental_.parse(text_.cbegin(), text_.cend(), lsm_, gsm_);
+
+    for (int edit_ = 0; edit_ < 2000; ++edit_)
+    {
+        const std::size_t offset_ = gen_() % (text_.size() + 1);
+        const std::size_t old_length_ =
+            std::min<std::size_t>(gen_() % 3, text_.size() - offset_);
+        const std::string old_text_ = text_.substr(offset_, old_length_);
+        const std::string new_text_ = gen_() % 4 ? pieces_[gen_() % 10] : "";
+        bool accepted_ = false;
+
+        if (!edit(text_, offset_, old_length_, new_text_, incremental_,
+            lsm_, gsm_, accepted_))
+        {
+            return false;
+        }
+
+        if (accepted_)
+        {
+            ++accepted_edits_;
+
+            if (incremental_.reused() > 0)
+            {
+                ++reused_edits_;
+            }
+        }
+        else if (!edit(text_, offset_, new_text_.size(),
+            old_text_, incremental_, lsm_, gsm_, accepted_))
+        {
+            return false;
+        }
+    }
+
+    return reused_edits_ * 10 >= accepted_edits_ * 9;
+}
+
+int main()
+{
+    int failures_ = 0;
+
+    if (!extended_lookahead())
+    {
+        std::cout << "extended_lookahead failed\n";
+        ++failures_;
+    }
+
+    if (!relexed_lookahead())
+    {
+        std::cout << "relexed_lookahead failed\n";
+        ++failures_;
+    }
+
+    if (!backtracked_token())
+    {
+        std::cout << "backtracked_token failed\n";
+        ++failures_;
+    }
+
+    if (!insert_after_token())
+    {
+        std::cout << "insert_after_token failed\n";
+        ++failures_;
+    }
+
+    if (!random_edits())
+    {
+        std::cout << "random_edits failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
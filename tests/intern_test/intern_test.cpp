@@ -0,0 +1,204 @@
+#include "../../include/parsertl/columns.hpp"
+#include <cstdint>
+#include "../../include/parsertl/events.hpp"
+#include "../../include/parsertl/generator.hpp"
+#include "../../include/parsertl/intern.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using pool = parsertl::intern_pool;
+
+std::string view_str(const pool::view& view_)
+{
+    return std::string(view_.first, view_.second);
+}
+
+// Ids are handed out in first seen order, equal strings share an id,
+// find() only succeeds for interned strings, and views stay valid as
+// the pool grows (through rehashes and new blocks, including strings
+// longer than a block).
+bool same_as_map(const std::size_t block_size_, std::mt19937& gen_)
+{
+    pool pool_(block_size_);
+    std::map<std::string, std::uint32_t> expected_;
+    std::vector<pool::view> views_;
+
+    for (std::size_t idx_ = 0; idx_ < 5000; ++idx_)
+    {
+        std::string str_(gen_() % (idx_ % 100 ? 6 : 40), ' ');
+
+        for (char& c_ : str_)
+        {
+            c_ = "abcd"[gen_() % 4];
+        }
+
+        const auto iter_ = expected_.find(str_);
+        const std::uint32_t found_ = pool_.find(str_.begin(), str_.end());
+
+        if (found_ != (iter_ == expected_.end() ? pool::npos() :
+            iter_->second))
+        {
+            return false;
+        }
+
+        const std::uint32_t id_ = pool_.intern(str_.c_str(),
+            str_.c_str() + str_.size());
+
+        if (iter_ == expected_.end())
+        {
+            if (id_ != expected_.size())
+                return false;
+
+            expected_[str_] = id_;
+            views_.push_back(pool_[id_]);
+        }
+        else if (id_ != iter_->second)
+            return false;
+    }
+
+    if (pool_.size() != expected_.size())
+        return false;
+
+    for (const auto& pair_ : expected_)
+    {
+        // Views taken when the string was first interned
+        if (view_str(views_[pair_.second]) != pair_.first ||
+            view_str(pool_[pair_.second]) != pair_.first)
+        {
+            return false;
+        }
+    }
+
+    pool_.clear();
+
+    const std::string str_ = "abc";
+
+    return pool_.empty() && pool_.find(str_.begin(), str_.end()) ==
+        pool::npos() && pool_.intern(str_.begin(), str_.end()) == 0;
+}
+
+// Interning token text through the existing hooks: as a basic_columns
+// converter and from a parse_events() sink.
+struct sink
+{
+    pool* _pool = nullptr;
+    std::size_t _id = 0;
+    std::vector<std::uint32_t> _ids;
+
+    void shift(const lexertl::citerator::value_type& token_)
+    {
+        if (token_.id == _id)
+            _ids.push_back(_pool->intern(token_));
+    }
+
+    void reduce(const std::size_t, const char*, const char*)
+    {
+    }
+};
+
+bool hooks(const lexertl::state_machine& lsm_,
+    const parsertl::state_machine& gsm_, const std::size_t id_token_,
+    std::mt19937& gen_)
+{
+    static const char* names_[] = { "alpha", "beta", "gamma", "delta" };
+    std::string text_;
+    std::vector<std::string> names_used_;
+
+    for (std::size_t idx_ = 0; idx_ < 200; ++idx_)
+    {
+        names_used_.push_back(names_[gen_() % 4]);
+        text_ += names_used_.back() + " = 1;\n";
+    }
+
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    pool column_pool_;
+    pool event_pool_;
+    parsertl::basic_columns<parsertl::state_machine, lexertl::citerator,
+        std::uint32_t> columns_;
+    sink sink_;
+    lexertl::citerator iter_(first_, last_, lsm_);
+    parsertl::match_results results_(iter_->id, gsm_);
+
+    columns_.bind_capture(gsm_, 1);
+    sink_._pool = &event_pool_;
+    sink_._id = id_token_;
+
+    if (!columns_.parse(lexertl::citerator(first_, last_, lsm_), gsm_,
+        [&column_pool_](const char* lhs_, const char* rhs_)
+        {
+            return column_pool_.intern(lhs_, rhs_);
+        }) || !parsertl::parse_events(iter_, gsm_, results_, sink_) ||
+        columns_[0] != sink_._ids || column_pool_.size() > 4 ||
+        sink_._ids.size() != names_used_.size())
+    {
+        return false;
+    }
+
+    for (std::size_t idx_ = 0, size_ = names_used_.size(); idx_ < size_;
+        ++idx_)
+    {
+        if (view_str(event_pool_[sink_._ids[idx_]]) != names_used_[idx_])
+            return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    parsertl::rules grules_(*parsertl::rule_flags::enable_captures);
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    std::mt19937 gen_(0);
+    int failures_ = 0;
+
+    grules_.token("ID NUM");
+    grules_.push("stmts", "stmt | stmts stmt");
+    grules_.push("stmt", "(ID) '=' NUM ';'");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("[a-z]+", grules_.token_id("ID"));
+    lrules_.push("[0-9]+", grules_.token_id("NUM"));
+    lrules_.push("=", grules_.token_id("'='"));
+    lrules_.push(";", grules_.token_id("';'"));
+    lrules_.push("\\s+", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    const std::size_t block_sizes_[] = { 0, 8, 4096 };
+
+    for (const std::size_t block_size_ : block_sizes_)
+    {
+        if (!same_as_map(block_size_, gen_))
+        {
+            std::cout << "same_as_map failed with block size " <<
+                block_size_ << '\n';
+            ++failures_;
+        }
+    }
+
+    if (!hooks(lsm_, gsm_, grules_.token_id("ID"), gen_))
+    {
+        std::cout << "hooks failed\n";
+        ++failures_;
+    }
+
+    {
+        parsertl::wintern_pool wpool_;
+        const std::wstring str_ = L"wide";
+
+        if (wpool_.intern(str_.begin(), str_.end()) != 0 ||
+            std::wstring(wpool_[0].first, wpool_[0].second) != str_)
+        {
+            std::cout << "wide failed\n";
+            ++failures_;
+        }
+    }
+
+    return failures_ ? 1 : 0;
+}
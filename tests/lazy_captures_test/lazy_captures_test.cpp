@@ -0,0 +1,141 @@
+#include <algorithm>
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include "../../include/parsertl/lazy_captures.hpp"
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/match.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+using lazy_captures = parsertl::basic_lazy_captures<lexertl::citerator,
+    parsertl::state_machine>;
+using captures = std::vector<std::vector<parsertl::capture<const char*>>>;
+
+// True if lazy_ holds the same captures as eager_, except that indexes
+// not in groups_ are empty (when groups_ is not empty).
+bool same_captures(lazy_captures& lazy_, const captures& eager_,
+    const std::vector<std::size_t>& groups_)
+{
+    if (lazy_.size() != eager_.size())
+        return false;
+
+    for (std::size_t idx_ = 0, size_ = eager_.size(); idx_ < size_; ++idx_)
+    {
+        const bool selected_ = idx_ == 0 || groups_.empty() ||
+            std::find(groups_.begin(), groups_.end(), idx_) != groups_.end();
+
+        if (selected_ ? lazy_[idx_] != eager_[idx_] : !lazy_[idx_].empty())
+            return false;
+    }
+
+    return true;
+}
+
+// Compares match() and repeated search() calls with lazy and eager
+// captures over text_.
+bool same_as_eager(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    const std::vector<std::size_t>& groups_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    lexertl::citerator iter_(first_, last_, lsm_);
+    lazy_captures lazy_;
+    captures eager_;
+
+    lazy_.select(gsm_, groups_);
+
+    const bool hit_ = parsertl::match(iter_, gsm_, eager_);
+
+    if (parsertl::match(iter_, gsm_, lazy_) != hit_ ||
+        (hit_ && !same_captures(lazy_, eager_, groups_)))
+    {
+        std::cout << "match() differs for \"" << text_ << "\"\n";
+        return false;
+    }
+
+    for (;;)
+    {
+        lexertl::citerator lhs_ = iter_;
+        lexertl::citerator lhs_end_;
+        lexertl::citerator rhs_ = iter_;
+        lexertl::citerator rhs_end_;
+        const bool lhs_hit_ = parsertl::search(lhs_, lhs_end_, gsm_, eager_);
+        const bool rhs_hit_ = parsertl::search(rhs_, rhs_end_, gsm_, lazy_);
+
+        if (lhs_hit_ != rhs_hit_ || (lhs_hit_ && (lhs_ != rhs_ ||
+            lhs_end_ != rhs_end_ || !same_captures(lazy_, eager_, groups_))))
+        {
+            std::cout << "search() differs for \"" << text_ << "\" from " <<
+                iter_->first - first_ << '\n';
+            return false;
+        }
+
+        if (!lhs_hit_)
+            break;
+
+        iter_ = lhs_end_;
+    }
+
+    return true;
+}
+
+bool random_inputs()
+{
+    parsertl::rules grules_(*parsertl::rule_flags::enable_captures);
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    // Every index, a selection and a single nested index
+    const std::vector<std::size_t> selections_[] = { {}, { 1, 4 }, { 3 } };
+    const char alphabet_[] = "aabbcc(() x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 40);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+
+    grules_.token("A B C");
+    grules_.push("list", "item | list item");
+    grules_.push("item", "(A) | '(' (list) ')' | B (C) | B C (C)");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("A"));
+    lrules_.push("b", grules_.token_id("B"));
+    lrules_.push("c", grules_.token_id("C"));
+    lrules_.push("[(]", grules_.token_id("'('"));
+    lrules_.push("[)]", grules_.token_id("')'"));
+    lrules_.push(" ", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (std::size_t run_ = 0; run_ < 3000; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        for (const auto& groups_ : selections_)
+        {
+            if (!same_as_eager(text_, lsm_, gsm_, groups_))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    int failures_ = 0;
+
+    if (!random_inputs())
+    {
+        std::cout << "random_inputs failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,317 @@
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/multi_search.hpp"
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using token = parsertl::token<lexertl::citerator>;
+using id_type = parsertl::state_machine::id_type;
+using prod_vector = std::vector<std::pair<id_type, token::token_vector>>;
+
+// Offset of iter_ within text_, or the length of text_ at end of input.
+std::size_t offset(const lexertl::citerator& iter_, const std::string& text_)
+{
+    return iter_ == lexertl::citerator() || iter_->id == 0 ?
+        text_.size() : iter_->first - text_.c_str();
+}
+
+struct fixture
+{
+    parsertl::rules _grules;
+    parsertl::state_machine _gsm;
+    parsertl::search_patterns _patterns;
+    // Pattern for each rule id, found from the grammar after each push()
+    std::vector<std::size_t> _expected;
+    lexertl::state_machine _lsm;
+
+    fixture()
+    {
+        lexertl::rules lrules_;
+        // One is a prefix of another, one overlaps the end of another,
+        // one has alternatives and one is recursive.
+        const char* patterns_[] =
+        {
+            "'a' 'b'",
+            "'a' 'b' 'c'",
+            "'b' 'c'",
+            "'e' 'a' | 'e' ('b' 'b')",
+            "list"
+        };
+
+        _grules.token("'a' 'b' 'c' 'd' 'e'");
+        _grules.push("list", "'d' | list 'd'");
+
+        for (const char* pattern_ : patterns_)
+        {
+            const std::size_t first_ = _grules.grammar().size();
+            const std::size_t index_ =
+                _patterns.push(_grules, "patterns", pattern_);
+            const auto& grammar_ = _grules.grammar();
+
+            _expected.resize(grammar_.size(), _patterns.npos());
+
+            for (std::size_t rule_ = first_; rule_ < grammar_.size();
+                ++rule_)
+            {
+                if (grammar_[rule_]._lhs == grammar_[first_]._lhs)
+                    _expected[rule_] = index_;
+            }
+        }
+
+        parsertl::generator::build(_grules, _gsm);
+        lrules_.push("a", _grules.token_id("'a'"));
+        lrules_.push("b", _grules.token_id("'b'"));
+        lrules_.push("c", _grules.token_id("'c'"));
+        lrules_.push("d", _grules.token_id("'d'"));
+        lrules_.push("e", _grules.token_id("'e'"));
+        lrules_.push(" ", lrules_.skip());
+        lexertl::generator::build(lrules_, _lsm);
+    }
+
+    // The pattern of the final reduction, as recorded by search()
+    std::size_t expected(const prod_vector& productions_) const
+    {
+        return productions_.empty() ||
+            productions_.back().first >= _expected.size() ?
+            _patterns.npos() : _expected[productions_.back().first];
+    }
+};
+
+// The pattern reported for the first match in text_.
+bool first_pattern(const fixture& fixture_, const char* text_,
+    const std::size_t expected_, const std::size_t start_,
+    const std::size_t end_)
+{
+    const std::string str_(text_);
+    lexertl::citerator iter_(str_.c_str(), str_.c_str() + str_.size(),
+        fixture_._lsm);
+    lexertl::citerator last_;
+    std::size_t pattern_ = 0;
+
+    if (!parsertl::multi_search(iter_, last_, fixture_._gsm,
+        fixture_._patterns, pattern_) || pattern_ != expected_ ||
+        offset(iter_, str_) != start_ || offset(last_, str_) != end_)
+    {
+        std::cout << '"' << text_ << "\" gave pattern " << pattern_ <<
+            " at " << offset(iter_, str_) << '-' << offset(last_, str_) <<
+            '\n';
+        return false;
+    }
+
+    return true;
+}
+
+bool overlapping_patterns(const fixture& fixture_)
+{
+    return first_pattern(fixture_, "a b", 0, 0, 3) &&
+        // Continues past the shorter pattern while it can
+        first_pattern(fixture_, "a b c", 1, 0, 5) &&
+        // Falls back to the shorter pattern at the last point it could
+        // have ended
+        first_pattern(fixture_, "a b e", 0, 0, 4) &&
+        first_pattern(fixture_, "a b a b c", 0, 0, 4) &&
+        // No pattern starts "a c", so the match starts at 'b'
+        first_pattern(fixture_, "a a c b c", 2, 6, 9) &&
+        first_pattern(fixture_, "e a", 3, 0, 3) &&
+        first_pattern(fixture_, "e b b", 3, 0, 5) &&
+        first_pattern(fixture_, "e b a b", 0, 4, 7) &&
+        first_pattern(fixture_, "d d d c", 4, 0, 6);
+}
+
+// Compares multi_search() with search() over random inputs, and
+// multi_search_count() with the patterns found along the way.
+bool random_inputs(const fixture& fixture_)
+{
+    const char alphabet_[] = "abcde x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 30);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    std::size_t seen_ = 0;
+
+    for (std::size_t run_ = 0; run_ < 2000; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+        std::vector<std::size_t> expected_counts_(fixture_._patterns.size(),
+            0);
+        std::vector<std::size_t> counts_;
+        std::size_t hits_ = 0;
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        lexertl::citerator iter_(text_.c_str(),
+            text_.c_str() + text_.size(), fixture_._lsm);
+        const lexertl::citerator first_ = iter_;
+
+        for (;;)
+        {
+            lexertl::citerator lhs_ = iter_;
+            lexertl::citerator lhs_end_;
+            lexertl::citerator rhs_ = iter_;
+            lexertl::citerator rhs_end_;
+            prod_vector productions_;
+            std::size_t pattern_ = 0;
+            const bool lhs_hit_ = parsertl::search(lhs_, lhs_end_,
+                fixture_._gsm, &productions_);
+            const bool rhs_hit_ = parsertl::multi_search(rhs_, rhs_end_,
+                fixture_._gsm, fixture_._patterns, pattern_);
+            const std::size_t expected_ = lhs_hit_ ?
+                fixture_.expected(productions_) : fixture_._patterns.npos();
+
+            if (lhs_hit_ != rhs_hit_ || pattern_ != expected_ ||
+                (lhs_hit_ && (offset(lhs_, text_) != offset(rhs_, text_) ||
+                    offset(lhs_end_, text_) != offset(rhs_end_, text_))))
+            {
+                std::cout << '"' << text_ << "\" from " <<
+                    offset(iter_, text_) << ": pattern " << pattern_ <<
+                    ", expected " << expected_ << '\n';
+                return false;
+            }
+
+            if (!lhs_hit_)
+                break;
+
+            // Every match is one of the patterns
+            if (expected_ == fixture_._patterns.npos())
+                return false;
+
+            seen_ |= 1 << expected_;
+            ++expected_counts_[expected_];
+            ++hits_;
+            iter_ = lhs_end_;
+        }
+
+        if (parsertl::multi_search_count(first_, fixture_._gsm,
+            fixture_._patterns, counts_) != hits_ ||
+            counts_ != expected_counts_)
+        {
+            std::cout << '"' << text_ << "\": multi_search_count() "
+                "differs\n";
+            return false;
+        }
+    }
+
+    // Every pattern was found at least once
+    return seen_ == (1u << fixture_._patterns.size()) - 1;
+}
+
+// Throws if sm_ is rejected by validate(), multi_search() and
+// multi_search_count().
+bool rejected(const fixture& fixture_, const parsertl::state_machine& sm_)
+{
+    const std::string text_ = "a b";
+    lexertl::citerator iter_(text_.c_str(), text_.c_str() + text_.size(),
+        fixture_._lsm);
+    lexertl::citerator end_;
+    std::size_t pattern_ = 0;
+    std::vector<std::size_t> counts_;
+    std::size_t thrown_ = 0;
+
+    try
+    {
+        fixture_._patterns.validate(sm_);
+    }
+    catch (const parsertl::runtime_error&)
+    {
+        ++thrown_;
+    }
+
+    try
+    {
+        parsertl::multi_search(iter_, end_, sm_, fixture_._patterns,
+            pattern_);
+    }
+    catch (const parsertl::runtime_error&)
+    {
+        ++thrown_;
+    }
+
+    try
+    {
+        parsertl::multi_search_count(iter_, sm_, fixture_._patterns,
+            counts_);
+    }
+    catch (const parsertl::runtime_error&)
+    {
+        ++thrown_;
+    }
+
+    return thrown_ == 3;
+}
+
+bool validate(const fixture& fixture_)
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+
+    // The state machine the patterns were added for is accepted
+    try
+    {
+        fixture_._patterns.validate(fixture_._gsm);
+    }
+    catch (const parsertl::runtime_error&)
+    {
+        return false;
+    }
+
+    // Fewer rules than the patterns refer to
+    grules_.token("'a' 'b'");
+    grules_.push("s", "'a' 'b'");
+    parsertl::generator::build(grules_, gsm_);
+
+    if (!rejected(fixture_, gsm_))
+        return false;
+
+    // The same rules pushed in a different order, so that the rule ids
+    // of the patterns have other productions.
+    grules_.clear();
+    grules_.token("'a' 'b' 'c' 'd' 'e'");
+    grules_.push("list", "'d' | list 'd'");
+    grules_.push("patterns", "'a' 'b' 'c'");
+    grules_.push("patterns", "'a' 'b'");
+    grules_.push("patterns", "'b' 'c'");
+    grules_.push("patterns", "'e' 'a' | 'e' ('b' 'b')");
+    grules_.push("patterns", "list");
+    grules_.start("patterns");
+    parsertl::generator::build(grules_, gsm_);
+
+    if (!rejected(fixture_, gsm_))
+        return false;
+
+    // An empty state machine
+    gsm_.clear();
+    return rejected(fixture_, gsm_);
+}
+
+int main()
+{
+    const fixture fixture_;
+    int failures_ = 0;
+
+    if (!overlapping_patterns(fixture_))
+    {
+        std::cout << "overlapping_patterns failed\n";
+        ++failures_;
+    }
+
+    if (!random_inputs(fixture_))
+    {
+        std::cout << "random_inputs failed\n";
+        ++failures_;
+    }
+
+    if (!validate(fixture_))
+    {
+        std::cout << "validate failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
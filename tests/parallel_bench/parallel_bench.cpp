@@ -0,0 +1,129 @@
+#include <chrono>
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/match.hpp"
+#include "../../include/parsertl/parallel_match.hpp"
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Times parallel_match() over the same batch of documents with 1..N
+// threads and reports the throughput of each relative to one thread.
+// Usage: parallel_bench [documents] [max threads]
+
+// Appends a random arithmetic expression of roughly size_ tokens.
+void expression(std::string& str_, std::size_t size_, std::mt19937& gen_)
+{
+    if (size_ < 2 || gen_() % 8 == 0)
+    {
+        str_ += std::to_string(gen_() % 1000);
+        return;
+    }
+
+    static const char ops_[] = "+-*/";
+    const std::size_t lhs_ = gen_() % size_;
+    const bool bracket_ = gen_() % 4 == 0;
+
+    if (bracket_)
+        str_ += '(';
+
+    expression(str_, lhs_, gen_);
+    str_ += ' ';
+    str_ += ops_[gen_() % 4];
+    str_ += ' ';
+    expression(str_, size_ - lhs_ - 1, gen_);
+
+    if (bracket_)
+        str_ += ')';
+}
+
+int main(int argc, char* argv[])
+{
+    const std::size_t documents_ = argc > 1 ?
+        std::stoul(argv[1]) : 20000;
+    std::size_t max_threads_ = argc > 2 ?
+        std::stoul(argv[2]) : std::thread::hardware_concurrency();
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    std::vector<std::string> inputs_(documents_);
+    std::vector<char> expected_;
+    std::mt19937 gen_(1);
+    std::size_t bytes_ = 0;
+    double base_ = 0;
+
+    grules_.token("INTEGER");
+    grules_.left("'+' '-'");
+    grules_.left("'*' '/'");
+    grules_.push("exp", "exp '+' exp | exp '-' exp | exp '*' exp | "
+        "exp '/' exp | '(' exp ')' | INTEGER");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("[+]", grules_.token_id("'+'"));
+    lrules_.push("-", grules_.token_id("'-'"));
+    lrules_.push("[*]", grules_.token_id("'*'"));
+    lrules_.push("[/]", grules_.token_id("'/'"));
+    lrules_.push("[(]", grules_.token_id("'('"));
+    lrules_.push("[)]", grules_.token_id("')'"));
+    lrules_.push("\\d+", grules_.token_id("INTEGER"));
+    lrules_.push("\\s+", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    // Document sizes vary widely so that a static split would be uneven
+    for (auto& input_ : inputs_)
+    {
+        expression(input_, 1 + gen_() % (gen_() % 16 == 0 ? 20000 : 500),
+            gen_);
+
+        // Every 100th document fails to parse
+        if (gen_() % 100 == 0)
+            input_ += " +";
+
+        bytes_ += input_.size();
+    }
+
+    expected_.reserve(documents_);
+
+    for (const auto& input_ : inputs_)
+    {
+        lexertl::siterator iter_(input_.begin(), input_.end(), lsm_);
+
+        expected_.push_back(parsertl::match(iter_, gsm_));
+    }
+
+    if (max_threads_ == 0)
+        max_threads_ = 1;
+
+    std::cout << documents_ << " documents, " << bytes_ << " bytes\n";
+
+    for (std::size_t threads_ = 1; threads_ <= max_threads_; ++threads_)
+    {
+        std::vector<char> matches_;
+        const auto start_ = std::chrono::steady_clock::now();
+
+        parsertl::parallel_match<lexertl::siterator>(inputs_.cbegin(),
+            inputs_.cend(), lsm_, gsm_, matches_, threads_);
+
+        const std::chrono::duration<double> elapsed_ =
+            std::chrono::steady_clock::now() - start_;
+        const double mb_s_ = bytes_ / elapsed_.count() / (1024 * 1024);
+
+        if (matches_ != expected_)
+        {
+            std::cout << "parallel_match() disagrees with match() using " <<
+                threads_ << " threads\n";
+            return 1;
+        }
+
+        if (threads_ == 1)
+            base_ = mb_s_;
+
+        std::cout << threads_ << " thread(s): " << elapsed_.count() <<
+            "s, " << mb_s_ << " MB/s, speedup " << mb_s_ / base_ << '\n';
+    }
+
+    return 0;
+}
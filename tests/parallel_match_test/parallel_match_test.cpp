@@ -0,0 +1,191 @@
+#include <algorithm>
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <list>
+#include "../../include/parsertl/match.hpp"
+#include "../../include/parsertl/parallel_match.hpp"
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Checks that parallel_match() gives the same answer as calling match()
+// on each input in turn, whatever the thread count, and that the results
+// come back in input order.
+template<typename container>
+bool same_as_match(const container& inputs_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    const std::size_t threads_[] = { 0, 1, 2, 3, 8, 1000 };
+    std::vector<char> expected_;
+
+    for (const std::string& input_ : inputs_)
+    {
+        expected_.push_back(parsertl::match(lexertl::siterator(input_.begin(),
+            input_.end(), lsm_), gsm_));
+    }
+
+    for (const std::size_t count_ : threads_)
+    {
+        std::vector<char> matches_(3, 1);
+
+        parsertl::parallel_match<lexertl::siterator>(inputs_.begin(),
+            inputs_.end(), lsm_, gsm_, matches_, count_);
+
+        if (matches_ != expected_)
+        {
+            std::cout << "Different matches with " << count_ <<
+                " threads\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Each input is passed to func_ exactly once along with its own index.
+// The lexer skips leading spaces, so compare what follows them.
+bool every_input_once(const std::vector<std::string>& inputs_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    using token = parsertl::token<lexertl::siterator>;
+    std::vector<std::string> seen_(inputs_.size());
+    std::vector<char> count_(inputs_.size(), 0);
+
+    parsertl::parallel_parse<lexertl::siterator>(inputs_.begin(),
+        inputs_.end(), lsm_, gsm_,
+        [&](const std::size_t index_, lexertl::siterator& iter_,
+            parsertl::match_results&, token::token_vector&)
+        {
+            ++count_[index_];
+            seen_[index_].assign(iter_->first, iter_->eoi);
+        }, 4);
+
+    for (std::size_t idx_ = 0, size_ = inputs_.size(); idx_ < size_; ++idx_)
+    {
+        const std::string& input_ = inputs_[idx_];
+        const std::size_t start_ = input_.find_first_not_of(' ');
+
+        if (seen_[idx_] != (start_ == std::string::npos ? std::string() :
+            input_.substr(start_)))
+        {
+            return false;
+        }
+    }
+
+    return std::count(count_.begin(), count_.end(), 1) ==
+        static_cast<std::ptrdiff_t>(count_.size());
+}
+
+// An exception thrown by func_ reaches the caller.
+bool rethrows(const std::vector<std::string>& inputs_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    using token = parsertl::token<lexertl::siterator>;
+
+    try
+    {
+        parsertl::parallel_parse<lexertl::siterator>(inputs_.begin(),
+            inputs_.end(), lsm_, gsm_,
+            [](const std::size_t index_, lexertl::siterator&,
+                parsertl::match_results&, token::token_vector&)
+            {
+                if (index_ == 7)
+                    throw std::runtime_error("input 7");
+            }, 4);
+    }
+    catch (const std::runtime_error& e_)
+    {
+        return std::string(e_.what()) == "input 7";
+    }
+
+    return false;
+}
+
+int main()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const char alphabet_[] = "aaabbc  x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 40);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    std::vector<std::string> inputs_;
+    int failures_ = 0;
+
+    grules_.token("A B C");
+    grules_.push("list", "item | list item");
+    grules_.push("item", "A | B list C");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("A"));
+    lrules_.push("b+", grules_.token_id("B"));
+    lrules_.push("c", grules_.token_id("C"));
+    lrules_.push(" +", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (std::size_t run_ = 0; run_ < 500; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        // Half the inputs without unknown characters, so that some match
+        if (run_ % 2)
+            text_.erase(std::remove(text_.begin(), text_.end(), 'x'),
+                text_.end());
+
+        inputs_.push_back(text_);
+    }
+
+    if (std::count_if(inputs_.begin(), inputs_.end(),
+        [&](const std::string& input_)
+        {
+            return parsertl::match(lexertl::siterator(input_.begin(),
+                input_.end(), lsm_), gsm_);
+        }) < 10)
+    {
+        std::cout << "too few matching inputs\n";
+        ++failures_;
+    }
+
+    if (!same_as_match(inputs_, lsm_, gsm_))
+    {
+        std::cout << "same_as_match (vector) failed\n";
+        ++failures_;
+    }
+
+    if (!same_as_match(std::list<std::string>(inputs_.begin(),
+        inputs_.end()), lsm_, gsm_))
+    {
+        std::cout << "same_as_match (list) failed\n";
+        ++failures_;
+    }
+
+    if (!same_as_match(std::vector<std::string>(), lsm_, gsm_))
+    {
+        std::cout << "same_as_match (empty) failed\n";
+        ++failures_;
+    }
+
+    if (!every_input_once(inputs_, lsm_, gsm_))
+    {
+        std::cout << "every_input_once failed\n";
+        ++failures_;
+    }
+
+    if (!rethrows(inputs_, lsm_, gsm_))
+    {
+        std::cout << "rethrows failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/parallel_search.hpp"
+#include <random>
+#include "../../include/parsertl/search_iterator.hpp"
+#include <string>
+
+using captures = std::vector<std::vector<parsertl::capture<const char*>>>;
+
+// Checks that parallel_search() finds the same matches and captures as
+// iterating a search_iterator, for a range of overlaps and threads.
+bool same_as_search_iterator(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    lexertl::citerator iter_(first_, last_, lsm_);
+    parsertl::search_iterator<lexertl::citerator, parsertl::state_machine>
+        search_(iter_, gsm_);
+    parsertl::search_iterator<lexertl::citerator, parsertl::state_machine>
+        end_;
+    std::vector<captures> expected_;
+    const std::size_t overlaps_[] = { 0, 1, 4, 16 };
+
+    for (; search_ != end_; ++search_)
+    {
+        expected_.push_back(*search_);
+    }
+
+    for (const std::size_t overlap_ : overlaps_)
+    {
+        for (std::size_t threads_ = 1; threads_ <= 4; ++threads_)
+        {
+            std::vector<captures> matches_;
+
+            parsertl::parallel_search<lexertl::citerator>(first_, last_,
+                lsm_, gsm_, '\n', overlap_, matches_, threads_);
+
+            if (matches_ != expected_)
+            {
+                std::cout << "overlap " << overlap_ << ", threads " <<
+                    threads_ << ": " << matches_.size() << " matches, " <<
+                    expected_.size() << " expected for \"" << text_ <<
+                    "\"\n";
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Lists that may span lines, nested with captures, among unknown
+// characters ('x') and tokens that cannot start a match ('c').
+bool random_inputs()
+{
+    parsertl::rules grules_(*parsertl::rule_flags::enable_captures);
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const char alphabet_[] = "aaabbcc \nx";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 300);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+
+    grules_.token("'a' 'b' 'c'");
+    grules_.push("list", "item | list item");
+    grules_.push("item", "'a' | 'b' (list) 'c'");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("'a'"));
+    lrules_.push("b", grules_.token_id("'b'"));
+    lrules_.push("c", grules_.token_id("'c'"));
+    lrules_.push("[ \n]+", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (std::size_t run_ = 0; run_ < 300; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        if (!same_as_search_iterator(text_, lsm_, gsm_))
+            return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    int failures_ = 0;
+
+    if (!random_inputs())
+    {
+        std::cout << "random_inputs failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include "../../include/parsertl/capture.hpp"
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/match.hpp"
+#include "../../include/parsertl/pipeline.hpp"
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using pipeline = parsertl::pipeline<lexertl::citerator>;
+using captures = std::vector<std::vector<parsertl::capture<const char*>>>;
+
+// Checks that pipeline yields the same tokens as lexing text_ directly
+// and that match() gives the same result and captures through either,
+// for ring sizes that wrap many times and that do not wrap at all.
+bool same_as_lexer(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    const std::size_t capacities_[] = { 2, 8, 4096 };
+    captures expected_captures_;
+    const bool expected_ = parsertl::match(lexertl::citerator(first_, last_,
+        lsm_), gsm_, expected_captures_);
+
+    for (const std::size_t capacity_ : capacities_)
+    {
+        pipeline pipeline_(first_, last_, lsm_, capacity_);
+        lexertl::citerator iter_(first_, last_, lsm_);
+        pipeline::iterator piter_ = pipeline_.begin();
+
+        for (;; ++iter_, ++piter_)
+        {
+            if (piter_->id != iter_->id || piter_->first != iter_->first ||
+                piter_->second != iter_->second)
+            {
+                std::cout << "Different token at " << iter_->first - first_ <<
+                    " in \"" << text_ << "\" with capacity " << capacity_ <<
+                    '\n';
+                return false;
+            }
+
+            if (iter_->id == 0)
+                break;
+        }
+
+        if (piter_ != pipeline_.end())
+            return false;
+
+        pipeline match_pipeline_(first_, last_, lsm_, capacity_);
+        captures captures_;
+
+        if (parsertl::match(match_pipeline_.begin(), gsm_, captures_) !=
+            expected_ || (expected_ && captures_ != expected_captures_))
+        {
+            std::cout << "match() differs for \"" << text_ <<
+                "\" with capacity " << capacity_ << '\n';
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Destroying a pipeline part way through stops the lexer thread, even
+// when it is waiting for room in the ring.
+bool early_exit(const lexertl::state_machine& lsm_)
+{
+    const std::string text_(100000, 'a');
+
+    for (std::size_t read_ = 0; read_ < 4; ++read_)
+    {
+        pipeline pipeline_(text_.c_str(), text_.c_str() + text_.size(), lsm_,
+            4);
+        pipeline::iterator iter_ = pipeline_.begin();
+
+        for (std::size_t idx_ = 0; idx_ < read_; ++idx_)
+        {
+            ++iter_;
+        }
+    }
+
+    return true;
+}
+
+// Lexes as lexertl::citerator, but throws on reaching a token that
+// starts with 'x', including from the constructor.
+class throwing_iterator
+{
+public:
+    using value_type = lexertl::citerator::value_type;
+
+    throwing_iterator(const char* first_, const char* last_,
+        const lexertl::state_machine& lsm_) :
+        _iter(first_, last_, lsm_)
+    {
+        check();
+    }
+
+    const value_type& operator *() const
+    {
+        return *_iter;
+    }
+
+    const value_type* operator ->() const
+    {
+        return &*_iter;
+    }
+
+    throwing_iterator& operator ++()
+    {
+        ++_iter;
+        check();
+        return *this;
+    }
+
+private:
+    lexertl::citerator _iter;
+
+    void check() const
+    {
+        if (_iter->id != 0 && *_iter->first == 'x')
+            throw std::runtime_error("x");
+    }
+};
+
+// An exception from the lexer, even for the first token, is rethrown
+// by the iterator after the tokens before it have been read.
+bool lexer_exceptions(const lexertl::state_machine& lsm_)
+{
+    const char* texts_[] = { "x", "  x a", "a x", "a b c x a" };
+
+    for (const char* text_ : texts_)
+    {
+        const std::string str_(text_);
+        const char* first_ = str_.c_str();
+        const char* last_ = first_ + str_.size();
+        const std::size_t before_ = static_cast<std::size_t>
+            (std::count_if(first_, first_ + str_.find('x'),
+                [](const char c_) { return c_ != ' '; }));
+        parsertl::pipeline<throwing_iterator> pipeline_(first_, last_, lsm_);
+        std::size_t read_ = 0;
+
+        try
+        {
+            auto iter_ = pipeline_.begin();
+
+            for (; iter_->id != 0; ++iter_)
+            {
+                ++read_;
+            }
+
+            return false;
+        }
+        catch (const std::runtime_error& e_)
+        {
+            if (std::string(e_.what()) != "x" || read_ != before_)
+            {
+                std::cout << '"' << text_ << "\" read " << read_ <<
+                    " tokens before the exception\n";
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    parsertl::rules grules_(*parsertl::rule_flags::enable_captures);
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const char alphabet_[] = "aaabbc  x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 200);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    int failures_ = 0;
+
+    grules_.token("A B C");
+    grules_.push("list", "item | list item");
+    grules_.push("item", "(A) | B (list) C");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("A"));
+    lrules_.push("b+", grules_.token_id("B"));
+    lrules_.push("c", grules_.token_id("C"));
+    lrules_.push(" +", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (std::size_t run_ = 0; run_ < 500; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        // Half the inputs without unknown characters, so that some match
+        if (run_ % 2)
+            text_.erase(std::remove(text_.begin(), text_.end(), 'x'),
+                text_.end());
+
+        if (!same_as_lexer(text_, lsm_, gsm_))
+        {
+            std::cout << "random_inputs failed\n";
+            ++failures_;
+            break;
+        }
+    }
+
+    if (!early_exit(lsm_))
+    {
+        std::cout << "early_exit failed\n";
+        ++failures_;
+    }
+
+    if (!lexer_exceptions(lsm_))
+    {
+        std::cout << "lexer_exceptions failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <random>
+#include "../../include/parsertl/search.hpp"
+#include "../../include/parsertl/serialise.hpp"
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using token = parsertl::token<lexertl::citerator>;
+using token_vector = token::token_vector;
+using id_type = parsertl::state_machine::id_type;
+using captures = std::vector<std::vector<parsertl::capture<const char*>>>;
+using prod_vector = std::vector<std::pair<id_type, token_vector>>;
+
+// Offset of iter_ within text_, or the length of text_ at end of input.
+std::size_t offset(const lexertl::citerator& iter_, const std::string& text_)
+{
+    return iter_ == lexertl::citerator() || iter_->id == 0 ?
+        text_.size() : iter_->first - text_.c_str();
+}
+
+bool same(const prod_vector& lhs_, const prod_vector& rhs_)
+{
+    if (lhs_.size() != rhs_.size())
+        return false;
+
+    for (std::size_t idx_ = 0, size_ = lhs_.size(); idx_ < size_; ++idx_)
+    {
+        const token_vector& lhs_tokens_ = lhs_[idx_].second;
+        const token_vector& rhs_tokens_ = rhs_[idx_].second;
+
+        if (lhs_[idx_].first != rhs_[idx_].first ||
+            lhs_tokens_.size() != rhs_tokens_.size())
+        {
+            return false;
+        }
+
+        for (std::size_t tok_ = 0, tokens_ = lhs_tokens_.size();
+            tok_ < tokens_; ++tok_)
+        {
+            if (lhs_tokens_[tok_].id != rhs_tokens_[tok_].id ||
+                lhs_tokens_[tok_].first != rhs_tokens_[tok_].first ||
+                lhs_tokens_[tok_].second != rhs_tokens_[tok_].second)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Walks text_ as search_iterator does, checking that filtered_ (with a
+// prefilter) finds the same matches, captures and productions as
+// unfiltered_ (the same table with an empty prefilter).
+bool same_as_unfiltered(const std::string& text_,
+    const lexertl::state_machine& lsm_,
+    const parsertl::state_machine& filtered_,
+    const parsertl::state_machine& unfiltered_)
+{
+    lexertl::citerator iter_(text_.c_str(), text_.c_str() + text_.size(),
+        lsm_);
+
+    for (;;)
+    {
+        lexertl::citerator lhs_ = iter_;
+        lexertl::citerator lhs_end_;
+        lexertl::citerator rhs_ = iter_;
+        lexertl::citerator rhs_end_;
+        captures lhs_captures_;
+        captures rhs_captures_;
+        const bool lhs_hit_ = parsertl::search(lhs_, lhs_end_, filtered_,
+            lhs_captures_);
+        const bool rhs_hit_ = parsertl::search(rhs_, rhs_end_, unfiltered_,
+            rhs_captures_);
+
+        if (lhs_hit_ != rhs_hit_ ||
+            (lhs_hit_ && (offset(lhs_, text_) != offset(rhs_, text_) ||
+                offset(lhs_end_, text_) != offset(rhs_end_, text_) ||
+                lhs_captures_ != rhs_captures_)))
+        {
+            std::cout << '"' << text_ << "\" from " << offset(iter_, text_) <<
+                ": filtered " << lhs_hit_ << ' ' << offset(lhs_, text_) <<
+                ' ' << offset(lhs_end_, text_) << ", unfiltered " <<
+                rhs_hit_ << ' ' << offset(rhs_, text_) << ' ' <<
+                offset(rhs_end_, text_) << '\n';
+            return false;
+        }
+
+        prod_vector lhs_prods_;
+        prod_vector rhs_prods_;
+
+        lhs_ = iter_;
+        rhs_ = iter_;
+        parsertl::search(lhs_, lhs_end_, filtered_, &lhs_prods_);
+        parsertl::search(rhs_, rhs_end_, unfiltered_, &rhs_prods_);
+
+        if (!same(lhs_prods_, rhs_prods_))
+        {
+            std::cout << '"' << text_ << "\" from " << offset(iter_, text_) <<
+                ": productions differ\n";
+            return false;
+        }
+
+        if (parsertl::search_count(iter_, filtered_) !=
+            parsertl::search_count(iter_, unfiltered_) ||
+            parsertl::search_any(iter_, filtered_) !=
+            parsertl::search_any(iter_, unfiltered_))
+        {
+            std::cout << '"' << text_ << "\" from " << offset(iter_, text_) <<
+                ": search_count()/search_any() differ\n";
+            return false;
+        }
+
+        if (!lhs_hit_)
+            break;
+
+        iter_ = lhs_end_;
+    }
+
+    return true;
+}
+
+bool same_prefilter(const parsertl::state_machine& lhs_,
+    const parsertl::state_machine& rhs_)
+{
+    return lhs_._prefilter._columns == rhs_._prefilter._columns &&
+        lhs_._prefilter._first == rhs_._prefilter._first &&
+        lhs_._prefilter._second == rhs_._prefilter._second;
+}
+
+int main()
+{
+    // Rules as lhs, rhs pairs ending with nullptr. The first is the start.
+    const char* grammars_[][10] =
+    {
+        // 'a' alone is a match, so the prefilter must keep it whatever
+        // follows (column 0 of its row).
+        { "list", "item | list item",
+            "item", "('a') | 'a' ('b') | 'c' 'd'", nullptr },
+
+        // Every match needs at least two tokens
+        { "s", "'a' ('b') 'c' | ('d') 'e' | 'e' s 'e'", nullptr },
+
+        { "exp", "exp '+' term | term",
+            "term", "term '*' factor | factor",
+            "factor", "('a') | '(' (exp) ')'", nullptr },
+
+        { "s", "'e' | 'e' 'e' 'e' | 'a' (s) 'b' | 'a' 'a' x",
+            "x", "'c' | x ('c' 'd')", nullptr }
+    };
+    // 'x' and '?' are not matched by the lexer (npos tokens) and 'z' is
+    // given an id beyond the grammar's tokens.
+    const char alphabet_[] = "abcde+*() xz?";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 30);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    int failures_ = 0;
+
+    for (const auto& grammar_ : grammars_)
+    {
+        parsertl::rules grules_(*parsertl::rule_flags::enable_captures);
+        parsertl::state_machine gsm_;
+        parsertl::state_machine unfiltered_;
+        parsertl::state_machine loaded_;
+        lexertl::rules lrules_;
+        lexertl::state_machine lsm_;
+        std::stringstream ss_;
+
+        grules_.token("'a' 'b' 'c' 'd' 'e' '+' '*' '(' ')'");
+
+        for (std::size_t idx_ = 0; grammar_[idx_]; idx_ += 2)
+        {
+            grules_.push(grammar_[idx_], grammar_[idx_ + 1]);
+        }
+
+        grules_.start(grammar_[0]);
+        parsertl::generator::build(grules_, gsm_);
+        unfiltered_ = gsm_;
+        unfiltered_._prefilter.clear();
+        parsertl::save(gsm_, ss_);
+        parsertl::load(ss_, loaded_);
+
+        lrules_.push("a", grules_.token_id("'a'"));
+        lrules_.push("b", grules_.token_id("'b'"));
+        lrules_.push("c", grules_.token_id("'c'"));
+        lrules_.push("d", grules_.token_id("'d'"));
+        lrules_.push("e", grules_.token_id("'e'"));
+        lrules_.push("\\+", grules_.token_id("'+'"));
+        lrules_.push("\\*", grules_.token_id("'*'"));
+        lrules_.push("\\(", grules_.token_id("'('"));
+        lrules_.push("\\)", grules_.token_id("')'"));
+        lrules_.push("z", 100);
+        lrules_.push(" ", lrules_.skip());
+        lexertl::generator::build(lrules_, lsm_);
+
+        if (gsm_._prefilter.empty())
+        {
+            std::cout << "no prefilter built for grammar " << grammar_[1] <<
+                '\n';
+            ++failures_;
+        }
+
+        if (!same_prefilter(loaded_, gsm_))
+        {
+            std::cout << "load() prefilter differs for grammar " <<
+                grammar_[1] << '\n';
+            ++failures_;
+        }
+
+        for (std::size_t run_ = 0; run_ < 2000; ++run_)
+        {
+            std::string text_(length_(gen_), ' ');
+
+            for (char& c_ : text_)
+            {
+                c_ = alphabet_[char_(gen_)];
+            }
+
+            if (!same_as_unfiltered(text_, lsm_, gsm_, unfiltered_) ||
+                !same_as_unfiltered(text_, lsm_, loaded_, unfiltered_))
+            {
+                std::cout << "random_inputs failed for grammar " <<
+                    grammar_[1] << '\n';
+                ++failures_;
+                break;
+            }
+        }
+    }
+
+    return failures_ ? 1 : 0;
+}
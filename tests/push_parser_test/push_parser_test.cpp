@@ -0,0 +1,211 @@
+#include <algorithm>
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/lookup.hpp"
+#include "../../include/parsertl/push_parser.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+// rule, first and second as offsets
+using reduction = std::vector<std::size_t>;
+
+// The reductions made by lookup() over the same input.
+bool expected(const std::string& text_, const lexertl::state_machine& lsm_,
+    const parsertl::state_machine& gsm_, std::vector<reduction>& log_)
+{
+    using token = parsertl::token<lexertl::citerator>;
+    const char* first_ = text_.c_str();
+    lexertl::citerator iter_(first_, first_ + text_.size(), lsm_);
+    parsertl::match_results results_(iter_->id, gsm_);
+    token::token_vector productions_;
+
+    while (results_.entry.action != parsertl::action::error &&
+        results_.entry.action != parsertl::action::accept)
+    {
+        if (results_.entry.action == parsertl::action::reduce)
+        {
+            const std::size_t size_ =
+                gsm_._rules[results_.entry.param]._rhs.size();
+
+            log_.push_back(reduction{ results_.entry.param,
+                static_cast<std::size_t>(productions_
+                [productions_.size() - size_].first - first_),
+                static_cast<std::size_t>(productions_.back().second -
+                first_) });
+        }
+
+        parsertl::lookup(iter_, gsm_, results_, productions_);
+    }
+
+    return results_.entry.action == parsertl::action::accept;
+}
+
+// Feeds text_ a token at a time and checks that the result and the
+// reductions match lookup(). Offsets are used as iter_type.
+template<std::size_t max_depth>
+bool same_as_lookup(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    std::size_t& max_seen_)
+{
+    using push_parser = parsertl::basic_push_parser<parsertl::state_machine,
+        std::size_t, max_depth>;
+    const char* first_ = text_.c_str();
+    std::vector<reduction> expected_;
+    const bool success_ = expected(text_, lsm_, gsm_, expected_);
+    push_parser parser_;
+
+    // A reused parser behaves the same as a new one
+    for (int pass_ = 0; pass_ < 2; ++pass_)
+    {
+        std::vector<reduction> log_;
+        parsertl::action action_ = parsertl::action::shift;
+
+        parser_.reset();
+
+        for (lexertl::citerator iter_(first_, first_ + text_.size(), lsm_),
+            end_; action_ == parsertl::action::shift; ++iter_)
+        {
+            action_ = parser_.push(iter_->id,
+                static_cast<std::size_t>(iter_->first - first_),
+                static_cast<std::size_t>(iter_->second - first_), gsm_,
+                [&log_](const std::size_t rule_, const std::size_t start_,
+                    const std::size_t end_)
+                {
+                    log_.push_back(reduction{ rule_, start_, end_ });
+                });
+            max_seen_ = std::max(max_seen_, parser_.depth());
+
+            if (iter_ == end_)
+                break;
+        }
+
+        if ((action_ == parsertl::action::accept) != success_ ||
+            action_ != parser_.state() || (success_ && log_ != expected_))
+        {
+            std::cout << "Different result for \"" << text_ << "\"\n";
+            return false;
+        }
+
+        // Once finished the parser stays finished
+        if (parser_.push(0, 0, 0, gsm_) != action_)
+            return false;
+    }
+
+    return true;
+}
+
+// Errors report their type, and error() refuses to answer without one.
+bool errors(const lexertl::state_machine& lsm_,
+    const parsertl::state_machine& gsm_)
+{
+    parsertl::basic_push_parser<parsertl::state_machine, std::size_t>
+        parser_;
+    const std::size_t a_ = lexertl::citerator("a", "a" + 1, lsm_)->id;
+    const std::size_t c_ = lexertl::citerator("c", "c" + 1, lsm_)->id;
+    bool thrown_ = false;
+
+    try
+    {
+        parser_.error();
+    }
+    catch (const parsertl::runtime_error&)
+    {
+        thrown_ = true;
+    }
+
+    if (!thrown_ || parser_.push(a_, 0, 1, gsm_) != parsertl::action::shift)
+        return false;
+
+    thrown_ = false;
+
+    try
+    {
+        parser_.error();
+    }
+    catch (const parsertl::runtime_error&)
+    {
+        thrown_ = true;
+    }
+
+    if (!thrown_ || parser_.push(c_, 1, 2, gsm_) != parsertl::action::error ||
+        parser_.error() != parsertl::error_type::syntax_error)
+    {
+        return false;
+    }
+
+    parser_.reset();
+
+    return parser_.push(gsm_._columns, 0, 1, gsm_) ==
+        parsertl::action::error &&
+        parser_.error() == parsertl::error_type::unknown_token;
+}
+
+int main()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const char alphabet_[] = "aaabc  x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 100);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    std::size_t max_seen_ = 0;
+    int failures_ = 0;
+
+    grules_.token("A B C");
+    // Right recursive, so the stack grows with the length of a list
+    grules_.push("list", "item list | item");
+    grules_.push("item", "A | B list C");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("A"));
+    lrules_.push("b", grules_.token_id("B"));
+    lrules_.push("c", grules_.token_id("C"));
+    lrules_.push(" +", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (std::size_t run_ = 0; run_ < 500; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        // Half the inputs without unknown characters, so that some match
+        if (run_ % 2)
+            text_.erase(std::remove(text_.begin(), text_.end(), 'x'),
+                text_.end());
+
+        if (!same_as_lookup<16>(text_, lsm_, gsm_, max_seen_) ||
+            !same_as_lookup<4>(text_, lsm_, gsm_, max_seen_))
+        {
+            std::cout << "random_inputs failed\n";
+            ++failures_;
+            break;
+        }
+    }
+
+    // Far deeper than the stack inside the object
+    if (!same_as_lookup<16>(std::string(1000, 'a'), lsm_, gsm_, max_seen_) ||
+        !same_as_lookup<16>(std::string(200, 'b') + std::string(200, 'a') +
+            std::string(200, 'c'), lsm_, gsm_, max_seen_) ||
+        max_seen_ < 1000)
+    {
+        std::cout << "overflow failed\n";
+        ++failures_;
+    }
+
+    if (!errors(lsm_, gsm_))
+    {
+        std::cout << "errors failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <random>
+#include "../../include/parsertl/search_file.hpp"
+#include <stdexcept>
+#include <string>
+
+// Writes match-dense and match-sparse corpora of the given size to disk
+// and reports the throughput of search_file() over each.
+// Usage: search_file_bench [megabytes per corpus] [temporary file]
+
+// Writes roughly megabytes_ of lines from line_() to pathname_ and
+// returns the number of assignments written.
+template<typename functor>
+std::size_t write_corpus(const char* pathname_, const std::size_t megabytes_,
+    functor line_)
+{
+    std::ofstream os_(pathname_, std::ios::binary);
+    const std::size_t size_ = megabytes_ * 1024 * 1024;
+    std::string buffer_;
+    std::size_t written_ = 0;
+    std::size_t count_ = 0;
+
+    while (written_ < size_)
+    {
+        buffer_.clear();
+
+        while (buffer_.size() < 1024 * 1024)
+        {
+            count_ += line_(buffer_);
+        }
+
+        os_.write(buffer_.c_str(), buffer_.size());
+        written_ += buffer_.size();
+    }
+
+    if (!os_)
+        throw std::runtime_error(std::string("Unable to write ") + pathname_);
+
+    return count_;
+}
+
+// Returns false if the number of matches is not as expected.
+bool time_search(const char* name_, const char* pathname_,
+    const std::size_t expected_, const lexertl::state_machine& lsm_,
+    const parsertl::state_machine& gsm_)
+{
+    std::size_t bytes_ = 0;
+    const auto start_ = std::chrono::steady_clock::now();
+    const std::size_t count_ = parsertl::search_file<lexertl::citerator>
+        (pathname_, lsm_, gsm_,
+        [&bytes_](const std::size_t first_, const std::size_t second_)
+        {
+            bytes_ += second_ - first_;
+        });
+    const std::chrono::duration<double> elapsed_ =
+        std::chrono::steady_clock::now() - start_;
+    std::ifstream is_(pathname_, std::ios::binary | std::ios::ate);
+    const double size_ = static_cast<double>(is_.tellg());
+
+    std::cout << name_ << ": " << size_ / (1024 * 1024) << " MB, " <<
+        count_ << " matches (" << bytes_ << " bytes) in " <<
+        elapsed_.count() << "s, " <<
+        size_ / elapsed_.count() / (1024 * 1024) << " MB/s\n";
+
+    if (count_ != expected_)
+    {
+        std::cout << "Expected " << expected_ << " matches\n";
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    const std::size_t megabytes_ = argc > 1 ? std::stoul(argv[1]) : 2048;
+    const char* pathname_ = argc > 2 ? argv[2] : "search_file_bench.tmp";
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const char* words_[] = { "the", "quick", "brown", "fox", "jumps", "over",
+        "lazy", "dog", "and", "then", "sleeps" };
+    std::mt19937 gen_(1);
+    int failures_ = 0;
+
+    grules_.token("IDENTIFIER INTEGER");
+    grules_.push("assignment", "IDENTIFIER '=' value ';'");
+    grules_.push("value", "INTEGER | value '+' INTEGER");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("=", grules_.token_id("'='"));
+    lrules_.push(";", grules_.token_id("';'"));
+    lrules_.push("[+]", grules_.token_id("'+'"));
+    lrules_.push("[a-z]+", grules_.token_id("IDENTIFIER"));
+    lrules_.push("\\d+", grules_.token_id("INTEGER"));
+    lrules_.push("\\s+", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    try
+    {
+        // Every line is an assignment
+        std::size_t expected_ = write_corpus(pathname_, megabytes_,
+            [&](std::string& buffer_)
+            {
+                buffer_ += words_[gen_() % 11];
+                buffer_ += " = ";
+                buffer_ += std::to_string(gen_() % 1000);
+
+                for (std::size_t idx_ = gen_() % 4; idx_ > 0; --idx_)
+                {
+                    buffer_ += " + ";
+                    buffer_ += std::to_string(gen_() % 1000);
+                }
+
+                buffer_ += ";\n";
+                return 1;
+            });
+
+        if (!time_search("match-dense", pathname_, expected_, lsm_, gsm_))
+            ++failures_;
+
+        // Prose (which the lexer cannot always tokenise) with an
+        // assignment every few thousand lines
+        expected_ = write_corpus(pathname_, megabytes_,
+            [&](std::string& buffer_)
+            {
+                if (gen_() % 4096 == 0)
+                {
+                    buffer_ += "total = 1 + 2;\n";
+                    return 1;
+                }
+
+                for (std::size_t idx_ = 1 + gen_() % 12; idx_ > 0; --idx_)
+                {
+                    buffer_ += words_[gen_() % 11];
+                    buffer_ += ' ';
+                }
+
+                buffer_ += gen_() % 2 ? ".\n" : ", 42 ...\n";
+                return 0;
+            });
+
+        if (!time_search("match-sparse", pathname_, expected_, lsm_, gsm_))
+            ++failures_;
+    }
+    catch (const std::exception& e_)
+    {
+        std::cout << e_.what() << '\n';
+        ++failures_;
+    }
+
+    std::remove(pathname_);
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,309 @@
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <iterator>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <list>
+#include <random>
+#include "../../include/parsertl/search_memo.hpp"
+#include <string>
+
+using list_iterator = lexertl::iterator<std::list<char>::const_iterator>;
+
+// Offset of iter_ within text_, or the length of text_ at end of input.
+std::size_t offset(const lexertl::citerator& iter_, const std::string& text_)
+{
+    return iter_ == lexertl::citerator() ?
+        text_.size() : iter_->first - text_.c_str();
+}
+
+// Repeats search() along text_ with and without memo_, which is kept
+// from one call to the next, and checks that the matches are the same.
+bool same_as_search(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    parsertl::csearch_memo& memo_)
+{
+    lexertl::citerator iter_(text_.c_str(), text_.c_str() + text_.size(),
+        lsm_);
+
+    memo_.reset();
+
+    for (;;)
+    {
+        lexertl::citerator lhs_ = iter_;
+        lexertl::citerator lhs_end_;
+        lexertl::citerator rhs_ = iter_;
+        lexertl::citerator rhs_end_;
+        const bool lhs_hit_ = parsertl::search(lhs_, lhs_end_, gsm_);
+        const bool rhs_hit_ = parsertl::search(rhs_, rhs_end_, gsm_, memo_);
+
+        if (lhs_hit_ != rhs_hit_ ||
+            (lhs_hit_ && (offset(lhs_, text_) != offset(rhs_, text_) ||
+                offset(lhs_end_, text_) != offset(rhs_end_, text_))))
+        {
+            std::cout << '"' << text_ << "\" from " << offset(iter_, text_) <<
+                ": search() " << lhs_hit_ << ' ' << offset(lhs_, text_) <<
+                '-' << offset(lhs_end_, text_) << ", with memo " <<
+                rhs_hit_ << ' ' << offset(rhs_, text_) << '-' <<
+                offset(rhs_end_, text_) << '\n';
+            return false;
+        }
+
+        if (!lhs_hit_)
+            break;
+
+        iter_ = lhs_end_;
+    }
+
+    return true;
+}
+
+bool random_inputs()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    // Small, so that the budget is exceeded along the way
+    parsertl::csearch_memo memo_(4096);
+    const char alphabet_[] = "aaaabbcd x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 200);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+
+    grules_.token("'a' 'b' 'c' 'd'");
+    grules_.push("s", "list 'c' | list 'd' 'b' | 'b' s");
+    grules_.push("list", "'a' | list 'a' | list 'b' 'a'");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("'a'"));
+    lrules_.push("b", grules_.token_id("'b'"));
+    lrules_.push("c", grules_.token_id("'c'"));
+    lrules_.push("d", grules_.token_id("'d'"));
+    lrules_.push(" ", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (std::size_t run_ = 0; run_ < 2000; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        if (!same_as_search(text_, lsm_, gsm_, memo_))
+            return false;
+    }
+
+    return memo_.hits() != 0 && memo_.evictions() != 0;
+}
+
+// Positions are counted in tokens, so a memo works over input that only
+// has forward iterators.
+bool forward_iterators()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    parsertl::basic_search_memo<std::list<char>::const_iterator> memo_(4096);
+    const char alphabet_[] = "aaaabbcd x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 200);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+
+    grules_.token("'a' 'b' 'c' 'd'");
+    grules_.push("s", "list 'c' | list 'd' 'b' | 'b' s");
+    grules_.push("list", "'a' | list 'a' | list 'b' 'a'");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("'a'"));
+    lrules_.push("b", grules_.token_id("'b'"));
+    lrules_.push("c", grules_.token_id("'c'"));
+    lrules_.push("d", grules_.token_id("'d'"));
+    lrules_.push(" ", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (std::size_t run_ = 0; run_ < 500; ++run_)
+    {
+        std::list<char> text_;
+        const std::size_t length_chars_ = length_(gen_);
+
+        for (std::size_t idx_ = 0; idx_ < length_chars_; ++idx_)
+        {
+            text_.push_back(alphabet_[char_(gen_)]);
+        }
+
+        // Offset of iter_ within text_
+        const auto offset_ = [&text_](const list_iterator& iter_)
+        {
+            return iter_ == list_iterator() ? text_.size() :
+                static_cast<std::size_t>(std::distance(text_.cbegin(),
+                    iter_->first));
+        };
+        list_iterator iter_(text_.cbegin(), text_.cend(), lsm_);
+
+        memo_.reset();
+
+        // Twice, so the second pass restarts from the first token
+        for (std::size_t pass_ = 0; pass_ < 2; ++pass_)
+        {
+            for (;;)
+            {
+                list_iterator lhs_ = iter_;
+                list_iterator lhs_end_;
+                list_iterator rhs_ = iter_;
+                list_iterator rhs_end_;
+                const bool lhs_hit_ = parsertl::search(lhs_, lhs_end_,
+                    gsm_);
+                const bool rhs_hit_ = parsertl::search(rhs_, rhs_end_,
+                    gsm_, memo_);
+
+                if (lhs_hit_ != rhs_hit_ ||
+                    (lhs_hit_ && (offset_(lhs_) != offset_(rhs_) ||
+                        offset_(lhs_end_) != offset_(rhs_end_))))
+                {
+                    return false;
+                }
+
+                if (!lhs_hit_)
+                    break;
+
+                iter_ = lhs_end_;
+            }
+
+            iter_ = list_iterator(text_.cbegin(), text_.cend(), lsm_);
+        }
+    }
+
+    return memo_.hits() != 0 && memo_.evictions() != 0;
+}
+
+// Eviction drops the entries behind the current start position first,
+// which no later start position in that search can reach, and then the
+// furthest ahead, so a budget well short of what the whole input would
+// need loses no hits here.
+bool eviction_keeps_nearest()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const char alphabet_[] = "aaaabbcd x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    std::string text_(20000, ' ');
+    std::size_t hits_[2] = { 0, 0 };
+    std::size_t evictions_[2] = { 0, 0 };
+    const std::size_t budgets_[2] = { 16384, 16777216 };
+
+    grules_.token("'a' 'b' 'c' 'd'");
+    grules_.push("s", "list 'c' | list 'd' 'b' | 'b' s");
+    grules_.push("list", "'a' | list 'a' | list 'b' 'a'");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("'a'"));
+    lrules_.push("b", grules_.token_id("'b'"));
+    lrules_.push("c", grules_.token_id("'c'"));
+    lrules_.push("d", grules_.token_id("'d'"));
+    lrules_.push(" ", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    for (char& c_ : text_)
+    {
+        c_ = alphabet_[char_(gen_)];
+    }
+
+    for (std::size_t idx_ = 0; idx_ < 2; ++idx_)
+    {
+        parsertl::csearch_memo memo_(budgets_[idx_]);
+        lexertl::citerator iter_(text_.c_str(), text_.c_str() + text_.size(),
+            lsm_);
+        lexertl::citerator end_;
+
+        while (parsertl::search(iter_, end_, gsm_, memo_))
+        {
+            iter_ = end_;
+        }
+
+        hits_[idx_] = memo_.hits();
+        evictions_[idx_] = memo_.evictions();
+    }
+
+    return evictions_[0] != 0 && evictions_[1] == 0 && hits_[0] == hits_[1];
+}
+
+// Failures remembered by one call are used by the next.
+bool kept_between_calls()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    parsertl::csearch_memo memo_;
+    // Every 'a' starts a list that fails at 'x', then "a c" matches.
+    const std::string text_ = "aaaaaaaaaaaaaaaaaaaax a c aaaa";
+
+    grules_.token("'a' 'c'");
+    grules_.push("s", "list 'c'");
+    grules_.push("list", "'a' | list 'a'");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("a", grules_.token_id("'a'"));
+    lrules_.push("c", grules_.token_id("'c'"));
+    lrules_.push(" ", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+
+    lexertl::citerator iter_(text_.c_str(), text_.c_str() + text_.size(),
+        lsm_);
+    lexertl::citerator end_;
+
+    if (!parsertl::search(iter_, end_, gsm_, memo_))
+        return false;
+
+    const std::size_t misses_ = memo_.misses();
+
+    // The trailing list fails at end of input
+    iter_ = end_;
+
+    if (parsertl::search(iter_, end_, gsm_, memo_))
+        return false;
+
+    // Searching again from the start finds every failure remembered
+    memo_.clear_statistics();
+    iter_ = lexertl::citerator(text_.c_str(), text_.c_str() + text_.size(),
+        lsm_);
+    return parsertl::search(iter_, end_, gsm_, memo_) &&
+        offset(iter_, text_) == 22 && memo_.misses() < misses_;
+}
+
+int main()
+{
+    int failures_ = 0;
+
+    if (!random_inputs())
+    {
+        std::cout << "random_inputs failed\n";
+        ++failures_;
+    }
+
+    if (!forward_iterators())
+    {
+        std::cout << "forward_iterators failed\n";
+        ++failures_;
+    }
+
+    if (!eviction_keeps_nearest())
+    {
+        std::cout << "eviction_keeps_nearest failed\n";
+        ++failures_;
+    }
+
+    if (!kept_between_calls())
+    {
+        std::cout << "kept_between_calls failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,475 @@
+#include "../../include/parsertl/capture.hpp"
+#include "../../include/parsertl/flat.hpp"
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/lookup.hpp"
+#include <map>
+#include "../../include/parsertl/match.hpp"
+#include <random>
+#include "../../include/parsertl/search.hpp"
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using token = parsertl::token<lexertl::citerator>;
+using token_vector = token::token_vector;
+using id_type = parsertl::state_machine::id_type;
+using captures = std::vector<std::vector<parsertl::capture<const char*>>>;
+using prod_vector = std::vector<std::pair<id_type, token_vector>>;
+using prod_map = std::multimap<id_type, token_vector>;
+
+// Offset of iter_ within text_, or the length of text_ at end of input.
+std::size_t offset(const lexertl::citerator& iter_, const std::string& text_)
+{
+    return iter_ == lexertl::citerator() || iter_->id == 0 ?
+        text_.size() : iter_->first - text_.c_str();
+}
+
+// The search algorithm without any of the optimisations: try every
+// start token in turn, parsing from scratch. On error fall back to the
+// last point at which end of input would have been valid and check
+// that end of input is accepted there.
+bool baseline_search(lexertl::citerator& iter_, lexertl::citerator& end_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    const char* eoi_ = iter_->eoi;
+
+    for (;;)
+    {
+        lexertl::citerator curr_ = iter_;
+        parsertl::match_results results_(curr_->id, gsm_);
+        parsertl::match_results last_results_;
+        lexertl::citerator last_eoi_;
+        bool have_eoi_ = false;
+
+        while (results_.entry.action != parsertl::action::error &&
+            results_.entry.action != parsertl::action::accept)
+        {
+            const bool shift_ =
+                results_.entry.action == parsertl::action::shift;
+            const auto eoi_entry_ = shift_ ?
+                gsm_.at(results_.entry.param) : results_.entry;
+
+            parsertl::lookup(curr_, gsm_, results_);
+
+            if (shift_ && eoi_entry_.action != parsertl::action::error)
+            {
+                have_eoi_ = true;
+                last_eoi_ = curr_;
+                last_results_.stack = results_.stack;
+                last_results_.token_id = 0;
+                last_results_.entry = eoi_entry_;
+            }
+        }
+
+        if (results_.entry.action == parsertl::action::accept)
+        {
+            end_ = curr_;
+            return true;
+        }
+
+        if (have_eoi_ && last_eoi_->id != 0)
+        {
+            lexertl::citerator end_of_input_(eoi_, eoi_, lsm_);
+
+            while (last_results_.entry.action != parsertl::action::error &&
+                last_results_.entry.action != parsertl::action::accept)
+            {
+                parsertl::lookup(end_of_input_, gsm_, last_results_);
+            }
+
+            if (last_results_.entry.action == parsertl::action::accept)
+            {
+                end_ = last_eoi_;
+                return true;
+            }
+        }
+
+        if (iter_->id == 0)
+            return false;
+
+        ++iter_;
+    }
+}
+
+bool same(const token_vector& lhs_, const token_vector& rhs_)
+{
+    if (lhs_.size() != rhs_.size())
+        return false;
+
+    for (std::size_t idx_ = 0, size_ = lhs_.size(); idx_ < size_; ++idx_)
+    {
+        if (lhs_[idx_].id != rhs_[idx_].id ||
+            lhs_[idx_].first != rhs_[idx_].first ||
+            lhs_[idx_].second != rhs_[idx_].second)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool same(const prod_vector& lhs_, const prod_vector& rhs_)
+{
+    if (lhs_.size() != rhs_.size())
+        return false;
+
+    for (std::size_t idx_ = 0, size_ = lhs_.size(); idx_ < size_; ++idx_)
+    {
+        if (lhs_[idx_].first != rhs_[idx_].first ||
+            !same(lhs_[idx_].second, rhs_[idx_].second))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The productions and captures of a match are those of match() over
+// just the text of the match. Capture 0 runs from the first token to
+// the end of the last token in any production.
+void expected_hit(const char* first_, const char* last_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    prod_vector& prod_vec_, captures& captures_)
+{
+    lexertl::citerator iter_(first_, last_, lsm_);
+    parsertl::match_results results_(iter_->id, gsm_);
+    token_vector productions_;
+    const char* end_ = iter_->first;
+
+    parsertl::match(iter_, gsm_, captures_);
+
+    while (results_.entry.action != parsertl::action::error &&
+        results_.entry.action != parsertl::action::accept)
+    {
+        if (results_.entry.action == parsertl::action::reduce)
+        {
+            const std::size_t size_ =
+                gsm_._rules[results_.entry.param]._rhs.size();
+
+            prod_vec_.emplace_back(results_.entry.param, token_vector
+                (productions_.end() - size_, productions_.end()));
+
+            if (size_ && productions_.back().second > end_)
+                end_ = productions_.back().second;
+        }
+
+        parsertl::lookup(iter_, gsm_, results_, productions_);
+    }
+
+    captures_[0].back().second = end_;
+}
+
+// Walks text_ as search_iterator does, checking every search() overload
+// against baseline_search(), and search_count()/search_any() against the
+// number of matches still to come.
+bool same_as_baseline(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    std::size_t& hits_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    lexertl::citerator iter_(first_, last_, lsm_);
+    std::vector<lexertl::citerator> starts_;
+    // Reused by every search along text_
+    parsertl::basic_flat_captures<const char*> reused_captures_;
+    parsertl::basic_search_scratch<lexertl::citerator,
+        parsertl::state_machine> scratch_;
+
+    for (;;)
+    {
+        lexertl::citerator expected_ = iter_;
+        lexertl::citerator expected_end_;
+        const bool hit_ = baseline_search(expected_, expected_end_, lsm_,
+            gsm_);
+        const std::size_t start_ = offset(expected_, text_);
+        const std::size_t end_ = offset(expected_end_, text_);
+        prod_vector expected_vec_;
+        captures expected_captures_;
+
+        starts_.push_back(iter_);
+
+        if (hit_)
+        {
+            expected_hit(first_ + start_, first_ + end_, lsm_, gsm_,
+                expected_vec_, expected_captures_);
+            ++hits_;
+        }
+
+        // Every overload finds the same match
+        const auto check_ = [&](const lexertl::citerator& found_,
+            const lexertl::citerator& found_end_, const bool found_hit_,
+            const char* name_)
+        {
+            if (found_hit_ != hit_ || (hit_ &&
+                (offset(found_, text_) != start_ ||
+                    offset(found_end_, text_) != end_)))
+            {
+                std::cout << "search() with " << name_ << " differs for \"" <<
+                    text_ << "\" from " << offset(iter_, text_) << '\n';
+                return false;
+            }
+
+            return true;
+        };
+        lexertl::citerator found_ = iter_;
+        lexertl::citerator found_end_;
+        captures captures_;
+        const auto same_captures_ =
+            [&](const parsertl::basic_flat_captures<const char*>& flat_)
+        {
+            if (flat_.size() != captures_.size())
+                return false;
+
+            for (std::size_t idx_ = 0, size_ = captures_.size();
+                idx_ < size_; ++idx_)
+            {
+                const auto view_ = flat_[idx_];
+
+                if (captures_[idx_] != std::vector<parsertl::capture
+                    <const char*>>(view_.begin(), view_.end()))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        };
+
+        if (!check_(found_, found_end_, parsertl::search(found_, found_end_,
+            gsm_, captures_), "captures") ||
+            (hit_ && captures_ != expected_captures_))
+        {
+            return false;
+        }
+
+        parsertl::basic_flat_captures<const char*> flat_captures_;
+
+        found_ = iter_;
+
+        if (!check_(found_, found_end_, parsertl::search(found_, found_end_,
+            gsm_, flat_captures_), "basic_flat_captures") ||
+            (hit_ && !same_captures_(flat_captures_)))
+        {
+            return false;
+        }
+
+        found_ = iter_;
+
+        if (!check_(found_, found_end_, parsertl::search(found_, found_end_,
+            gsm_, reused_captures_, scratch_), "basic_search_scratch") ||
+            (hit_ && !same_captures_(reused_captures_)))
+        {
+            return false;
+        }
+
+        std::set<id_type> set_;
+
+        found_ = iter_;
+
+        if (!check_(found_, found_end_, parsertl::search(found_, found_end_,
+            gsm_, &set_), "std::set"))
+        {
+            return false;
+        }
+
+        prod_vector prod_vec_;
+
+        found_ = iter_;
+
+        if (!check_(found_, found_end_, parsertl::search(found_, found_end_,
+            gsm_, &prod_vec_), "std::vector") ||
+            (hit_ && !same(prod_vec_, expected_vec_)))
+        {
+            return false;
+        }
+
+        prod_map prod_map_;
+
+        found_ = iter_;
+
+        if (!check_(found_, found_end_, parsertl::search(found_, found_end_,
+            gsm_, &prod_map_), "std::multimap"))
+        {
+            return false;
+        }
+
+        if (hit_)
+        {
+            prod_map expected_map_;
+            auto map_iter_ = prod_map_.begin();
+
+            for (const auto& pair_ : expected_vec_)
+            {
+                expected_map_.insert(pair_);
+            }
+
+            if (prod_map_.size() != expected_map_.size())
+                return false;
+
+            for (const auto& pair_ : expected_map_)
+            {
+                if (map_iter_->first != pair_.first ||
+                    !same(map_iter_->second, pair_.second))
+                {
+                    return false;
+                }
+
+                ++map_iter_;
+            }
+
+            std::set<id_type> expected_set_;
+
+            for (const auto& pair_ : expected_vec_)
+            {
+                expected_set_.insert(pair_.first);
+            }
+
+            if (set_ != expected_set_)
+                return false;
+        }
+
+        parsertl::basic_flat_productions<id_type, token_vector> flat_;
+
+        found_ = iter_;
+
+        if (!check_(found_, found_end_, parsertl::search(found_, found_end_,
+            gsm_, &flat_), "basic_flat_productions"))
+        {
+            return false;
+        }
+
+        if (hit_)
+        {
+            prod_vector flat_vec_;
+
+            for (std::size_t idx_ = 0, size_ = flat_.size(); idx_ < size_;
+                ++idx_)
+            {
+                const auto prod_ = flat_[idx_];
+
+                flat_vec_.emplace_back(prod_.id,
+                    token_vector(prod_.begin(), prod_.end()));
+            }
+
+            if (!same(flat_vec_, expected_vec_))
+                return false;
+        }
+
+        if (!hit_)
+            break;
+
+        iter_ = expected_end_;
+    }
+
+    // From the nth search position there are size - n - 1 matches to come
+    for (std::size_t idx_ = 0, size_ = starts_.size(); idx_ < size_; ++idx_)
+    {
+        const std::size_t count_ =
+            parsertl::search_count(starts_[idx_], gsm_);
+
+        if (count_ != size_ - idx_ - 1 ||
+            parsertl::search_any(starts_[idx_], gsm_) != (count_ > 0))
+        {
+            std::cout << "search_count()/search_any() differs for \"" <<
+                text_ << "\" from " << offset(starts_[idx_], text_) << '\n';
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    // Rules as lhs, rhs pairs ending with nullptr. The first is the start.
+    const char* grammars_[][10] =
+    {
+        { "list", "item | list item",
+            "item", "('a') | 'a' ('b') 'c' | 'd' 'b'", nullptr },
+
+        { "exp", "exp '+' term | term",
+            "term", "term '*' factor | factor",
+            "factor", "('a') | '(' (exp) ')'", nullptr },
+
+        { "s", "(x) 'c' | 'd' 'a' 'b' 'a' 'b' | 'e' s 'e'",
+            "x", "'a' | x 'b' ('a')", nullptr },
+
+        { "s", "'e' | 'e' 'e' 'e' | 'a' (s) 'b' | 'a' 'a' x",
+            "x", "'c' | x ('c' 'd')", nullptr },
+
+        // The LALR(1) state for x: 'e' allows end of input after 'a' too,
+        // so there are candidates that fail when continued.
+        { "list", "list item | item",
+            "item", "'c' | 'a' (x) 'b' | 'd' x",
+            "x", "'e'", nullptr }
+    };
+    const char alphabet_[] = "abcde+*() x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 30);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    int failures_ = 0;
+
+    for (const auto& grammar_ : grammars_)
+    {
+        parsertl::rules grules_(*parsertl::rule_flags::enable_captures);
+        parsertl::state_machine gsm_;
+        lexertl::rules lrules_;
+        lexertl::state_machine lsm_;
+        std::size_t hits_ = 0;
+
+        grules_.token("'a' 'b' 'c' 'd' 'e' '+' '*' '(' ')'");
+
+        for (std::size_t idx_ = 0; grammar_[idx_]; idx_ += 2)
+        {
+            grules_.push(grammar_[idx_], grammar_[idx_ + 1]);
+        }
+
+        grules_.start(grammar_[0]);
+        parsertl::generator::build(grules_, gsm_);
+
+        lrules_.push("a", grules_.token_id("'a'"));
+        lrules_.push("b", grules_.token_id("'b'"));
+        lrules_.push("c", grules_.token_id("'c'"));
+        lrules_.push("d", grules_.token_id("'d'"));
+        lrules_.push("e", grules_.token_id("'e'"));
+        lrules_.push("\\+", grules_.token_id("'+'"));
+        lrules_.push("\\*", grules_.token_id("'*'"));
+        lrules_.push("\\(", grules_.token_id("'('"));
+        lrules_.push("\\)", grules_.token_id("')'"));
+        lrules_.push(" ", lrules_.skip());
+        lexertl::generator::build(lrules_, lsm_);
+
+        for (std::size_t run_ = 0; run_ < 2000; ++run_)
+        {
+            std::string text_(length_(gen_), ' ');
+
+            for (char& c_ : text_)
+            {
+                c_ = alphabet_[char_(gen_)];
+            }
+
+            if (!same_as_baseline(text_, lsm_, gsm_, hits_))
+            {
+                std::cout << "random_inputs failed for grammar " <<
+                    grammar_[1] << '\n';
+                ++failures_;
+                break;
+            }
+        }
+
+        if (hits_ < 100)
+        {
+            std::cout << "too few hits for grammar " << grammar_[1] << '\n';
+            ++failures_;
+        }
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/search.hpp"
+#include "../../include/parsertl/single_pass_search.hpp"
+#include <random>
+#include <string>
+
+// Offset of iter_ within text_, or the length of text_ at end of input.
+std::size_t offset(const lexertl::citerator& iter_, const std::string& text_)
+{
+    return iter_ == lexertl::citerator() ?
+        text_.size() : iter_->first - text_.c_str();
+}
+
+// Repeats both searches along text_, as search_iterator does, and checks
+// that they find the same matches.
+bool same_as_search(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    lexertl::citerator iter_(text_.c_str(), text_.c_str() + text_.size(),
+        lsm_);
+
+    for (;;)
+    {
+        lexertl::citerator lhs_ = iter_;
+        lexertl::citerator lhs_end_;
+        lexertl::citerator rhs_ = iter_;
+        lexertl::citerator rhs_end_;
+        const bool lhs_hit_ = parsertl::search(lhs_, lhs_end_, gsm_);
+        const bool rhs_hit_ =
+            parsertl::single_pass_search(rhs_, rhs_end_, gsm_);
+
+        if (lhs_hit_ != rhs_hit_ ||
+            (lhs_hit_ && (offset(lhs_, text_) != offset(rhs_, text_) ||
+                offset(lhs_end_, text_) != offset(rhs_end_, text_))))
+        {
+            std::cout << '"' << text_ << "\" from " << offset(iter_, text_) <<
+                ": search() " << lhs_hit_ << ' ' << offset(lhs_, text_) <<
+                '-' << offset(lhs_end_, text_) << ", single_pass_search() " <<
+                rhs_hit_ << ' ' << offset(rhs_, text_) << '-' <<
+                offset(rhs_end_, text_) << '\n';
+            return false;
+        }
+
+        if (!lhs_hit_)
+            break;
+
+        iter_ = lhs_end_;
+    }
+
+    return true;
+}
+
+// Grammars with nested points at which end of input would be accepted,
+// with stacks that merge and with unknown tokens ('x'), over random input.
+bool random_inputs()
+{
+    // Rules as lhs, rhs pairs ending with nullptr. The first is the start.
+    const char* grammars_[][10] =
+    {
+        { "list", "item | list item",
+            "item", "'a' | 'a' 'b' 'c' | 'd' 'b'", nullptr },
+
+        { "exp", "exp '+' term | term",
+            "term", "term '*' factor | factor",
+            "factor", "'a' | '(' exp ')'", nullptr },
+
+        { "s", "x 'c' | 'd' 'a' 'b' 'a' 'b' | 'e' s 'e'",
+            "x", "'a' | x 'b' 'a'", nullptr },
+
+        { "s", "'e' | 'e' 'e' 'e' | 'a' s 'b' | 'a' 'a' x",
+            "x", "'c' | x 'c' 'd'", nullptr },
+
+        // The LALR(1) state for x: 'e' allows end of input after 'a' too,
+        // so there are candidates that fail when continued.
+        { "list", "list item | item",
+            "item", "'c' | 'a' x 'b' | 'd' x",
+            "x", "'e'", nullptr }
+    };
+    const char alphabet_[] = "abcde+*() x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 30);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+
+    for (const auto& grammar_ : grammars_)
+    {
+        parsertl::rules grules_;
+        parsertl::state_machine gsm_;
+        lexertl::rules lrules_;
+        lexertl::state_machine lsm_;
+
+        grules_.token("'a' 'b' 'c' 'd' 'e' '+' '*' '(' ')'");
+
+        for (std::size_t idx_ = 0; grammar_[idx_]; idx_ += 2)
+        {
+            grules_.push(grammar_[idx_], grammar_[idx_ + 1]);
+        }
+
+        grules_.start(grammar_[0]);
+        parsertl::generator::build(grules_, gsm_);
+
+        lrules_.push("a", grules_.token_id("'a'"));
+        lrules_.push("b", grules_.token_id("'b'"));
+        lrules_.push("c", grules_.token_id("'c'"));
+        lrules_.push("d", grules_.token_id("'d'"));
+        lrules_.push("e", grules_.token_id("'e'"));
+        lrules_.push("\\+", grules_.token_id("'+'"));
+        lrules_.push("\\*", grules_.token_id("'*'"));
+        lrules_.push("\\(", grules_.token_id("'('"));
+        lrules_.push("\\)", grules_.token_id("')'"));
+        lrules_.push(" ", lrules_.skip());
+        lexertl::generator::build(lrules_, lsm_);
+
+        for (std::size_t run_ = 0; run_ < 5000; ++run_)
+        {
+            std::string text_(length_(gen_), ' ');
+
+            for (char& c_ : text_)
+            {
+                c_ = alphabet_[char_(gen_)];
+            }
+
+            if (!same_as_search(text_, lsm_, gsm_))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    int failures_ = 0;
+
+    if (!random_inputs())
+    {
+        std::cout << "random_inputs failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
@@ -0,0 +1,186 @@
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include "../../include/parsertl/parse.hpp"
+#include <random>
+#include "../../include/parsertl/speculative_parse.hpp"
+#include <string>
+#include <vector>
+
+using id_type = parsertl::state_machine::id_type;
+using stacks = std::vector<std::vector<id_type>>;
+
+struct counts
+{
+    std::size_t _on_sync = 0;
+    std::size_t _off_sync = 0;
+    std::size_t _used = 0;
+};
+
+// Appends a random statement, nesting blocks up to depth_ deep.
+// Strings may contain the sync token, so that lexing from a split point
+// inside one does not line up with the real tokens.
+void statement(std::string& str_, const std::size_t depth_,
+    std::mt19937& gen_)
+{
+    switch (gen_() % (depth_ ? 4 : 3))
+    {
+    case 0:
+        str_ += "a + b;";
+        break;
+    case 1:
+        str_ += "(x) + \"; {\";";
+        break;
+    case 2:
+        str_ += "y;";
+        break;
+    default:
+    {
+        const std::size_t size_ = gen_() % 4;
+
+        str_ += "{ ";
+
+        for (std::size_t idx_ = 0; idx_ <= size_; ++idx_)
+        {
+            statement(str_, depth_ - 1, gen_);
+            str_ += ' ';
+        }
+
+        str_ += '}';
+        break;
+    }
+    }
+}
+
+// Checks that speculative_parse() gives the same answer as parse(), and
+// on failure stops with the same stack and error, for every thread
+// count from 1 to 12. Records whether the split points landed on sync
+// tokens or not.
+bool same_as_parse(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    const std::vector<id_type>& sync_, const stacks& stacks_, counts& counts_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    lexertl::citerator iter_(first_, last_, lsm_);
+    parsertl::match_results expected_(iter_->id, gsm_);
+    const bool success_ = parsertl::parse(iter_, gsm_, expected_);
+
+    for (std::size_t threads_ = 1; threads_ <= 12; ++threads_)
+    {
+        parsertl::match_results results_;
+        std::size_t reparsed_ = 0;
+        const bool spec_success_ =
+            parsertl::speculative_parse<lexertl::citerator>(first_, last_,
+                lsm_, gsm_, results_, sync_, stacks_, threads_, &reparsed_);
+
+        if (spec_success_ != success_ ||
+            results_.entry.action != expected_.entry.action ||
+            (!success_ && (results_.stack != expected_.stack ||
+                results_.entry.param != expected_.entry.param)))
+        {
+            std::cout << "Different result for \"" << text_ << "\" with " <<
+                threads_ << " threads\n";
+            return false;
+        }
+
+        for (std::size_t idx_ = 1; idx_ < threads_ && !text_.empty();
+            ++idx_)
+        {
+            const char c_ = text_[text_.size() * idx_ / threads_];
+
+            if (c_ == ';')
+                ++counts_._on_sync;
+            else
+                ++counts_._off_sync;
+        }
+
+        if (threads_ > 1 && text_.size() >= threads_)
+            counts_._used += threads_ - reparsed_;
+    }
+
+    return true;
+}
+
+int main()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    std::vector<id_type> sync_;
+    stacks stacks_;
+    std::mt19937 gen_(0);
+    counts counts_;
+    int failures_ = 0;
+
+    grules_.token("ID STRING");
+    grules_.push("program", "stmts");
+    grules_.push("stmts", "stmt | stmts stmt");
+    grules_.push("stmt", "expr ';' | '{' stmts '}'");
+    grules_.push("expr", "ID | STRING | expr '+' ID | expr '+' STRING | "
+        "'(' expr ')'");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("[a-z]+", grules_.token_id("ID"));
+    lrules_.push("[\"][^\"]*[\"]", grules_.token_id("STRING"));
+    lrules_.push(";", grules_.token_id("';'"));
+    lrules_.push("[{]", grules_.token_id("'{'"));
+    lrules_.push("[}]", grules_.token_id("'}'"));
+    lrules_.push("[+]", grules_.token_id("'+'"));
+    lrules_.push("[(]", grules_.token_id("'('"));
+    lrules_.push("[)]", grules_.token_id("')'"));
+    lrules_.push("\\s+", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+    sync_.push_back(grules_.token_id("';'"));
+
+    {
+        const std::string sample_ = "a; { b; { c; { d; } } }";
+        lexertl::citerator iter_(sample_.c_str(),
+            sample_.c_str() + sample_.size(), lsm_);
+
+        if (!parsertl::collect_sync_stacks(iter_, gsm_, sync_, stacks_))
+        {
+            std::cout << "collect_sync_stacks failed\n";
+            ++failures_;
+        }
+    }
+
+    for (std::size_t run_ = 0; run_ < 300; ++run_)
+    {
+        std::string text_;
+        const std::size_t size_ = 1 + gen_() % 20;
+
+        for (std::size_t idx_ = 0; idx_ < size_; ++idx_)
+        {
+            // Depths beyond the sample force some chunks to be reparsed
+            statement(text_, gen_() % 5, gen_);
+            text_ += gen_() % 2 ? " " : "\n";
+        }
+
+        // Break a third of the inputs
+        if (run_ % 3 == 0)
+            text_[gen_() % text_.size()] = "};+?x"[gen_() % 5];
+
+        if (!same_as_parse(text_, lsm_, gsm_, sync_, stacks_, counts_))
+        {
+            std::cout << "random_inputs failed\n";
+            ++failures_;
+            break;
+        }
+    }
+
+    if (!same_as_parse(std::string(), lsm_, gsm_, sync_, stacks_, counts_))
+    {
+        std::cout << "empty_input failed\n";
+        ++failures_;
+    }
+
+    if (!counts_._on_sync || !counts_._off_sync || !counts_._used)
+    {
+        std::cout << "coverage failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
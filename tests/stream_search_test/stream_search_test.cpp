@@ -0,0 +1,247 @@
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <random>
+#include "../../include/parsertl/search_iterator.hpp"
+#include "../../include/parsertl/stream_search.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+
+using stream_search = parsertl::basic_stream_search<lexertl::citerator,
+    lexertl::state_machine, parsertl::state_machine>;
+// Offsets of each capture of each match
+using spans = std::vector<std::vector<std::vector<std::pair<std::size_t,
+    std::size_t>>>>;
+
+template<typename captures, typename functor>
+void add_match(const captures& captures_, spans& spans_, functor offset_)
+{
+    spans_.emplace_back();
+
+    for (const auto& group_ : captures_)
+    {
+        spans_.back().emplace_back();
+
+        for (const auto& capture_ : group_)
+        {
+            spans_.back().back().emplace_back(offset_(capture_.first),
+                offset_(capture_.second));
+        }
+    }
+}
+
+spans search_iterator_spans(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    lexertl::citerator iter_(text_.c_str(), text_.c_str() + text_.size(),
+        lsm_);
+    parsertl::search_iterator<lexertl::citerator, parsertl::state_machine>
+        search_(iter_, gsm_);
+    parsertl::search_iterator<lexertl::citerator, parsertl::state_machine>
+        end_;
+    spans spans_;
+
+    for (; search_ != end_; ++search_)
+    {
+        add_match(*search_, spans_, [&text_](const char* ptr_)
+            {
+                return static_cast<std::size_t>(ptr_ - text_.c_str());
+            });
+    }
+
+    return spans_;
+}
+
+// Pushes text_ in pieces ending at each of splits_.
+spans stream_spans(const std::string& text_,
+    const std::vector<std::size_t>& splits_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_)
+{
+    stream_search stream_(lsm_, gsm_);
+    spans spans_;
+    std::size_t first_ = 0;
+    auto func_ = [&](const stream_search::results& captures_)
+    {
+        add_match(captures_, spans_, [&stream_](const char* ptr_)
+            {
+                return stream_.position(ptr_);
+            });
+    };
+
+    for (const std::size_t split_ : splits_)
+    {
+        stream_.push(text_.c_str() + first_, text_.c_str() + split_, func_);
+        first_ = split_;
+    }
+
+    stream_.push(text_.c_str() + first_, text_.c_str() + text_.size(), func_);
+    stream_.finish(func_);
+    return spans_;
+}
+
+void build(lexertl::state_machine& lsm_, parsertl::state_machine& gsm_)
+{
+    parsertl::rules grules_(*parsertl::rule_flags::enable_captures);
+    lexertl::rules lrules_;
+
+    grules_.token("AB ABCD C D E");
+    grules_.push("list", "item | list item");
+    grules_.push("item", "AB C | (ABCD) E | D (E) | '/' D");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("ab", grules_.token_id("AB"));
+    lrules_.push("abcd", grules_.token_id("ABCD"));
+    lrules_.push("c", grules_.token_id("C"));
+    lrules_.push("d", grules_.token_id("D"));
+    lrules_.push("e", grules_.token_id("E"));
+    lrules_.push("[/]", grules_.token_id("'/'"));
+    // A skipped comment that needs lookahead too
+    lrules_.push("[/][*][^*]*[*][/]", lrules_.skip());
+    lrules_.push(" ", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+}
+
+// "abc" lexes as "ab", "c" until the 'd' arrives. The leading text is
+// discarded after the first push, leaving room for the rest in the
+// buffer, so that the tokens already lexed are kept.
+bool extended_token()
+{
+    lexertl::state_machine lsm_;
+    parsertl::state_machine gsm_;
+    const std::string text_ = "xxxxxxxxxxxxxxxxxxxxabcde";
+
+    build(lsm_, gsm_);
+    return stream_spans(text_, { 20, 23 }, lsm_, gsm_) ==
+        search_iterator_spans(text_, lsm_, gsm_);
+}
+
+// A piece without a token that can start a match (so the search skips
+// all of it) ends part way into a comment that the next piece completes.
+bool no_viable_start()
+{
+    lexertl::state_machine lsm_;
+    parsertl::state_machine gsm_;
+    const std::string text_ = "c e c e /* d e */ d e";
+
+    build(lsm_, gsm_);
+
+    const spans expected_ = search_iterator_spans(text_, lsm_, gsm_);
+
+    for (const std::size_t split_ : { 8, 9, 10 })
+    {
+        if (stream_spans(text_, { split_ }, lsm_, gsm_) != expected_)
+            return false;
+    }
+
+    return expected_.size() == 1;
+}
+
+// Each match is pushed in two pieces. "ab c" could still be followed by
+// another item, so it is only reported by the push of " x ". The text
+// held between pushes never exceeds that partial match, however much
+// input has been pushed.
+bool reported_when_final()
+{
+    lexertl::state_machine lsm_;
+    parsertl::state_machine gsm_;
+    const std::string partial_ = "ab c";
+    const std::string rest_ = " x ";
+    std::size_t matches_ = 0;
+    auto func_ = [&matches_](const stream_search::results&)
+    {
+        ++matches_;
+    };
+
+    build(lsm_, gsm_);
+
+    stream_search stream_(lsm_, gsm_);
+
+    for (std::size_t idx_ = 0; idx_ < 1000; ++idx_)
+    {
+        stream_.push(partial_.c_str(), partial_.c_str() + partial_.size(),
+            func_);
+
+        if (matches_ != idx_ || stream_.buffered() > partial_.size())
+            return false;
+
+        stream_.push(rest_.c_str(), rest_.c_str() + rest_.size(), func_);
+
+        if (matches_ != idx_ + 1 || stream_.buffered() > partial_.size())
+            return false;
+    }
+
+    stream_.finish(func_);
+    return matches_ == 1000;
+}
+
+bool random_inputs()
+{
+    lexertl::state_machine lsm_;
+    parsertl::state_machine gsm_;
+    const char alphabet_[] = "aabbccdde/* x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 100);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+
+    build(lsm_, gsm_);
+
+    for (std::size_t run_ = 0; run_ < 3000; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+        std::vector<std::size_t> splits_;
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        for (std::size_t idx_ = 0; idx_ < text_.size(); ++idx_)
+        {
+            // Mostly small pieces, sometimes one character
+            if (gen_() % (run_ % 2 ? 2 : 8) == 0)
+                splits_.push_back(idx_);
+        }
+
+        if (stream_spans(text_, splits_, lsm_, gsm_) !=
+            search_iterator_spans(text_, lsm_, gsm_))
+        {
+            std::cout << "Different matches for \"" << text_ << "\"\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    int failures_ = 0;
+
+    if (!extended_token())
+    {
+        std::cout << "extended_token failed\n";
+        ++failures_;
+    }
+
+    if (!no_viable_start())
+    {
+        std::cout << "no_viable_start failed\n";
+        ++failures_;
+    }
+
+    if (!reported_when_final())
+    {
+        std::cout << "reported_when_final failed\n";
+        ++failures_;
+    }
+
+    if (!random_inputs())
+    {
+        std::cout << "random_inputs failed\n";
+        ++failures_;
+    }
+
+    return failures_ ? 1 : 0;
+}
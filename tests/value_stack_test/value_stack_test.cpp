@@ -0,0 +1,229 @@
+#include <cctype>
+#include "../../include/parsertl/generator.hpp"
+#include <iostream>
+#include <lexertl/generator.hpp>
+#include <lexertl/iterator.hpp>
+#include <memory>
+#include <random>
+#include <string>
+#include "../../include/parsertl/value_stack.hpp"
+#include <vector>
+
+struct node
+{
+    long long _value = 0;
+};
+
+// Move only, so any copy made by the value stack fails to compile
+using value = std::unique_ptr<node>;
+using value_stack = parsertl::basic_value_stack<value>;
+
+struct rule_ids
+{
+    std::size_t _empty_list = 0;
+    std::size_t _list = 0;
+    std::size_t _integer = 0;
+    std::size_t _paren = 0;
+};
+
+// A list is the sum of its items and brackets add one.
+struct handler
+{
+    const parsertl::state_machine* _sm = nullptr;
+    rule_ids _ids;
+    std::size_t _nodes = 0;
+    bool _ok = true;
+
+    value shift(const lexertl::citerator::value_type& token_)
+    {
+        if (!std::isdigit(static_cast<unsigned char>(*token_.first)))
+            return value();
+
+        ++_nodes;
+        return value(new node{ std::stoll(token_.str()) });
+    }
+
+    value reduce(const std::size_t rule_id_, value_stack& values_)
+    {
+        if (values_.rhs_size() != _sm->_rules[rule_id_]._rhs.size())
+            _ok = false;
+
+        if (rule_id_ == _ids._empty_list)
+        {
+            ++_nodes;
+            return value(new node());
+        }
+        else if (rule_id_ == _ids._list)
+        {
+            values_.dollar(0)->_value += values_.dollar(1)->_value;
+            return std::move(values_.dollar(0));
+        }
+        else if (rule_id_ == _ids._integer)
+            return std::move(values_.dollar(0));
+
+        // '(' list ')'
+        if (values_.dollar(0) || values_.dollar(2))
+            _ok = false;
+
+        ++values_.dollar(1)->_value;
+        return std::move(values_.dollar(1));
+    }
+};
+
+// Recursive descent evaluation of the same language for comparison.
+bool evaluate(const char*& curr_, const char* last_, long long& value_,
+    const bool nested_)
+{
+    value_ = 0;
+
+    for (;;)
+    {
+        while (curr_ != last_ && *curr_ == ' ')
+        {
+            ++curr_;
+        }
+
+        if (curr_ == last_ || *curr_ == ')')
+            return nested_ == (curr_ != last_);
+
+        if (*curr_ == '(')
+        {
+            long long inner_ = 0;
+
+            ++curr_;
+
+            if (!evaluate(curr_, last_, inner_, true))
+                return false;
+
+            ++curr_;
+            value_ += inner_ + 1;
+        }
+        else if (std::isdigit(static_cast<unsigned char>(*curr_)))
+        {
+            long long num_ = 0;
+
+            for (; curr_ != last_ &&
+                std::isdigit(static_cast<unsigned char>(*curr_)); ++curr_)
+            {
+                num_ = num_ * 10 + (*curr_ - '0');
+            }
+
+            value_ += num_;
+        }
+        else
+            return false;
+    }
+}
+
+// Checks the parse() driver against evaluate() and that, on success,
+// only the value of the start rule is left on the stack.
+bool same_as_evaluate(const std::string& text_,
+    const lexertl::state_machine& lsm_, const parsertl::state_machine& gsm_,
+    handler& handler_, value_stack& values_)
+{
+    const char* first_ = text_.c_str();
+    const char* last_ = first_ + text_.size();
+    const char* curr_ = first_;
+    long long expected_ = 0;
+    const bool success_ = evaluate(curr_, last_, expected_, false);
+    lexertl::citerator iter_(first_, last_, lsm_);
+    parsertl::match_results results_(iter_->id, gsm_);
+
+    values_.clear();
+    handler_._ok = true;
+
+    if (parsertl::parse(iter_, gsm_, results_, values_, handler_) !=
+        success_ || !handler_._ok || (success_ && (values_.size() != 1 ||
+            values_.back()->_value != expected_)))
+    {
+        std::cout << "Different result for \"" << text_ << "\"\n";
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    parsertl::rules grules_;
+    parsertl::state_machine gsm_;
+    lexertl::rules lrules_;
+    lexertl::state_machine lsm_;
+    const char alphabet_[] = "(((  )))1234567x";
+    std::mt19937 gen_(0);
+    std::uniform_int_distribution<std::size_t> length_(0, 60);
+    std::uniform_int_distribution<std::size_t> char_(0,
+        sizeof(alphabet_) - 2);
+    handler handler_;
+    value_stack values_;
+    std::size_t matches_ = 0;
+    int failures_ = 0;
+
+    grules_.token("INTEGER");
+    handler_._ids._empty_list = grules_.push("list", "%empty");
+    handler_._ids._list = grules_.push("list", "list item");
+    handler_._ids._integer = grules_.push("item", "INTEGER");
+    handler_._ids._paren = grules_.push("item", "'(' list ')'");
+    parsertl::generator::build(grules_, gsm_);
+    lrules_.push("[0-9]+", grules_.token_id("INTEGER"));
+    lrules_.push("[(]", grules_.token_id("'('"));
+    lrules_.push("[)]", grules_.token_id("')'"));
+    lrules_.push(" +", lrules_.skip());
+    lexertl::generator::build(lrules_, lsm_);
+    handler_._sm = &gsm_;
+
+    for (std::size_t run_ = 0; run_ < 1000; ++run_)
+    {
+        std::string text_(length_(gen_), ' ');
+
+        for (char& c_ : text_)
+        {
+            c_ = alphabet_[char_(gen_)];
+        }
+
+        if (!same_as_evaluate(text_, lsm_, gsm_, handler_, values_))
+        {
+            std::cout << "random_inputs failed\n";
+            ++failures_;
+            break;
+        }
+
+        const char* curr_ = text_.c_str();
+        long long value_ = 0;
+
+        matches_ += evaluate(curr_, curr_ + text_.size(), value_, false);
+    }
+
+    if (matches_ < 20)
+    {
+        std::cout << "too few matching inputs\n";
+        ++failures_;
+    }
+
+    // Once the stack has grown, parsing no deeper does not reallocate it
+    {
+        const std::string deep_ = std::string(200, '(') + "1" +
+            std::string(200, ')');
+        const std::string shallow_ = "(1 (2 3) 4) 5";
+
+        if (!same_as_evaluate(deep_, lsm_, gsm_, handler_, values_))
+        {
+            std::cout << "deep failed\n";
+            ++failures_;
+        }
+
+        const std::size_t capacity_ = values_.values().capacity();
+        const value* data_ = values_.values().data();
+
+        if (!same_as_evaluate(shallow_, lsm_, gsm_, handler_, values_) ||
+            !same_as_evaluate(deep_, lsm_, gsm_, handler_, values_) ||
+            values_.values().capacity() != capacity_ ||
+            values_.values().data() != data_)
+        {
+            std::cout << "reuse failed\n";
+            ++failures_;
+        }
+    }
+
+    return failures_ ? 1 : 0;
+}